@@ -4,6 +4,10 @@
 #include "constants.h"
 #include "level.grpc.pb.h"
 #include "math.h"
+#include "timer.h"
+
+#include <algorithm>
+#include <string>
 
 class Agent {
 public:
@@ -11,6 +15,61 @@ public:
   virtual bman::MovePlayerRequest
   GetPlayerAction(const bman::GameState& game_state) = 0;
 
+  // Anytime version of GetPlayerAction for callers that can't wait (e.g.,
+  // the 60fps loop): returns by deadline_millis (a bman::Timer::NowMillis()
+  // time) with the best action found so far. Agents that can't stop early
+  // just decide as usual.
+  virtual bman::MovePlayerRequest
+  GetPlayerActionBy(const bman::GameState& game_state,
+                    double /*deadline_millis*/) {
+    return GetPlayerAction(game_state);
+  }
+
+  // Time taken by GetPlayerActionWithin against the budgets.
+  struct DecisionStats {
+    int64_t num_decisions = 0;
+    int64_t num_over_budget = 0;
+    double total_millis = 0;
+    double max_millis = 0;
+    double total_budget_millis = 0;
+
+    void Add(double millis, double budget_millis) {
+      num_decisions++;
+      num_over_budget += millis > budget_millis;
+      total_millis += millis;
+      max_millis = std::max(max_millis, millis);
+      total_budget_millis += budget_millis;
+    }
+    std::string ToString() const {
+      const int64_t n = std::max<int64_t>(1, num_decisions);
+      char str[128];
+      snprintf(str, sizeof(str),
+               "%ld decisions, mean %.2fms (max %.2fms) of %.2fms budget, "
+               "%ld over",
+               (long)num_decisions, total_millis / n, max_millis,
+               total_budget_millis / n, (long)num_over_budget);
+      return str;
+    }
+  };
+
+  // Calls GetPlayerActionBy with a budget from now and records the time
+  // taken.
+  bman::MovePlayerRequest
+  GetPlayerActionWithin(const bman::GameState& game_state,
+                        double budget_millis) {
+    const double start = bman::Timer::NowMillis();
+    bman::MovePlayerRequest move =
+        GetPlayerActionBy(game_state, start + budget_millis);
+    decision_stats_.Add(bman::Timer::NowMillis() - start, budget_millis);
+    return move;
+  }
+  const DecisionStats& decision_stats() const { return decision_stats_; }
+
+  // Agents that make random choices (e.g., MctsAgent's rollouts) seed them
+  // with this, so that the games they play are reproducible. The others,
+  // such as SimpleAgent, are deterministic.
+  virtual void Seed(uint32_t /*seed*/) {}
+
   static void GetDeltaFromDir(int dir, int* dx, int* dy) {
     static constexpr int kDirs[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
     if (dir < 0 || dir >= 4) {
@@ -33,6 +92,9 @@ public:
     }
     return -1;
   }
+
+private:
+  DecisionStats decision_stats_;
 };
 
 #endif
@@ -0,0 +1,61 @@
+#include "agent_batch.h"
+
+#include "glog/logging.h"
+#include "simple_agent.h"
+
+std::vector<bman::MovePlayerRequest>
+AgentBatch::GetPlayerActionsInGame(const bman::GameState& game_state,
+                                   const std::vector<int>& player_indices) {
+  std::vector<Player> players(player_indices.size());
+  for (size_t i = 0; i < player_indices.size(); ++i) {
+    players[i].player_index = player_indices[i];
+  }
+  return GetPlayerActions({&game_state}, players);
+}
+
+std::vector<bman::MovePlayerRequest> PerPlayerAgentBatch::GetPlayerActions(
+    const std::vector<const bman::GameState*>& game_states,
+    const std::vector<Player>& players) {
+  std::vector<bman::MovePlayerRequest> moves;
+  moves.reserve(players.size());
+  for (const Player& player : players) {
+    CHECK_LT(player.game, (int)game_states.size());
+    moves.push_back(GetAgent(player.game, player.player_index)
+                        ->GetPlayerAction(*game_states[player.game]));
+  }
+  return moves;
+}
+
+void PerPlayerAgentBatch::ResetGame(int game) {
+  agents_.erase(agents_.lower_bound({game, 0}),
+                agents_.lower_bound({game + 1, 0}));
+}
+
+Agent* PerPlayerAgentBatch::GetAgent(int game, int player_index) {
+  std::unique_ptr<Agent>& agent = agents_[{game, player_index}];
+  if (!agent) {
+    agent = factory_(game, player_index);
+  }
+  return agent.get();
+}
+
+SimpleAgentBatch::SimpleAgentBatch(const bman::GameConfig& config)
+    : PerPlayerAgentBatch([this](int game, int player_index) {
+        return std::unique_ptr<Agent>(new SimpleAgent(
+            config_, player_index, GetAnalysisCache(game)));
+      }),
+      config_(config) {}
+
+void SimpleAgentBatch::ResetGame(int game) {
+  PerPlayerAgentBatch::ResetGame(game);
+  analysis_caches_.erase(game);
+}
+
+std::shared_ptr<WorldAnalysisCache>
+SimpleAgentBatch::GetAnalysisCache(int game) {
+  std::shared_ptr<WorldAnalysisCache>& cache = analysis_caches_[game];
+  if (!cache) {
+    cache = std::make_shared<WorldAnalysisCache>();
+  }
+  return cache;
+}
@@ -0,0 +1,82 @@
+#ifndef BMAN_AGENT_BATCH_H
+#define BMAN_AGENT_BATCH_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "agent.h"
+#include "level.grpc.pb.h"
+#include "world_analysis.h"
+
+// Decides for many players at once, in one game or across many, so that work
+// that doesn't depend on the player (the world analysis, the observation
+// grid, a pass through a policy model) is done once per game or once per
+// batch. Meant for hosting many bots per core.
+class AgentBatch {
+public:
+  struct Player {
+    // Index into the game states passed to GetPlayerActions.
+    int game = 0;
+    int player_index = 0;
+  };
+
+  virtual ~AgentBatch() {}
+
+  // Returns a move for each of the players, players[i] playing in
+  // *game_states[players[i].game]. Games are identified by their index, so a
+  // game must keep its index from one call to the next.
+  virtual std::vector<bman::MovePlayerRequest>
+  GetPlayerActions(const std::vector<const bman::GameState*>& game_states,
+                   const std::vector<Player>& players) = 0;
+
+  // Forgets what the agents of the game remember (e.g., after a new game was
+  // started with the same index).
+  virtual void ResetGame(int game) = 0;
+
+  // Moves for some players of a single game (game 0).
+  std::vector<bman::MovePlayerRequest>
+  GetPlayerActionsInGame(const bman::GameState& game_state,
+                         const std::vector<int>& player_indices);
+};
+
+// Keeps one agent per player, created on first use by the factory, and asks
+// each in turn.
+class PerPlayerAgentBatch : public AgentBatch {
+public:
+  using AgentFactory =
+      std::function<std::unique_ptr<Agent>(int game, int player_index)>;
+
+  explicit PerPlayerAgentBatch(AgentFactory factory)
+      : factory_(std::move(factory)) {}
+
+  std::vector<bman::MovePlayerRequest>
+  GetPlayerActions(const std::vector<const bman::GameState*>& game_states,
+                   const std::vector<Player>& players) override;
+  void ResetGame(int game) override;
+
+protected:
+  Agent* GetAgent(int game, int player_index);
+
+private:
+  AgentFactory factory_;
+  std::map<std::pair<int, int>, std::unique_ptr<Agent>> agents_;
+};
+
+// SimpleAgents that share one world analysis per game.
+class SimpleAgentBatch : public PerPlayerAgentBatch {
+public:
+  explicit SimpleAgentBatch(const bman::GameConfig& config);
+
+  void ResetGame(int game) override;
+
+private:
+  std::shared_ptr<WorldAnalysisCache> GetAnalysisCache(int game);
+
+  const bman::GameConfig config_;
+  std::map<int, std::shared_ptr<WorldAnalysisCache>> analysis_caches_;
+};
+
+#endif
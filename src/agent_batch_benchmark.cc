@@ -0,0 +1,151 @@
+// Measures how many bots a core can host: plays num_games headless games
+// with num_players bots each, deciding either with one agent per bot or
+// through an AgentBatch, and reports the decision rate of each:
+//
+//   ./bazel-bin/agent_batch_benchmark --num_games=64 --policy=policy.bin
+//
+// Without --policy, the policy bots use a random MLP of the default size.
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "agent_batch.h"
+#include "game.h"
+#include "observation.h"
+#include "policy_agent.h"
+#include "simple_agent.h"
+#include "timer.h"
+
+DEFINE_int32(num_games, 64, "Number of games played side by side");
+DEFINE_int32(num_players, 4, "Bots in each game");
+DEFINE_int32(num_ticks, 60 * 30, "Length of each game in ticks");
+DEFINE_string(policy, "", "Policy exported by python/export_policy.py");
+DEFINE_int32(hidden_units, 64,
+             "Hidden layer size of the random policy (without --policy)");
+
+namespace {
+
+std::shared_ptr<const bman::PolicyModel>
+RandomModel(const bman::GameConfig& config) {
+  auto model = std::make_shared<bman::PolicyModel>();
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> random_weight(-0.1, 0.1);
+  const int sizes[] = {
+      bman::GridObservation(config, model->expand).size() *
+          model->frame_stack,
+      FLAGS_hidden_units, FLAGS_hidden_units, 6};
+  for (int i = 0; i + 1 < 4; ++i) {
+    bman::PolicyModel::Layer layer;
+    layer.inputs = sizes[i];
+    layer.outputs = sizes[i + 1];
+    layer.activation = i + 2 < 4 ? bman::PolicyModel::ACTIVATION_TANH
+                                 : bman::PolicyModel::ACTIVATION_NONE;
+    for (int w = 0; w < layer.inputs * layer.outputs; ++w) {
+      layer.weights.push_back(random_weight(rng));
+    }
+    layer.bias.assign(layer.outputs, 0);
+    model->layers.push_back(layer);
+  }
+  return model;
+}
+
+// Plays the games, getting all the moves of a tick from decide, and returns
+// the decisions per second.
+double Play(const std::function<std::vector<bman::MovePlayerRequest>(
+                const std::vector<const bman::GameState*>&)>& decide) {
+  std::vector<std::unique_ptr<Game>> games;
+  std::vector<const bman::GameState*> game_states;
+  for (int g = 0; g < FLAGS_num_games; ++g) {
+    games.emplace_back(new Game());
+    games.back()->BuildSimpleLevel(2);
+    for (int i = 0; i < FLAGS_num_players; ++i) {
+      games.back()->AddPlayer();
+    }
+    game_states.push_back(&games.back()->game_state());
+  }
+  double decide_millis = 0;
+  for (int tick = 0; tick < FLAGS_num_ticks; ++tick) {
+    bman::Timer timer;
+    const std::vector<bman::MovePlayerRequest> moves = decide(game_states);
+    decide_millis += timer.ElapsedMillis();
+    for (int g = 0; g < FLAGS_num_games; ++g) {
+      games[g]->Step(std::vector<bman::MovePlayerRequest>(
+          moves.begin() + g * FLAGS_num_players,
+          moves.begin() + (g + 1) * FLAGS_num_players));
+    }
+  }
+  return double(FLAGS_num_games) * FLAGS_num_players * FLAGS_num_ticks /
+         (decide_millis / 1000);
+}
+
+void Report(const char* name, double single_rate, double batch_rate) {
+  printf("%-7s per agent %9.0f decisions/s (%5.0f bots/core at 60fps), "
+         "batched %9.0f (%5.0f bots/core), %.2fx\n",
+         name, single_rate, single_rate / 60, batch_rate, batch_rate / 60,
+         batch_rate / single_rate);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  Game level;
+  level.BuildSimpleLevel(2);
+  const bman::GameConfig& config = level.config();
+  std::vector<AgentBatch::Player> players;
+  for (int g = 0; g < FLAGS_num_games; ++g) {
+    for (int i = 0; i < FLAGS_num_players; ++i) {
+      players.push_back({g, i});
+    }
+  }
+
+  // Each SimpleAgent analysing the world on its own, against the batch
+  // sharing one analysis per game.
+  std::vector<std::unique_ptr<Agent>> agents;
+  for (const auto& player : players) {
+    agents.emplace_back(new SimpleAgent(config, player.player_index));
+  }
+  auto decide_each = [&](const std::vector<const bman::GameState*>& states) {
+    std::vector<bman::MovePlayerRequest> moves;
+    for (size_t i = 0; i < players.size(); ++i) {
+      moves.push_back(
+          agents[i]->GetPlayerAction(*states[players[i].game]));
+    }
+    return moves;
+  };
+  const double simple_rate = Play(decide_each);
+  SimpleAgentBatch simple_batch(config);
+  const double simple_batch_rate =
+      Play([&](const std::vector<const bman::GameState*>& states) {
+        return simple_batch.GetPlayerActions(states, players);
+      });
+  Report("simple", simple_rate, simple_batch_rate);
+
+  std::shared_ptr<const bman::PolicyModel> model;
+  if (FLAGS_policy.empty()) {
+    model = RandomModel(config);
+  } else {
+    auto loaded = std::make_shared<bman::PolicyModel>();
+    CHECK(loaded->Load(FLAGS_policy)) << "Unable to load --policy";
+    model = loaded;
+  }
+  agents.clear();
+  for (const auto& player : players) {
+    agents.emplace_back(new PolicyAgent(config, player.player_index, model));
+  }
+  const double policy_rate = Play(decide_each);
+  PolicyAgentBatch policy_batch(config, model);
+  const double policy_batch_rate =
+      Play([&](const std::vector<const bman::GameState*>& states) {
+        return policy_batch.GetPlayerActions(states, players);
+      });
+  Report("policy", policy_rate, policy_batch_rate);
+  return 0;
+}
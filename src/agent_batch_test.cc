@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+
+#include "agent_batch.h"
+#include "game.h"
+#include "simple_agent.h"
+
+namespace {
+
+// Moves right by how many times it was asked.
+class CountingAgent : public Agent {
+public:
+  bman::MovePlayerRequest
+  GetPlayerAction(const bman::GameState& game_state) override {
+    bman::MovePlayerRequest move;
+    move.add_actions()->set_dx(++num_calls_);
+    return move;
+  }
+
+private:
+  int num_calls_ = 0;
+};
+
+} // namespace
+
+TEST(AgentBatchTest, TestPerPlayerAgents) {
+  int num_created = 0;
+  PerPlayerAgentBatch batch([&](int game, int player_index) {
+    num_created++;
+    return std::unique_ptr<Agent>(new CountingAgent());
+  });
+  const bman::GameState game_state;
+  const std::vector<AgentBatch::Player> players = {{0, 0}, {1, 0}, {1, 2}};
+  for (int call = 1; call <= 3; ++call) {
+    const auto moves = batch.GetPlayerActions({&game_state, &game_state},
+                                              players);
+    ASSERT_EQ(3, moves.size());
+    for (const auto& move : moves) {
+      EXPECT_EQ(call, move.actions(0).dx());
+    }
+  }
+  EXPECT_EQ(3, num_created);
+
+  // Only the agents of game 1 start over.
+  batch.ResetGame(1);
+  const auto moves = batch.GetPlayerActions({&game_state, &game_state},
+                                            players);
+  EXPECT_EQ(4, moves[0].actions(0).dx());
+  EXPECT_EQ(1, moves[1].actions(0).dx());
+  EXPECT_EQ(1, moves[2].actions(0).dx());
+  EXPECT_EQ(5, num_created);
+
+  EXPECT_EQ(5, batch.GetPlayerActionsInGame(game_state, {0})[0]
+                   .actions(0)
+                   .dx());
+}
+
+TEST(AgentBatchTest, TestSimpleAgentsAcrossGames) {
+  const int num_games = 3, num_players = 4;
+  std::vector<std::unique_ptr<Game>> games;
+  std::vector<std::unique_ptr<SimpleAgent>> singles;
+  std::vector<AgentBatch::Player> players;
+  for (int g = 0; g < num_games; ++g) {
+    games.emplace_back(new Game());
+    games.back()->BuildSimpleLevel(2);
+    auto analysis_cache = std::make_shared<WorldAnalysisCache>();
+    for (int i = 0; i < num_players; ++i) {
+      games.back()->AddPlayer();
+      singles.emplace_back(
+          new SimpleAgent(games.back()->config(), i, analysis_cache));
+      players.push_back({g, i});
+    }
+  }
+  SimpleAgentBatch batch(games[0]->config());
+  for (int tick = 0; tick < 600; ++tick) {
+    std::vector<const bman::GameState*> game_states;
+    for (const auto& game : games) {
+      game_states.push_back(&game->game_state());
+    }
+    const auto batched = batch.GetPlayerActions(game_states, players);
+    ASSERT_EQ(num_games * num_players, batched.size());
+    for (int g = 0; g < num_games; ++g) {
+      std::vector<bman::MovePlayerRequest> moves;
+      for (int i = 0; i < num_players; ++i) {
+        moves.push_back(singles[g * num_players + i]->GetPlayerAction(
+            games[g]->game_state()));
+        ASSERT_EQ(moves[i].SerializeAsString(),
+                  batched[g * num_players + i].SerializeAsString())
+            << "tick " << tick << " game " << g << " player " << i;
+      }
+      games[g]->Step(moves);
+    }
+  }
+}
+
+int main() { return RUN_ALL_TESTS(); }
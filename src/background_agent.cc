@@ -0,0 +1,121 @@
+#include "background_agent.h"
+
+#include <cmath>
+
+BackgroundAgent::BackgroundAgent(std::unique_ptr<Agent> agent,
+                                 double think_millis)
+    : agent_(std::move(agent)), think_millis_(think_millis) {
+  pthread_mutex_init(&mutex_, nullptr);
+  pthread_cond_init(&request_cond_, nullptr);
+  // Deadlines are bman::Timer::NowMillis() times.
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&decision_cond_, &attr);
+  pthread_condattr_destroy(&attr);
+  held_move_.add_actions();
+  pthread_create(&thread_, nullptr, &BackgroundAgent::StaticLoop, this);
+}
+
+BackgroundAgent::~BackgroundAgent() {
+  pthread_mutex_lock(&mutex_);
+  stopped_ = true;
+  pthread_cond_signal(&request_cond_);
+  pthread_mutex_unlock(&mutex_);
+  pthread_join(thread_, nullptr);
+  pthread_cond_destroy(&decision_cond_);
+  pthread_cond_destroy(&request_cond_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+void* BackgroundAgent::StaticLoop(void* arg) {
+  static_cast<BackgroundAgent*>(arg)->Loop();
+  return nullptr;
+}
+
+void BackgroundAgent::Loop() {
+  bman::GameState game_state;
+  pthread_mutex_lock(&mutex_);
+  while (true) {
+    while (!stopped_ && !has_request_) {
+      pthread_cond_wait(&request_cond_, &mutex_);
+    }
+    if (stopped_)
+      break;
+    game_state.Swap(&request_state_);
+    // Not the frame's deadline, so that the agent can think across frames.
+    const double deadline_millis = request_millis_ + think_millis_;
+    const int64_t id = request_id_;
+    has_request_ = false;
+    pthread_mutex_unlock(&mutex_);
+
+    bman::MovePlayerRequest move =
+        agent_->GetPlayerActionBy(game_state, deadline_millis);
+
+    pthread_mutex_lock(&mutex_);
+    decision_ = std::move(move);
+    decision_id_ = id;
+    fresh_decision_ = true;
+    pthread_cond_broadcast(&decision_cond_);
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+int64_t BackgroundAgent::Request(const bman::GameState& game_state) {
+  if (has_request_) {
+    num_skipped_++;
+  }
+  request_state_ = game_state;
+  request_millis_ = bman::Timer::NowMillis();
+  has_request_ = true;
+  pthread_cond_signal(&request_cond_);
+  return ++request_id_;
+}
+
+bman::MovePlayerRequest
+BackgroundAgent::GetPlayerAction(const bman::GameState& game_state) {
+  pthread_mutex_lock(&mutex_);
+  const int64_t id = Request(game_state);
+  while (decision_id_ < id) {
+    pthread_cond_wait(&decision_cond_, &mutex_);
+  }
+  const bman::MovePlayerRequest move = TakeDecision();
+  pthread_mutex_unlock(&mutex_);
+  return move;
+}
+
+bman::MovePlayerRequest BackgroundAgent::TakeDecision() {
+  fresh_decision_ = false;
+  held_move_ = decision_;
+  for (auto& action : *held_move_.mutable_actions()) {
+    action.clear_place_bomb();
+    action.clear_use_powerup();
+  }
+  return decision_;
+}
+
+bman::MovePlayerRequest
+BackgroundAgent::GetPlayerActionBy(const bman::GameState& game_state,
+                                   double deadline_millis) {
+  struct timespec deadline;
+  deadline.tv_sec = static_cast<time_t>(deadline_millis / 1000);
+  deadline.tv_nsec =
+      static_cast<long>(std::fmod(deadline_millis, 1000.0) * 1000000);
+
+  pthread_mutex_lock(&mutex_);
+  Request(game_state);
+  int rc = 0;
+  while (!fresh_decision_ && rc == 0) {
+    rc = pthread_cond_timedwait(&decision_cond_, &mutex_, &deadline);
+  }
+  bman::MovePlayerRequest move;
+  if (fresh_decision_) {
+    // Possibly for an earlier state, if the agent was late then.
+    move = TakeDecision();
+  } else {
+    num_late_++;
+    move = held_move_;
+  }
+  pthread_mutex_unlock(&mutex_);
+  return move;
+}
@@ -0,0 +1,76 @@
+#ifndef BMAN_BACKGROUND_AGENT_H
+#define BMAN_BACKGROUND_AGENT_H
+
+#include <pthread.h>
+
+#include <limits>
+#include <memory>
+
+#include "agent.h"
+#include "level.grpc.pb.h"
+
+// Runs another agent on a background thread so that its thinking can carry
+// on across frames. GetPlayerActionBy hands the newest state to the thread
+// and waits for a decision until the deadline, but the agent isn't held to
+// it: it thinks for up to think_millis from the request (by default, for
+// as long as its own budget allows, e.g. MctsAgent's budget_ms). If the agent is still
+// thinking, the last decision's movement is held (without placing bombs or
+// using powerups again) and the decision is used on a later frame once it's
+// ready. States that arrive while the agent is busy replace each other, so
+// it always decides on the newest.
+class BackgroundAgent : public Agent {
+public:
+  explicit BackgroundAgent(
+      std::unique_ptr<Agent> agent,
+      double think_millis = std::numeric_limits<double>::infinity());
+  ~BackgroundAgent();
+
+  // Waits for the agent's decision on this state.
+  bman::MovePlayerRequest
+  GetPlayerAction(const bman::GameState& game_state) override;
+  bman::MovePlayerRequest
+  GetPlayerActionBy(const bman::GameState& game_state,
+                    double deadline_millis) override;
+  // Only before the first decision (the agent isn't locked).
+  void Seed(uint32_t seed) override { agent_->Seed(seed); }
+
+  // Decisions that weren't ready by their deadline.
+  int64_t num_late() const { return num_late_; }
+  // States replaced before the agent got to them.
+  int64_t num_skipped() const { return num_skipped_; }
+
+private:
+  static void* StaticLoop(void* arg);
+  void Loop();
+  // Queues the state, returns its request id. Called with mutex_ held.
+  int64_t Request(const bman::GameState& game_state);
+  // Returns the decision and holds its movement. Called with mutex_ held.
+  bman::MovePlayerRequest TakeDecision();
+
+  std::unique_ptr<Agent> agent_;
+  const double think_millis_;
+  pthread_t thread_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t request_cond_;
+  pthread_cond_t decision_cond_;
+  bool stopped_ = false;
+
+  // Newest state to decide on (if has_request_).
+  bool has_request_ = false;
+  bman::GameState request_state_;
+  // When the state was requested.
+  double request_millis_ = 0;
+  int64_t request_id_ = 0;
+
+  // Newest decision (fresh until it's returned) and the request it was for.
+  bman::MovePlayerRequest decision_;
+  bool fresh_decision_ = false;
+  int64_t decision_id_ = 0;
+  // Returned when no fresh decision is ready in time.
+  bman::MovePlayerRequest held_move_;
+
+  int64_t num_late_ = 0;
+  int64_t num_skipped_ = 0;
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "background_agent.h"
+#include "game.h"
+#include "mcts_agent.h"
+#include "timer.h"
+
+namespace {
+
+// Takes delay_ms to decide, moving by the state's clock and placing a bomb.
+class SlowAgent : public Agent {
+public:
+  explicit SlowAgent(int delay_ms) : delay_ms_(delay_ms) {}
+
+  bman::MovePlayerRequest
+  GetPlayerAction(const bman::GameState& game_state) override {
+    usleep(delay_ms_ * 1000);
+    bman::MovePlayerRequest move;
+    auto* action = move.add_actions();
+    action->set_dx(game_state.clock());
+    action->set_place_bomb(true);
+    return move;
+  }
+
+private:
+  const int delay_ms_;
+};
+
+bman::GameState MakeState(int clock) {
+  bman::GameState game_state;
+  game_state.set_clock(clock);
+  return game_state;
+}
+
+} // namespace
+
+TEST(BackgroundAgentTest, TestDecidesInTime) {
+  BackgroundAgent agent(std::unique_ptr<Agent>(new SlowAgent(0)));
+  for (int clock = 1; clock <= 10; ++clock) {
+    const auto move = agent.GetPlayerActionBy(
+        MakeState(clock), bman::Timer::NowMillis() + 1000);
+    EXPECT_EQ(clock, move.actions(0).dx());
+  }
+  EXPECT_EQ(0, agent.num_late());
+}
+
+TEST(BackgroundAgentTest, TestHoldsMovementWhileThinking) {
+  BackgroundAgent agent(std::unique_ptr<Agent>(new SlowAgent(50)));
+  auto move =
+      agent.GetPlayerActionBy(MakeState(1), bman::Timer::NowMillis() + 5);
+  ASSERT_EQ(1, move.actions_size());
+  EXPECT_EQ(0, move.actions(0).dx());
+  EXPECT_EQ(1, agent.num_late());
+
+  // The decision for the first state is used once it's ready.
+  usleep(100 * 1000);
+  move = agent.GetPlayerActionBy(MakeState(2), bman::Timer::NowMillis() + 5);
+  EXPECT_EQ(1, move.actions(0).dx());
+  EXPECT_TRUE(move.actions(0).place_bomb());
+
+  // While the agent is busy, only the movement is held.
+  move = agent.GetPlayerActionBy(MakeState(3), bman::Timer::NowMillis());
+  EXPECT_EQ(1, move.actions(0).dx());
+  EXPECT_FALSE(move.actions(0).place_bomb());
+  EXPECT_EQ(2, agent.num_late());
+
+  // Waits for the decision on the state (the third is replaced).
+  move = agent.GetPlayerAction(MakeState(4));
+  EXPECT_EQ(4, move.actions(0).dx());
+  EXPECT_GE(agent.num_skipped(), 1);
+}
+
+TEST(BackgroundAgentTest, TestDecisionStats) {
+  SlowAgent agent(20);
+  agent.GetPlayerActionWithin(MakeState(1), 5);
+  agent.GetPlayerActionWithin(MakeState(2), 1000);
+  const auto& stats = agent.decision_stats();
+  EXPECT_EQ(2, stats.num_decisions);
+  EXPECT_EQ(1, stats.num_over_budget);
+  EXPECT_GE(stats.max_millis, 20);
+  EXPECT_DOUBLE_EQ(1005, stats.total_budget_millis);
+}
+
+TEST(BackgroundAgentTest, TestThinksAcrossFrames) {
+  Game game;
+  game.BuildSimpleLevel(2);
+  game.AddPlayer();
+  game.AddPlayer();
+  MctsAgent::Options options;
+  options.budget_ms = 40;
+  options.num_trees = 1;
+
+  // In the foreground, the search stops at the frame's deadline.
+  MctsAgent foreground(game.config(), 0, options);
+  foreground.GetPlayerActionBy(game.game_state(),
+                               bman::Timer::NowMillis() + 2);
+
+  // In the background, it carries on for its budget after the frame.
+  auto* mcts = new MctsAgent(game.config(), 0, options);
+  BackgroundAgent background((std::unique_ptr<Agent>(mcts)));
+  background.GetPlayerActionBy(game.game_state(),
+                               bman::Timer::NowMillis() + 2);
+  usleep(100 * 1000);
+  EXPECT_GT(mcts->num_iterations(), 4 * foreground.num_iterations());
+}
+
+int main() { return RUN_ALL_TESTS(); }
@@ -2,13 +2,16 @@
 #include <SDL2/SDL_ttf.h>
 
 #include "agent.h"
+#include "background_agent.h"
 #include "bman_client.h"
 #include "constants.h"
 #include "game_renderer.h"
 #include "game.h"
 #include "glog/logging.h"
 #include "level.grpc.pb.h"
+#include "mcts_agent.h"
 #include "simple_agent.h"
+#include "snapshot_buffer.h"
 #include "timer.h"
 
 #include <gflags/gflags.h>
@@ -17,11 +20,28 @@
 #include <unordered_map>
 
 
-DEFINE_string(agent, "", "Name of agent to use");
+DEFINE_string(agent, "",
+              "Name of agent to use (\"mcts\" or any other name for the "
+              "simple agent), empty to play with the keyboard");
 DEFINE_string(username, "[name]", "User name to use when connecting to server");
 DEFINE_string(server, "", "Server to connect to (with :port)");
 DEFINE_bool(stream, false, "Use streaming RPC");
+DEFINE_bool(async, true,
+            "Send moves to the server without waiting for the response");
 DEFINE_int32(client_delay, 0, "Introduce latency in the client request");
+DEFINE_bool(send_on_change, false,
+            "Only send input to the server when it changes (with --async)");
+DEFINE_string(net_conditions, "",
+              "Emulate network conditions for async requests, e.g., "
+              "\"mobile\" or \"latency=50,jitter=10,loss=0.02\"");
+DEFINE_int32(net_seed, 0, "Random seed for the network emulation");
+DEFINE_bool(interpolate, true,
+            "Interpolate remote players and bombs from a jitter buffer");
+DEFINE_double(agent_budget_ms, 8,
+              "Time the agent has to decide in each frame");
+DEFINE_bool(agent_thread, false,
+            "Let the agent think on a background thread, across frames if "
+            "it needs to");
 
 class UserAgent : public Agent {
 public:
@@ -97,9 +117,18 @@ public:
     int player_index = 0;
     if (!FLAGS_server.empty()) {
       client_ = bman::Client::Create(FLAGS_server, FLAGS_client_delay);
+      if (!FLAGS_net_conditions.empty()) {
+        bman::NetConditions conditions;
+        if (!bman::ParseNetConditions(FLAGS_net_conditions, &conditions)) {
+          LOG(FATAL) << "Invalid --net_conditions";
+        }
+        client_->set_net_conditions(conditions, FLAGS_net_seed);
+      }
+      client_->set_send_on_change(FLAGS_send_on_change);
       auto response = client_->Join(FLAGS_username);
       config = response.game_config();
       player_index = response.player_index();
+      snapshots_.set_local_player_index(player_index);
     } else {
       game_.BuildSimpleLevel(2);
       game_.AddPlayer();
@@ -109,9 +138,15 @@ public:
 
     if (FLAGS_agent.empty()) {
       agent_.reset(new UserAgent(keys_));
+    } else if (FLAGS_agent == "mcts") {
+      agent_.reset(
+          new MctsAgent(config, player_index, MctsAgent::Options()));
     } else {
       agent_.reset(new SimpleAgent(config, player_index));
     }
+    if (!FLAGS_agent.empty() && FLAGS_agent_thread) {
+      agent_.reset(new BackgroundAgent(std::move(agent_)));
+    }
   }
 
   void Loop() {
@@ -123,19 +158,39 @@ public:
 
       // Process input to get user action.
       std::vector<bman::MovePlayerRequest> moves = {
-          agent_->GetPlayerAction(state)};
+          agent_->GetPlayerActionWithin(state, FLAGS_agent_budget_ms)};
+      LOG_EVERY_N(INFO, 600) << "Agent: "
+                             << agent_->decision_stats().ToString();
       // Send the move to server (or advance local game) and get
       // game state so we can render it.
-      if (client_) {
+      if (client_ && FLAGS_async) {
+        // Never block the frame on the network, render whatever state is
+        // the most recent.
+        client_->MovePlayerAsync(moves[0], FLAGS_stream);
+        if (client_->PollState(&state)) {
+          snapshots_.Push(state, bman::Timer::NowMillis());
+        }
+        LOG_EVERY_N(INFO, 60) << "In flight: " << client_->num_in_flight()
+                              << " skipped: " << client_->num_skipped();
+      } else if (client_) {
         state = FLAGS_stream
                     ? client_->StreamingMovePlayer(moves[0]).game_state()
                     : client_->MovePlayer(moves[0]).game_state();
+        snapshots_.Push(state, bman::Timer::NowMillis());
       } else {
         game_.Step(moves);
         state = game_.game_state();
       }
 
-      game_renderer_.Draw(state, SDL_GetWindowSurface(window_));
+      // Remote entities are drawn from the jitter buffer so that they move
+      // smoothly even when responses arrive unevenly.
+      const bman::GameState* render_state = &state;
+      bman::GameState smoothed_state;
+      if (client_ && FLAGS_interpolate &&
+          snapshots_.Sample(bman::Timer::NowMillis(), &smoothed_state)) {
+        render_state = &smoothed_state;
+      }
+      game_renderer_.Draw(*render_state, SDL_GetWindowSurface(window_));
       SDL_UpdateWindowSurface(window_);
 
       timer.Wait(1000 / 60);
@@ -174,6 +229,7 @@ private:
   GameRenderer game_renderer_;
   Game game_;
   std::unique_ptr<bman::Client> client_;
+  bman::SnapshotBuffer snapshots_;
   std::unordered_map<int, int> keys_;
   std::unique_ptr<Agent> agent_;
 };
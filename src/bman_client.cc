@@ -2,11 +2,41 @@
 
 #include "glog/logging.h"
 #include "level.grpc.pb.h"
+#include "timer.h"
+#include <chrono>
 #include <grpcpp/grpcpp.h>
 #include <memory>
 
 namespace bman {
 
+// Async requests that take longer than this are abandoned.
+static constexpr int kAsyncDeadlineMillis = 1000;
+
+static bool SameMovement(const MovePlayerRequest::Action& a,
+                         const MovePlayerRequest::Action& b) {
+  return a.dx() == b.dx() && a.dy() == b.dy() && a.has_dir() == b.has_dir() &&
+         a.dir() == b.dir();
+}
+
+Client::~Client() {
+  if (context_) {
+    context_->TryCancel();
+  }
+  cq_.Shutdown();
+  if (thread_started_) {
+    pthread_join(thread_, nullptr);
+  }
+  if (!thread_started_ || async_streaming_) {
+    // Nothing was waiting on the queue, drain it here.
+    void* tag;
+    bool ok;
+    while (cq_.Next(&tag, &ok)) {
+      delete static_cast<AsyncCall*>(tag);
+    }
+  }
+  pthread_mutex_destroy(&state_mutex_);
+}
+
 JoinResponse Client::Join(const std::string& user) {
   JoinRequest request;
   request.set_user_name(user);
@@ -62,10 +92,222 @@ MovePlayerResponse Client::StreamingMovePlayer(MovePlayerRequest& request) {
   return response;
 }
 
+void Client::MovePlayerAsync(MovePlayerRequest& request, bool streaming) {
+  if (!thread_started_) {
+    StartBackgroundThread(streaming);
+  }
+  AdjustRequest(request);
+  request_queue_.push_back(request);
+  if ((int)request_queue_.size() <= delay_) {
+    return;
+  }
+  MovePlayerRequest next = request_queue_.front();
+  request_queue_.pop_front();
+
+  // Don't lose one-shot actions from input that was held back.
+  if (has_held_request_) {
+    for (const auto& held : held_request_.actions()) {
+      if (!next.actions_size()) {
+        next.add_actions();
+      }
+      auto* action = next.mutable_actions(0);
+      if (held.place_bomb()) {
+        action->set_place_bomb(true);
+      }
+      if (held.use_powerup()) {
+        action->set_use_powerup(true);
+      }
+    }
+    has_held_request_ = false;
+  }
+  // Before CompressInput, which takes the request as sent.
+  if (num_in_flight_ >= kMaxInFlight) {
+    held_request_ = next;
+    has_held_request_ = true;
+    return;
+  }
+  if (send_on_change_ && !CompressInput(next, streaming)) {
+    return;
+  }
+  ++num_in_flight_;
+  if (uplink_) {
+    if (!uplink_->Send(next, Timer::NowMillis(), !streaming)) {
+      --num_in_flight_;
+    }
+    PumpNetwork();
+  } else {
+    SendAsync(next, streaming);
+  }
+}
+
+// Returns false if the request doesn't need to be sent.
+bool Client::CompressInput(MovePlayerRequest& request, bool streaming) {
+  request.set_hold_input(true);
+  if (!request.actions_size()) {
+    request.add_actions();
+  }
+  const MovePlayerRequest::Action& action =
+      request.actions(request.actions_size() - 1);
+  const bool one_shot = action.place_bomb() || action.use_powerup();
+
+  pthread_mutex_lock(&state_mutex_);
+  const bool acked = acked_sequence_ >= input_sequence_;
+  pthread_mutex_unlock(&state_mutex_);
+
+  // Resend if the last input may have been lost.
+  const double now = Timer::NowMillis();
+  const bool resend = !acked && now - last_send_ms_ > kResendMillis;
+  if (!has_last_sent_ || !SameMovement(action, last_sent_action_) ||
+      one_shot || resend) {
+    request.set_input_sequence(++input_sequence_);
+    last_sent_action_ = action;
+    has_last_sent_ = true;
+    last_send_ms_ = now;
+    return true;
+  }
+  num_skipped_++;
+  if (streaming) {
+    return false;
+  }
+  request.clear_actions();
+  return true;
+}
+
+void Client::set_net_conditions(const NetConditions& conditions,
+                                uint32_t seed) {
+  uplink_.reset(new NetLink<MovePlayerRequest>(conditions, seed));
+  downlink_.reset(new NetLink<MovePlayerResponse>(conditions, seed + 1));
+}
+
+void Client::PumpNetwork() {
+  if (!uplink_)
+    return;
+  const double now = Timer::NowMillis();
+  std::vector<MovePlayerRequest> requests;
+  uplink_->Receive(now, &requests);
+  for (const auto& request : requests) {
+    SendAsync(request, async_streaming_);
+  }
+
+  std::vector<MovePlayerResponse> responses;
+  pthread_mutex_lock(&state_mutex_);
+  downlink_->Receive(now, &responses);
+  for (const auto& response : responses) {
+    ApplyResponse(response);
+  }
+  pthread_mutex_unlock(&state_mutex_);
+}
+
+bool Client::PollState(GameState* game_state) {
+  PumpNetwork();
+
+  bool has_new_state = false;
+  pthread_mutex_lock(&state_mutex_);
+  if (has_new_state_) {
+    *game_state = latest_response_.game_state();
+    has_new_state_ = false;
+    has_new_state = true;
+  }
+  pthread_mutex_unlock(&state_mutex_);
+  return has_new_state;
+}
+
+void Client::SendAsync(const MovePlayerRequest& request, bool streaming) {
+  if (streaming) {
+    if (!streaming_->Write(request)) {
+      LOG(ERROR) << "Unable to write request";
+      --num_in_flight_;
+    }
+    return;
+  }
+  AsyncCall* call = new AsyncCall;
+  call->context.set_deadline(
+      std::chrono::system_clock::now() +
+      std::chrono::milliseconds(kAsyncDeadlineMillis));
+  call->reader = stub_->AsyncMovePlayer(&call->context, request, &cq_);
+  call->reader->Finish(&call->response, &call->status, (void*)call);
+}
+
+void Client::HandleResponse(const MovePlayerResponse& response) {
+  pthread_mutex_lock(&state_mutex_);
+  if (downlink_) {
+    downlink_->Send(response, Timer::NowMillis(), !async_streaming_);
+  } else {
+    ApplyResponse(response);
+  }
+  pthread_mutex_unlock(&state_mutex_);
+}
+
+// Requires state_mutex_ to be held.
+void Client::ApplyResponse(const MovePlayerResponse& response) {
+  acked_sequence_ = std::max(acked_sequence_, response.input_sequence());
+  // Responses may arrive out of order, only keep the newest.
+  if (response.game_state().clock() >= latest_response_.game_state().clock()) {
+    latest_response_ = response;
+    has_new_state_ = true;
+    UpdateTiming(response);
+  }
+}
+
+void Client::StartBackgroundThread(bool streaming) {
+  async_streaming_ = streaming;
+  if (streaming) {
+    context_.reset(new ClientContext);
+    streaming_ = stub_->StreamingMovePlayer(context_.get());
+    pthread_create(&thread_, nullptr, &Client::StaticStreamReadLoop, this);
+  } else {
+    pthread_create(&thread_, nullptr, &Client::StaticCompletionLoop, this);
+  }
+  thread_started_ = true;
+}
+
+void Client::CompletionLoop() {
+  void* tag;
+  bool ok;
+  while (cq_.Next(&tag, &ok)) {
+    AsyncCall* call = static_cast<AsyncCall*>(tag);
+    if (ok && call->status.ok()) {
+      HandleResponse(call->response);
+    } else {
+      LOG_EVERY_N(WARNING, 60) << call->status.error_code() << ": "
+                               << call->status.error_message();
+    }
+    delete call;
+    --num_in_flight_;
+  }
+}
+
+void Client::StreamReadLoop() {
+  MovePlayerResponse response;
+  while (streaming_->Read(&response)) {
+    if (send_on_change_) {
+      // The server pushes state every tick, only unacknowledged input is
+      // still in flight.
+      num_in_flight_ =
+          std::max(0, input_sequence_ - response.input_sequence());
+    } else {
+      --num_in_flight_;
+    }
+    HandleResponse(response);
+  }
+}
+
+void* Client::StaticCompletionLoop(void* arg) {
+  static_cast<Client*>(arg)->CompletionLoop();
+  return nullptr;
+}
+
+void* Client::StaticStreamReadLoop(void* arg) {
+  static_cast<Client*>(arg)->StreamReadLoop();
+  return nullptr;
+}
+
 void Client::AdjustRequest(MovePlayerRequest& request) {
   request.set_game_id(game_id_);
   request.set_player_index(player_index_);
+  pthread_mutex_lock(&state_mutex_);
   request.set_client_clock(latest_time_);
+  pthread_mutex_unlock(&state_mutex_);
 }
 
 void Client::UpdateTiming(const MovePlayerResponse& response) {
@@ -1,10 +1,13 @@
+#include <atomic>
 #include <deque>
 #include <grpcpp/grpcpp.h>
 #include <iostream>
 #include <memory>
+#include <pthread.h>
 #include <string>
 
 #include "level.grpc.pb.h"
+#include "net_emulator.h"
 #include <memory>
 
 namespace bman {
@@ -14,25 +17,80 @@ using bman::JoinResponse;
 using bman::MovePlayerRequest;
 using bman::MovePlayerResponse;
 using grpc::Channel;
+using grpc::ClientAsyncResponseReader;
 using grpc::ClientContext;
 using grpc::ClientReaderWriter;
+using grpc::CompletionQueue;
 using grpc::Status;
 
 // A client connection to the server (manages game_id and player_index)
 class Client {
 public:
   Client(std::shared_ptr<Channel> channel, int delay = 0)
-      : stub_(BManService::NewStub(channel)), delay_(delay) {}
+      : stub_(BManService::NewStub(channel)), delay_(delay) {
+    pthread_mutex_init(&state_mutex_, nullptr);
+  }
+  ~Client();
 
   JoinResponse Join(const std::string& user);
   MovePlayerResponse MovePlayer(MovePlayerRequest& request);
   MovePlayerResponse StreamingMovePlayer(MovePlayerRequest& request);
 
+  // Non-blocking variants of the above. The request is sent in the
+  // background (on a completion queue, or on the stream if streaming is
+  // true) and responses are collected by a background thread. Use PollState
+  // to fetch the most recent game state.
+  void MovePlayerAsync(MovePlayerRequest& request, bool streaming = false);
+
+  // Copy the latest game state received into game_state. Returns false (and
+  // leaves game_state alone) if nothing newer has arrived since the last call.
+  bool PollState(GameState* game_state);
+
+  // Number of requests sent that have not yet been answered.
+  int num_in_flight() const { return num_in_flight_; }
+
+  // Route async traffic through an emulated network in both directions.
+  void set_net_conditions(const NetConditions& conditions, uint32_t seed = 0);
+
+  // Only send input (with the async API) when it changes, relying on the
+  // server to hold the last input. When streaming, the server then pushes
+  // the state every tick; unary requests for unchanged input are still sent
+  // (without actions) as they are needed to poll the state.
+  void set_send_on_change(bool send_on_change) {
+    send_on_change_ = send_on_change;
+  }
+  // Number of inputs that were not sent because they had not changed.
+  int num_skipped() const { return num_skipped_; }
+
   static std::unique_ptr<Client> Create(const std::string& server, int delay);
 
+  // Upper bound on outstanding async requests; further input is merged
+  // into a single pending request until a response arrives.
+  static constexpr int kMaxInFlight = 16;
+  // Held input that hasn't been acknowledged after this long is resent.
+  static constexpr int kResendMillis = 200;
+
 private:
+  struct AsyncCall {
+    ClientContext context;
+    MovePlayerResponse response;
+    Status status;
+    std::unique_ptr<ClientAsyncResponseReader<MovePlayerResponse>> reader;
+  };
+
   void AdjustRequest(MovePlayerRequest& request);
   void UpdateTiming(const MovePlayerResponse& response);
+  void SendAsync(const MovePlayerRequest& request, bool streaming);
+  void HandleResponse(const MovePlayerResponse& response);
+  void ApplyResponse(const MovePlayerResponse& response);
+  void PumpNetwork();
+  bool CompressInput(MovePlayerRequest& request, bool streaming);
+  void StartBackgroundThread(bool streaming);
+
+  void CompletionLoop();
+  void StreamReadLoop();
+  static void* StaticCompletionLoop(void* arg);
+  static void* StaticStreamReadLoop(void* arg);
 
   std::unique_ptr<bman::BManService::Stub> stub_;
   std::unique_ptr<ClientReaderWriter<MovePlayerRequest, MovePlayerResponse>>
@@ -45,6 +103,31 @@ private:
   int delay_ = 0;
   int first_move_clock_ = -1;
   int latest_time_ = 0;
+
+  // State used by the async API.
+  CompletionQueue cq_;
+  pthread_t thread_;
+  bool thread_started_ = false;
+  bool async_streaming_ = false;
+  pthread_mutex_t state_mutex_;
+  MovePlayerResponse latest_response_;
+  bool has_new_state_ = false;
+  std::atomic<int> num_in_flight_{0};
+  // Input that could not be sent because too many requests were in flight.
+  MovePlayerRequest held_request_;
+  bool has_held_request_ = false;
+  // Emulated network links (only set when emulating).
+  std::unique_ptr<NetLink<MovePlayerRequest>> uplink_;
+  std::unique_ptr<NetLink<MovePlayerResponse>> downlink_;
+
+  // State for sending input only when it changes.
+  bool send_on_change_ = false;
+  MovePlayerRequest::Action last_sent_action_;
+  bool has_last_sent_ = false;
+  double last_send_ms_ = 0;
+  std::atomic<int> input_sequence_{0};
+  int acked_sequence_ = 0;
+  int num_skipped_ = 0;
 };
 
 } // namespace bman
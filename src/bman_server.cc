@@ -12,11 +12,38 @@
 #include <grpcpp/grpcpp.h>
 #include <grpcpp/health_check_service_interface.h>
 
+#include "agent_batch.h"
 #include "game.h"
+#include "policy_agent.h"
+#include "timer.h"
+#include "trajectory.h"
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <pthread.h>
+#include <time.h>
 
 DEFINE_int32(port, 8888, "Count of items to process");
+DEFINE_int32(bots_per_game, 0,
+             "Bots that the server plays itself in each new game");
+DEFINE_string(bot_agent, "simple",
+              "Agent for the server's bots (simple or policy)");
+DEFINE_string(bot_policy, "",
+              "Policy exported by python/export_policy.py, for policy bots");
+DEFINE_double(max_speed, 0,
+              "Cap on the speed of games, as a multiple of real time (0 for "
+              "none, so unthrottled games step as fast as they can)");
+DEFINE_int32(unthrottled_threads, 0,
+             "Unthrottled games stepping at once (0 for one less than the "
+             "number of cores, leaving a core to real-time games)");
+DEFINE_int32(bot_games, 0,
+             "Instead of serving, play this many unthrottled bot-only games "
+             "(--bots_per_game bots each, 4 if unset), print their scores "
+             "and exit");
+DEFINE_int32(bot_game_ticks, 60 * 60, "Length of the --bot_games in ticks");
+DEFINE_string(record_dir, "",
+              "Directory to record each game's ticks to, as <game id>.traj "
+              "(see trajectory.h)");
 
 using grpc::Server;
 using grpc::ServerBuilder;
@@ -26,45 +53,165 @@ using grpc::ServerReaderWriter;
 using grpc::ServerWriter;
 using grpc::Status;
 
+using bman::AddBotsRequest;
+using bman::AddBotsResponse;
 using bman::JoinRequest;
 using bman::JoinResponse;
 using bman::MovePlayerRequest;
 using bman::MovePlayerResponse;
+using bman::StartGameRequest;
+using bman::StartGameResponse;
+
+// Batch for bots playing the named agent, null if there's no such agent.
+std::unique_ptr<AgentBatch> MakeAgentBatch(const std::string& agent,
+                                           const bman::GameConfig& config) {
+  if (agent == "simple") {
+    return std::unique_ptr<AgentBatch>(new SimpleAgentBatch(config));
+  }
+  if (agent == "policy" && !FLAGS_bot_policy.empty()) {
+    // Loaded once and shared by every game.
+    static std::shared_ptr<const bman::PolicyModel> model = [] {
+      auto model = std::make_shared<bman::PolicyModel>();
+      CHECK(model->Load(FLAGS_bot_policy)) << "Unable to load --bot_policy";
+      return model;
+    }();
+    return std::unique_ptr<AgentBatch>(new PolicyAgentBatch(config, model));
+  }
+  return nullptr;
+}
+
+// Final scores of the players, for the log.
+std::string ScoresString(const bman::GameState& game_state) {
+  std::string scores;
+  for (int i = 0; i < game_state.score_size(); ++i) {
+    scores += absl::StrFormat("%s%d", i ? " " : "", game_state.score(i));
+  }
+  return scores;
+}
+
+// CPU time used by the calling thread.
+double ThreadCpuMillis() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Where to record the game to, empty without --record_dir.
+std::string TrajectoryPath(const std::string& name) {
+  return FLAGS_record_dir.empty() ? ""
+                                  : FLAGS_record_dir + "/" + name + ".traj";
+}
+
+// Limits how many unthrottled games step at once, so that they leave cores
+// for the real-time ones. A game holds a slot for a short slice of ticks and
+// then queues again behind the others (slots are handed out in order).
+class GameSlots {
+public:
+  explicit GameSlots(int num_slots) : num_slots_(num_slots) {
+    pthread_mutex_init(&mutex_, nullptr);
+    pthread_cond_init(&cond_, nullptr);
+  }
+
+  void Acquire() {
+    pthread_mutex_lock(&mutex_);
+    const int64_t ticket = next_ticket_++;
+    while (ticket >= num_released_ + num_slots_) {
+      pthread_cond_wait(&cond_, &mutex_);
+    }
+    pthread_mutex_unlock(&mutex_);
+  }
+  void Release() {
+    pthread_mutex_lock(&mutex_);
+    num_released_++;
+    pthread_cond_broadcast(&cond_);
+    pthread_mutex_unlock(&mutex_);
+  }
+
+private:
+  const int num_slots_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t cond_;
+  int64_t next_ticket_ = 0;
+  int64_t num_released_ = 0;
+};
+
+GameSlots& UnthrottledSlots() {
+  static GameSlots slots(
+      FLAGS_unthrottled_threads > 0
+          ? FLAGS_unthrottled_threads
+          : std::max<int>(1, sysconf(_SC_NPROCESSORS_ONLN) - 1));
+  return slots;
+}
 
 class GameRunner {
 public:
-  GameRunner() {
+  struct Options {
+    // Multiple of real time (60 ticks/s), 0 to step as fast as the CPU
+    // allows (e.g., for bot-only games). Capped by --max_speed.
+    double speed = 1;
+    // Ticks after which the game finishes, 0 to play on forever.
+    int num_ticks = 0;
+    // Called on the game's thread with the final state once it finishes.
+    std::function<void(const bman::GameState&)> on_finished;
+    // Records every tick to this trajectory file, if set.
+    std::string trajectory_path;
+  };
+
+  GameRunner() : GameRunner(Options()) {}
+  explicit GameRunner(const Options& options) : options_(options) {
+    if (FLAGS_max_speed > 0 &&
+        (options_.speed <= 0 || options_.speed > FLAGS_max_speed)) {
+      options_.speed = FLAGS_max_speed;
+    }
     pthread_mutex_init(&game_mutex_, nullptr);
     pthread_mutex_init(&request_mutex_, nullptr);
+    pthread_cond_init(&tick_cond_, nullptr);
+  }
+  ~GameRunner() {
+    stopped_ = true;
+    if (started_)
+      pthread_join(thread_, nullptr);
   }
-  ~GameRunner() { stopped_ = true; }
 
   void Start() {
     game_.BuildSimpleLevel(2);
+    if (!options_.trajectory_path.empty()) {
+      trajectory_.reset(new bman::TrajectoryWriter(game_.config()));
+      if (trajectory_->Open(options_.trajectory_path)) {
+        trajectory_->BeginEpisode(game_.game_state());
+      } else {
+        trajectory_.reset();
+      }
+    }
+    started_ = true;
     pthread_create(&thread_, nullptr, &GameRunner::StaticLoop, this);
   }
   void Loop() {
+    double next_tick_millis = bman::Timer::NowMillis();
     while (!stopped_) {
-      if (game_.game_state().players_size() > 0) {
-        std::vector<int> request_times(game_.game_state().players_size());
-        std::vector<bman::MovePlayerRequest> move_requests(
-            game_.game_state().players_size());
-
-        pthread_mutex_lock(&request_mutex_);
-        for (int i = 0; i < (int)pending_requests_.size(); ++i) {
-          move_requests[i] = pending_requests_[i];
-          request_times[i] =
-              std::max(client_times_[i], pending_requests_[i].client_clock());
-          pending_requests_[i].Clear();
+      if (game_.game_state().players_size() == 0) {
+        bman::Timer::SleepMillis(kTickMillis);
+        next_tick_millis = bman::Timer::NowMillis();
+        continue;
+      }
+      if (options_.speed > 0) {
+        // Catches up after a late tick, but doesn't rush through a backlog.
+        const double now_millis = bman::Timer::NowMillis();
+        next_tick_millis =
+            std::max(next_tick_millis + kTickMillis / options_.speed,
+                     now_millis - kTickMillis);
+        if (next_tick_millis > now_millis) {
+          usleep((next_tick_millis - now_millis) * 1000);
         }
-        pthread_mutex_unlock(&request_mutex_);
-
-        pthread_mutex_lock(&game_mutex_);
-        game_.Step(move_requests);
-        client_times_ = request_times;
-        pthread_mutex_unlock(&game_mutex_);
+        Tick();
+      } else {
+        UnthrottledSlots().Acquire();
+        bman::Timer slice;
+        while (!stopped_ && slice.ElapsedMillis() < kSliceMillis) {
+          Tick();
+        }
+        UnthrottledSlots().Release();
       }
-      usleep(1000 / 60.0 * 1000);
     }
   }
   static void* StaticLoop(void* arg) {
@@ -73,29 +220,100 @@ public:
     return nullptr;
   }
 
-  bman::GameConfig AddPlayer() {
+  bman::GameConfig AddPlayer(int* player_index) {
     pthread_mutex_lock(&game_mutex_);
     auto config = game_.config();
-    game_.AddPlayer();
-    client_times_.push_back(0);
+    *player_index = AddPlayerLocked(true);
     pthread_mutex_unlock(&game_mutex_);
     return config;
   }
 
+  // Adds bots that play the agent from the next tick. Returns false if
+  // there's no such agent.
+  bool AddBots(int num_bots, const std::string& agent,
+               std::vector<int>* player_indices) {
+    pthread_mutex_lock(&game_mutex_);
+    BotGroup& group = bots_[agent];
+    if (!group.batch) {
+      group.batch = MakeAgentBatch(agent, game_.config());
+      if (!group.batch) {
+        bots_.erase(agent);
+        pthread_mutex_unlock(&game_mutex_);
+        return false;
+      }
+    }
+    for (int i = 0; i < num_bots; ++i) {
+      AgentBatch::Player player;
+      player.player_index = AddPlayerLocked(false);
+      group.players.push_back(player);
+      player_indices->push_back(player.player_index);
+    }
+    pthread_mutex_unlock(&game_mutex_);
+    return true;
+  }
+
   int GetState(int player_index, bman::GameState* game_state) {
     int client_time = 0;
     pthread_mutex_lock(&game_mutex_);
     *game_state = game_.game_state();
     if (player_index >= 0 && player_index < (int32_t)client_times_.size())
       client_time = client_times_[player_index];
+    if (player_index >= 0 && player_index < (int32_t)pending_events_.size()) {
+      game_state->mutable_events()->Swap(&pending_events_[player_index]);
+      pending_events_[player_index].Clear();
+    }
     pthread_mutex_unlock(&game_mutex_);
     return client_time;
   }
 
+  // Wait (up to timeout_ms) for the game clock to advance past clock.
+  bool WaitForTick(int clock, int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += timeout_ms * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+
+    pthread_mutex_lock(&game_mutex_);
+    int rc = 0;
+    while (game_.game_state().clock() <= clock && rc == 0) {
+      rc = pthread_cond_timedwait(&tick_cond_, &game_mutex_, &deadline);
+    }
+    const bool advanced = game_.game_state().clock() > clock;
+    pthread_mutex_unlock(&game_mutex_);
+    return advanced;
+  }
+
+  int GetInputSequence(int player_index) {
+    int sequence = 0;
+    pthread_mutex_lock(&request_mutex_);
+    if (player_index >= 0 && player_index < (int)input_sequences_.size())
+      sequence = input_sequences_[player_index];
+    pthread_mutex_unlock(&request_mutex_);
+    return sequence;
+  }
+
   void PushRequest(const bman::MovePlayerRequest& request) {
     pthread_mutex_lock(&request_mutex_);
     if ((int)request.player_index() >= (int)pending_requests_.size()) {
       pending_requests_.resize(request.player_index() + 1);
+      held_actions_.resize(request.player_index() + 1);
+      hold_input_.resize(request.player_index() + 1);
+      input_sequences_.resize(request.player_index() + 1);
+    }
+
+    if (request.hold_input() && request.actions_size()) {
+      const int index = request.player_index();
+      // Held input that arrives late (or twice) is stale.
+      if (request.input_sequence() <= input_sequences_[index]) {
+        pthread_mutex_unlock(&request_mutex_);
+        return;
+      }
+      input_sequences_[index] = request.input_sequence();
+      hold_input_[index] = true;
+      held_actions_[index] = request.actions(request.actions_size() - 1);
+      held_actions_[index].clear_place_bomb();
+      held_actions_[index].clear_use_powerup();
     }
 
     pending_requests_[request.player_index()].set_player_index(
@@ -110,46 +328,325 @@ public:
     pthread_mutex_unlock(&request_mutex_);
   }
 
-  bool stopped_ = false;
+  // Steps the game with the pending requests and the bots' moves.
+  void Tick() {
+    std::vector<int> request_times(game_.game_state().players_size());
+    std::vector<bman::MovePlayerRequest> move_requests(
+        game_.game_state().players_size());
+
+    pthread_mutex_lock(&request_mutex_);
+    for (int i = 0; i < (int)pending_requests_.size(); ++i) {
+      move_requests[i] = pending_requests_[i];
+      request_times[i] =
+          std::max(client_times_[i], pending_requests_[i].client_clock());
+      pending_requests_[i].Clear();
+    }
+    // Players that only send input when it changes keep moving with
+    // their last input.
+    for (int i = 0;
+         i < (int)held_actions_.size() && i < (int)move_requests.size(); ++i) {
+      if (hold_input_[i] && !move_requests[i].actions_size()) {
+        *move_requests[i].add_actions() = held_actions_[i];
+      }
+    }
+    pthread_mutex_unlock(&request_mutex_);
+
+    pthread_mutex_lock(&game_mutex_);
+    DecideBots(&move_requests);
+    const bool stepped = game_.Step(move_requests);
+    if (trajectory_ && stepped) {
+      // No agent of the server's is learning, so there's no action or
+      // reward.
+      trajectory_->Record(move_requests, 1, -1, 0, nullptr, false,
+                          game_.game_state());
+    }
+    client_times_ = request_times;
+    // Clients can miss ticks, so each client's events are kept until
+    // they next get the state. Bots never get it, so none are kept for them.
+    for (int i = 0; i < (int)pending_events_.size(); ++i) {
+      if (!is_client_[i]) {
+        continue;
+      }
+      auto& events = pending_events_[i];
+      for (const auto& event : game_.game_state().events()) {
+        *events.Add() = event;
+      }
+      if (events.size() > kMaxPendingEvents) {
+        events.DeleteSubrange(0, events.size() - kMaxPendingEvents);
+      }
+    }
+    const bool finished = options_.num_ticks > 0 &&
+                          game_.game_state().clock() >= options_.num_ticks;
+    bman::GameState final_state;
+    if (finished) {
+      final_state = game_.game_state();
+      if (trajectory_) {
+        trajectory_->Close();
+      }
+    }
+    pthread_cond_broadcast(&tick_cond_);
+    pthread_mutex_unlock(&game_mutex_);
+
+    if (finished) {
+      stopped_ = true;
+      if (options_.on_finished)
+        options_.on_finished(final_state);
+    }
+  }
+
+  // Adds a player controlled by a client, or by a bot. Called with
+  // game_mutex_ held.
+  int AddPlayerLocked(bool client) {
+    const int player_index = game_.game_state().players_size();
+    game_.AddPlayer();
+    if (trajectory_) {
+      trajectory_->SetState(game_.game_state());
+    }
+    client_times_.push_back(0);
+    pending_events_.emplace_back();
+    is_client_.push_back(client);
+    return player_index;
+  }
+
+  // Fills in the moves of the bots, which decide on the game state in place
+  // of a client. Called with game_mutex_ held.
+  void DecideBots(std::vector<bman::MovePlayerRequest>* move_requests) {
+    if (bots_.empty())
+      return;
+    const double start_millis = ThreadCpuMillis();
+    const std::vector<const bman::GameState*> game_states = {
+        &game_.game_state()};
+    for (auto& it : bots_) {
+      BotGroup& group = it.second;
+      std::vector<bman::MovePlayerRequest> moves =
+          group.batch->GetPlayerActions(game_states, group.players);
+      for (size_t i = 0; i < moves.size(); ++i) {
+        const int player_index = group.players[i].player_index;
+        // Players added since the requests were sized wait a tick.
+        if (player_index < (int)move_requests->size()) {
+          moves[i].set_player_index(player_index);
+          (*move_requests)[player_index].Swap(&moves[i]);
+        }
+      }
+      num_bot_decisions_ += moves.size();
+    }
+    bot_cpu_millis_ += ThreadCpuMillis() - start_millis;
+    if (game_.game_state().clock() % kBotStatsTicks == 0) {
+      LOG(INFO) << "Bots used "
+                << 1000 * bot_cpu_millis_ /
+                       std::max<int64_t>(1, num_bot_decisions_)
+                << "us CPU per decision (" << num_bot_decisions_
+                << " decisions)";
+    }
+  }
+
+  // Events kept for a player that hasn't got the state for a while.
+  static constexpr int kMaxPendingEvents = 1024;
+  // Ticks between logging the bots' CPU cost.
+  static constexpr int kBotStatsTicks = 60 * 60;
+  static constexpr double kTickMillis = 1000 / 60.0;
+  // Time an unthrottled game steps for before letting other games in.
+  static constexpr double kSliceMillis = 2;
+
+  // Bots playing the same agent, deciding together.
+  struct BotGroup {
+    std::unique_ptr<AgentBatch> batch;
+    std::vector<AgentBatch::Player> players;
+  };
+
+  Options options_;
+  std::atomic<bool> stopped_{false};
+  bool started_ = false;
   pthread_t thread_;
   pthread_mutex_t game_mutex_;
   pthread_mutex_t request_mutex_;
+  pthread_cond_t tick_cond_;
   Game game_;
+  // Used with game_mutex_ held.
+  std::unique_ptr<bman::TrajectoryWriter> trajectory_;
   std::vector<int> client_times_;
   std::vector<bman::MovePlayerRequest> pending_requests_;
+  // Events since each client's player last got the state (always empty for
+  // bots).
+  std::vector<google::protobuf::RepeatedPtrField<bman::GameEvent>>
+      pending_events_;
+  std::vector<bool> is_client_;
+
+  // Last input for players that only send input when it changes.
+  std::vector<bman::MovePlayerRequest::Action> held_actions_;
+  std::vector<bool> hold_input_;
+  std::vector<int> input_sequences_;
+
+  // By agent name.
+  std::map<std::string, BotGroup> bots_;
+  double bot_cpu_millis_ = 0;
+  int64_t num_bot_decisions_ = 0;
+};
+
+// Writes the game state to a stream every tick. Used for clients that only
+// send input when it changes, and so don't get a response per tick.
+class StatePusher {
+public:
+  StatePusher(GameRunner* runner, int player_index,
+              ServerReaderWriter<MovePlayerResponse, MovePlayerRequest>* stream)
+      : runner_(runner), player_index_(player_index), stream_(stream) {
+    pthread_create(&thread_, nullptr, &StatePusher::StaticLoop, this);
+  }
+  ~StatePusher() {
+    stopped_ = true;
+    pthread_join(thread_, nullptr);
+  }
+
+  void Loop() {
+    int clock = -1;
+    while (!stopped_) {
+      if (!runner_->WaitForTick(clock, 100))
+        continue;
+      MovePlayerResponse response;
+      response.set_client_clock(
+          runner_->GetState(player_index_, response.mutable_game_state()));
+      response.set_input_sequence(runner_->GetInputSequence(player_index_));
+      clock = response.game_state().clock();
+      if (!stream_->Write(response))
+        break;
+    }
+  }
+  static void* StaticLoop(void* arg) {
+    static_cast<StatePusher*>(arg)->Loop();
+    return nullptr;
+  }
+
+private:
+  GameRunner* runner_;
+  int player_index_;
+  ServerReaderWriter<MovePlayerResponse, MovePlayerRequest>* stream_;
+  pthread_t thread_;
+  std::atomic<bool> stopped_{false};
 };
 
 class BManServiceImpl final : public bman::BManService::Service {
 public:
-  BManServiceImpl(const std::string&) { num_clients_ = 0; }
+  BManServiceImpl(const std::string&) {
+    num_clients_ = 0;
+    pthread_mutex_init(&games_mutex_, nullptr);
+  }
 
   Status Join(ServerContext* context, const JoinRequest* request,
               JoinResponse* reply) override {
-    if (!games[request->game_id()]) {
-      games[request->game_id()].reset(new GameRunner);
-      games[request->game_id()]->Start();
-    }
+    int player_index = 0;
+    *reply->mutable_game_config() =
+        GetOrStartGame(request->game_id())->AddPlayer(&player_index);
     LOG(INFO) << "Player " << request->user_name()
-              << " has connected as player=" << num_clients_;
+              << " has connected as player=" << player_index;
     reply->set_status_message(
-        absl::StrFormat("Hello %s %d", request->user_name(), num_clients_));
-    reply->set_player_index(num_clients_);
-    *reply->mutable_game_config() = games[request->game_id()]->AddPlayer();
+        absl::StrFormat("Hello %s %d", request->user_name(), player_index));
+    reply->set_player_index(player_index);
 
     ++num_clients_;
     return Status::OK;
   }
 
+  Status AddBots(ServerContext* context, const AddBotsRequest* request,
+                 AddBotsResponse* reply) override {
+    const std::string agent =
+        request->agent().empty() ? FLAGS_bot_agent : request->agent();
+    std::vector<int> player_indices;
+    if (!GetOrStartGame(request->game_id())
+             ->AddBots(request->num_bots(), agent, &player_indices)) {
+      return Status(grpc::StatusCode::INVALID_ARGUMENT,
+                    "Unknown agent " + agent);
+    }
+    for (int player_index : player_indices) {
+      reply->add_player_indices(player_index);
+    }
+    reply->set_status_message(
+        absl::StrFormat("Added %d %s bots", request->num_bots(), agent));
+    return Status::OK;
+  }
+
+  Status StartGame(ServerContext* context, const StartGameRequest* request,
+                   StartGameResponse* reply) override {
+    pthread_mutex_lock(&games_mutex_);
+    std::unique_ptr<GameRunner>& game = games[request->game_id()];
+    if (game) {
+      pthread_mutex_unlock(&games_mutex_);
+      return Status(grpc::StatusCode::ALREADY_EXISTS,
+                    "Game " + request->game_id() + " has already started");
+    }
+    GameRunner::Options options;
+    if (request->has_speed())
+      options.speed = request->speed();
+    options.num_ticks = request->num_ticks();
+    const std::string game_id = request->game_id();
+    options.trajectory_path = TrajectoryPath(game_id);
+    options.on_finished = [game_id](const bman::GameState& game_state) {
+      LOG(INFO) << "Game " << game_id << " finished after "
+                << game_state.clock() << " ticks, scores "
+                << ScoresString(game_state);
+    };
+    game.reset(new GameRunner(options));
+    game->Start();
+    std::vector<int> player_indices;
+    const std::string agent =
+        request->agent().empty() ? FLAGS_bot_agent : request->agent();
+    if (request->num_bots() > 0 &&
+        !game->AddBots(request->num_bots(), agent, &player_indices)) {
+      // Drops the game, so that a retry with a known agent can start it.
+      games.erase(game_id);
+      pthread_mutex_unlock(&games_mutex_);
+      return Status(grpc::StatusCode::INVALID_ARGUMENT,
+                    "Unknown agent " + agent);
+    }
+    pthread_mutex_unlock(&games_mutex_);
+    reply->set_status_message(absl::StrFormat(
+        "Started %s at %gx with %d bots", game_id, options.speed,
+        request->num_bots()));
+    return Status::OK;
+  }
+
+  // Starts the game (with --bots_per_game bots) if it's new.
+  GameRunner* GetOrStartGame(const std::string& game_id) {
+    pthread_mutex_lock(&games_mutex_);
+    std::unique_ptr<GameRunner>& game = games[game_id];
+    if (!game) {
+      GameRunner::Options options;
+      options.trajectory_path = TrajectoryPath(game_id);
+      game.reset(new GameRunner(options));
+      game->Start();
+      std::vector<int> player_indices;
+      if (FLAGS_bots_per_game > 0) {
+        CHECK(game->AddBots(FLAGS_bots_per_game, FLAGS_bot_agent,
+                            &player_indices))
+            << "Unknown --bot_agent " << FLAGS_bot_agent;
+      }
+    }
+    GameRunner* runner = game.get();
+    pthread_mutex_unlock(&games_mutex_);
+    return runner;
+  }
+
+  // Returns the game, or null if it hasn't started.
+  GameRunner* FindGame(const std::string& game_id) {
+    pthread_mutex_lock(&games_mutex_);
+    auto it = games.find(game_id);
+    GameRunner* runner = it == games.end() ? nullptr : it->second.get();
+    pthread_mutex_unlock(&games_mutex_);
+    return runner;
+  }
+
   Status MovePlayer(ServerContext* context, const MovePlayerRequest* request,
                     MovePlayerResponse* response) {
-    if (!games[request->game_id()])
+    GameRunner* game = FindGame(request->game_id());
+    if (!game)
       return Status::OK;
 
     // Push the move request and return whatever the current game state is
-    games[request->game_id()]->PushRequest(*request);
-    int client_clock = games[request->game_id()]->GetState(
-        request->player_index(), response->mutable_game_state());
+    game->PushRequest(*request);
+    int client_clock =
+        game->GetState(request->player_index(), response->mutable_game_state());
     response->set_client_clock(client_clock);
+    response->set_input_sequence(
+        game->GetInputSequence(request->player_index()));
     return Status::OK;
   }
 
@@ -158,25 +655,39 @@ public:
                       ServerReaderWriter<MovePlayerResponse, MovePlayerRequest>*
                           stream) override {
     MovePlayerRequest request;
+    std::unique_ptr<StatePusher> pusher;
     while (stream->Read(&request)) {
-      if (!games[request.game_id()])
+      GameRunner* game = FindGame(request.game_id());
+      if (!game)
         return Status::OK;
 
       // Push the move request
-      games[request.game_id()]->PushRequest(request);
+      game->PushRequest(request);
+
+      // Clients that send input only on change get the state every tick.
+      if (request.hold_input()) {
+        if (!pusher) {
+          pusher.reset(new StatePusher(game, request.player_index(), stream));
+        }
+        continue;
+      }
       // and return whatever the current game state is
       MovePlayerResponse response;
-      games[request.game_id()]->GetState(request.player_index(),
-                                         response.mutable_game_state());
-      int client_clock = games[request.game_id()]->GetState(
-          request.player_index(), response.mutable_game_state());
+      int client_clock =
+          game->GetState(request.player_index(), response.mutable_game_state());
       response.set_client_clock(client_clock);
+      response.set_input_sequence(
+          game->GetInputSequence(request.player_index()));
       stream->Write(response);
     }
     return Status::OK;
   }
 
   int num_clients_;
+  // Games are only removed if they fail to start, before their runner is
+  // handed out, so handed out runners stay valid; games_mutex_ only guards
+  // the map itself.
+  pthread_mutex_t games_mutex_;
   std::map<std::string, std::unique_ptr<GameRunner>> games;
 };
 
@@ -196,8 +707,66 @@ void RunServer(uint16_t port) {
   server->Wait();
 }
 
+// Plays --bot_games unthrottled games side by side and prints their scores.
+void PlayBotGames() {
+  pthread_mutex_t mutex;
+  pthread_cond_t finished_cond;
+  pthread_mutex_init(&mutex, nullptr);
+  pthread_cond_init(&finished_cond, nullptr);
+  int num_finished = 0;
+  std::vector<bman::GameState> final_states(FLAGS_bot_games);
+
+  bman::Timer timer;
+  std::vector<std::unique_ptr<GameRunner>> games;
+  for (int i = 0; i < FLAGS_bot_games; ++i) {
+    GameRunner::Options options;
+    options.speed = 0;
+    options.num_ticks = FLAGS_bot_game_ticks;
+    options.trajectory_path = TrajectoryPath(absl::StrFormat("bot_game_%d", i));
+    options.on_finished = [&, i](const bman::GameState& game_state) {
+      pthread_mutex_lock(&mutex);
+      final_states[i] = game_state;
+      num_finished++;
+      pthread_cond_signal(&finished_cond);
+      pthread_mutex_unlock(&mutex);
+    };
+    games.emplace_back(new GameRunner(options));
+    games.back()->Start();
+    std::vector<int> player_indices;
+    CHECK(games.back()->AddBots(
+        FLAGS_bots_per_game > 0 ? FLAGS_bots_per_game : 4, FLAGS_bot_agent,
+        &player_indices))
+        << "Unknown --bot_agent " << FLAGS_bot_agent;
+  }
+  pthread_mutex_lock(&mutex);
+  while (num_finished < FLAGS_bot_games) {
+    pthread_cond_wait(&finished_cond, &mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+  const double seconds = timer.ElapsedMillis() / 1000;
+  games.clear();
+
+  int64_t num_ticks = 0;
+  for (int i = 0; i < FLAGS_bot_games; ++i) {
+    std::cout << "Game " << i << ": " << ScoresString(final_states[i])
+              << std::endl;
+    num_ticks += final_states[i].clock();
+  }
+  std::cout << absl::StrFormat(
+                   "%d games in %.1fs (%.0f ticks/s, %.0fx real time)",
+                   FLAGS_bot_games, seconds, num_ticks / seconds,
+                   num_ticks / seconds / 60)
+            << std::endl;
+  pthread_cond_destroy(&finished_cond);
+  pthread_mutex_destroy(&mutex);
+}
+
 int main(int argc, char** argv) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (FLAGS_bot_games > 0) {
+    PlayBotGames();
+    return 0;
+  }
   RunServer(FLAGS_port);
   return 0;
 }
@@ -0,0 +1,130 @@
+// Plays headless matches between agents on all cores and reports win rates,
+// score distributions and Elo ratings:
+//
+//   ./bazel-bin/bman_tournament --agents=simple,mcts --num_matches=1000
+//
+// Matches are reproducible from --seed (whatever the number of threads), so
+// a change to an agent can be compared against the same set of games.
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <map>
+#include <sstream>
+
+#include "mcts_agent.h"
+#include "policy_agent.h"
+#include "simple_agent.h"
+#include "timer.h"
+#include "tournament.h"
+
+DEFINE_string(agents, "simple,mcts",
+              "Comma separated agents to play (simple, mcts, policy or idle)");
+DEFINE_int32(num_matches, 1000, "Number of matches");
+DEFINE_int32(num_players, 4, "Players in each match");
+DEFINE_int32(num_ticks, 60 * 60, "Length of each match in ticks");
+DEFINE_int32(num_threads, 0, "Threads to play on (0 for one per core)");
+DEFINE_int32(seed, 1, "Seed for the matches");
+DEFINE_bool(random_levels, true,
+            "Play each match on a level generated from its seed, rather "
+            "than all on the simple level (where deterministic agents "
+            "replay the same few games)");
+DEFINE_int32(num_bootstrap, 100,
+             "Resamples for the rating confidence intervals");
+DEFINE_string(policy, "",
+              "Policy exported by python/export_policy.py, for the policy "
+              "agent");
+DEFINE_int32(mcts_iterations, 32,
+             "Iterations per decision for mcts (a fixed count rather than a "
+             "time budget, so that results are reproducible)");
+
+namespace {
+
+// Never moves, a baseline that every other agent should beat.
+class IdleAgent : public Agent {
+public:
+  bman::MovePlayerRequest
+  GetPlayerAction(const bman::GameState& game_state) override {
+    bman::MovePlayerRequest move;
+    move.add_actions();
+    return move;
+  }
+};
+
+std::map<std::string, bman::AgentFactory> GetAgentFactories() {
+  std::map<std::string, bman::AgentFactory> factories;
+  factories["simple"] = [](const bman::GameConfig& config, int player_index) {
+    return std::unique_ptr<Agent>(new SimpleAgent(config, player_index));
+  };
+  factories["mcts"] = [](const bman::GameConfig& config, int player_index) {
+    MctsAgent::Options options;
+    options.max_iterations = FLAGS_mcts_iterations;
+    options.num_trees = 1;
+    return std::unique_ptr<Agent>(
+        new MctsAgent(config, player_index, options));
+  };
+  factories["policy"] = [](const bman::GameConfig& config, int player_index) {
+    // Loaded once and shared by every match.
+    static std::shared_ptr<const bman::PolicyModel> model = [] {
+      auto model = std::make_shared<bman::PolicyModel>();
+      CHECK(model->Load(FLAGS_policy)) << "Unable to load --policy";
+      return model;
+    }();
+    return std::unique_ptr<Agent>(
+        new PolicyAgent(config, player_index, model));
+  };
+  factories["idle"] = [](const bman::GameConfig& config, int player_index) {
+    return std::unique_ptr<Agent>(new IdleAgent);
+  };
+  return factories;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  bman::Tournament::Options options;
+  options.num_matches = FLAGS_num_matches;
+  options.num_players = FLAGS_num_players;
+  options.num_ticks = FLAGS_num_ticks;
+  options.num_threads = FLAGS_num_threads > 0
+                            ? FLAGS_num_threads
+                            : sysconf(_SC_NPROCESSORS_ONLN);
+  options.seed = FLAGS_seed;
+  options.random_levels = FLAGS_random_levels;
+  options.num_bootstrap = FLAGS_num_bootstrap;
+  CHECK(options.num_players >= 2 && options.num_players <= 4)
+      << "The level has 4 spawn points";
+
+  bman::Tournament tournament(options);
+  const auto factories = GetAgentFactories();
+  std::stringstream agents(FLAGS_agents);
+  std::string name;
+  while (std::getline(agents, name, ',')) {
+    auto it = factories.find(name);
+    CHECK(it != factories.end()) << "Unknown agent " << name;
+    tournament.AddAgent(name, it->second);
+  }
+
+  bman::Timer timer;
+  tournament.Run();
+  const double seconds = timer.ElapsedMillis() / 1000;
+  printf("%d matches of %d ticks in %.1fs on %d threads (%.1f matches/s)\n\n",
+         options.num_matches, options.num_ticks, seconds, options.num_threads,
+         options.num_matches / seconds);
+
+  printf("%-10s %6s %15s %14s %5s %5s %5s %7s %22s\n", "agent", "games",
+         "win rate", "score", "p10", "p50", "p90", "deaths", "elo (95% ci)");
+  for (const auto& stats : tournament.Stats()) {
+    printf("%-10s %6d %7.3f +-%5.3f %6.1f +-%5.1f %5d %5d %5d %7.2f %6.0f "
+           "[%6.0f,%6.0f]\n",
+           stats.name.c_str(), stats.num_games, stats.win_rate,
+           stats.win_rate_error, stats.mean_score, stats.stddev_score,
+           stats.p10_score, stats.median_score, stats.p90_score,
+           stats.mean_deaths, stats.elo, stats.elo_low, stats.elo_high);
+  }
+  return 0;
+}
@@ -0,0 +1,251 @@
+#include "danger_map.h"
+
+#include "constants.h"
+#include "game.h"
+
+DangerMap::DangerMap(const bman::GameConfig& config,
+                     const bman::GameState& game_state)
+    : width_(config.level_width()), height_(config.level_height()),
+      clock_(game_state.clock()) {
+  wall_.resize(width_ * height_);
+  for (int y = 0; y < height_; ++y) {
+    for (int x = 0; x < width_; ++x) {
+      wall_[Index(Point2i(x, y))] = Game::IsStaticBrick(config, x, y);
+    }
+  }
+  Rebuild(game_state);
+}
+
+void DangerMap::Update(const bman::GameState& game_state) {
+  const int num_tracked = bombs_.size();
+  bool consistent = game_state.clock() >= clock_ &&
+                    game_state.level().bombs_size() >= num_tracked;
+  clock_ = game_state.clock();
+  for (int i = 0; consistent && i < num_tracked; ++i) {
+    consistent = Matches(bombs_[i], game_state.level().bombs(i));
+  }
+  if (!consistent) {
+    Rebuild(game_state);
+    return;
+  }
+  // New bombs are always added to the end.
+  for (int i = num_tracked; i < game_state.level().bombs_size(); ++i) {
+    AddBomb(game_state.level().bombs(i));
+  }
+}
+
+void DangerMap::AddBomb(const bman::LevelState::Bomb& bomb) {
+  TrackedBomb tracked = Track(bomb);
+
+  // A flame that crosses the bomb would detonate it early (and stop there).
+  bool rebuild = false;
+  for (const auto& point : tracked.path) {
+    const CellFlames& cell = flames_[Index(point.pos)];
+    if (cell.size && cell.flames[cell.size - 1].end > clock_) {
+      rebuild = true;
+    }
+  }
+  bombs_.push_back(tracked);
+  std::vector<int> cells, bricks, bombs;
+  if (!rebuild) {
+    Explode(bombs_.size() - 1, &cells, &bricks, &bombs);
+    // Detonating another bomb early, or breaking a brick that stops
+    // another flame, changes the rest of the map.
+    rebuild = !bombs.empty();
+    for (int brick : bricks) {
+      rebuild |= brick_time_[brick] != kNever;
+    }
+  }
+  if (rebuild) {
+    Recompute();
+    return;
+  }
+  num_incremental_updates_++;
+  const int t = tracked.detonation;
+  for (int cell : cells) {
+    Mark(cell, {t, t + kExplosionTimer});
+  }
+  for (int brick : bricks) {
+    brick_time_[brick] = t;
+  }
+}
+
+void DangerMap::Rebuild(const bman::GameState& game_state) {
+  clock_ = game_state.clock();
+  base_brick_time_.assign(width_ * height_, -1);
+  for (const auto& brick : game_state.level().bricks()) {
+    const Point2i pt(brick.x(), brick.y());
+    if (brick.solid() && InBounds(pt)) {
+      base_brick_time_[Index(pt)] = kNever;
+    }
+  }
+  flames_.assign(width_ * height_, CellFlames());
+  for (const auto& explosion : game_state.level().explosions()) {
+    for (const auto& point : explosion.points()) {
+      Mark(Index(Point2i(point.x(), point.y())),
+           {clock_, clock_ + explosion.timer()});
+    }
+  }
+  base_flames_ = flames_;
+
+  brick_time_ = base_brick_time_;
+  bombs_.clear();
+  for (const auto& bomb : game_state.level().bombs()) {
+    bombs_.push_back(Track(bomb));
+  }
+  Recompute();
+}
+
+void DangerMap::Recompute() {
+  num_rebuilds_++;
+  brick_time_ = base_brick_time_;
+  flames_ = base_flames_;
+
+  // Bombs are detonated in order of time (like Dijkstra's algorithm), a
+  // bomb reached by a flame detonates on the same tick.
+  std::vector<bool> done(bombs_.size(), false);
+  for (auto& bomb : bombs_) {
+    bomb.detonation = bomb.clock + bomb.bomb.timer();
+  }
+  std::vector<int> cells, bricks, bombs;
+  for (size_t n = 0; n < bombs_.size(); ++n) {
+    int next = -1;
+    for (size_t i = 0; i < bombs_.size(); ++i) {
+      if (!done[i] &&
+          (next < 0 || bombs_[i].detonation < bombs_[next].detonation)) {
+        next = i;
+      }
+    }
+    done[next] = true;
+    cells.clear();
+    bricks.clear();
+    bombs.clear();
+    Explode(next, &cells, &bricks, &bombs);
+
+    const int t = bombs_[next].detonation;
+    for (int cell : cells) {
+      Mark(cell, {t, t + kExplosionTimer});
+    }
+    for (int brick : bricks) {
+      brick_time_[brick] = t;
+    }
+    for (int bomb : bombs) {
+      bombs_[bomb].detonation = t;
+    }
+  }
+}
+
+void DangerMap::Mark(int index, Flame flame) {
+  CellFlames& cell = flames_[index];
+  Flame flames[kMaxFlames + 1];
+  int n = 0;
+  for (int i = 0; i < cell.size; ++i) {
+    const Flame& other = cell.flames[i];
+    if (other.end < flame.start || flame.end < other.start) {
+      flames[n++] = other;
+    } else {
+      flame.start = std::min(flame.start, other.start);
+      flame.end = std::max(flame.end, other.end);
+    }
+  }
+  int pos = n++;
+  for (; pos > 0 && flames[pos - 1].start > flame.start; --pos) {
+    flames[pos] = flames[pos - 1];
+  }
+  flames[pos] = flame;
+  if (n > kMaxFlames) {
+    // Out of room, treat the last two as one long flame.
+    flames[n - 2].end = flames[n - 1].end;
+    n--;
+  }
+  cell.size = n;
+  std::copy(flames, flames + n, cell.flames);
+}
+
+DangerMap::TrackedBomb
+DangerMap::Track(const bman::LevelState::Bomb& bomb) const {
+  TrackedBomb tracked;
+  tracked.bomb = bomb;
+  tracked.clock = clock_;
+  tracked.detonation = clock_ + bomb.timer();
+
+  // Same movement as Game::Step, with bricks and the bombs tracked so far
+  // as obstacles.
+  PathPoint point = {Point2i(bomb.x(), bomb.y()), bomb.has_dir()};
+  tracked.path.push_back(point);
+  int moving_x = bomb.moving_x();
+  int moving_y = bomb.moving_y();
+  for (int k = 1; k < bomb.timer() && point.moving; ++k) {
+    const int dx = kDirs[bomb.dir()][0];
+    const int dy = kDirs[bomb.dir()][1];
+    const Point2i next(GridRound(moving_x + (kSubpixelSize / 2 + 1) * dx),
+                       GridRound(moving_y + (kSubpixelSize / 2 + 1) * dy));
+    if (next == point.pos || CanBombMove(next, clock_ + k)) {
+      moving_x += kBombSpeed * dx;
+      moving_y += kBombSpeed * dy;
+      point.pos = Point2i(GridRound(moving_x), GridRound(moving_y));
+    } else {
+      point.moving = false;
+    }
+    tracked.path.push_back(point);
+  }
+  return tracked;
+}
+
+bool DangerMap::Matches(const TrackedBomb& tracked,
+                        const bman::LevelState::Bomb& bomb) const {
+  const int elapsed = clock_ - tracked.clock;
+  const PathPoint& point = tracked.At(clock_);
+  return bomb.player_id() == tracked.bomb.player_id() &&
+         bomb.strength() == tracked.bomb.strength() &&
+         bomb.timer() == tracked.bomb.timer() - elapsed &&
+         Point2i(bomb.x(), bomb.y()) == point.pos &&
+         bomb.has_dir() == point.moving;
+}
+
+bool DangerMap::CanBombMove(const Point2i& pt, int t) const {
+  if (!InBounds(pt) || wall_[Index(pt)] || brick_time_[Index(pt)] > t)
+    return false;
+  for (const auto& bomb : bombs_) {
+    if (bomb.detonation >= t && bomb.At(t - 1).pos == pt)
+      return false;
+  }
+  return true;
+}
+
+void DangerMap::Explode(int bomb_index, std::vector<int>* cells,
+                        std::vector<int>* bricks,
+                        std::vector<int>* bombs) const {
+  const TrackedBomb& bomb = bombs_[bomb_index];
+  // The bomb detonates (on the tick that produces clock t) before it moves.
+  const int t = bomb.detonation;
+  const Point2i center = bomb.At(t - 1).pos;
+  cells->push_back(Index(center));
+  for (const auto& dir : kDirs) {
+    for (int i = 1; i <= bomb.bomb.strength(); ++i) {
+      const Point2i pt(center.x + dir[0] * i, center.y + dir[1] * i);
+      if (!InBounds(pt) || wall_[Index(pt)])
+        break;
+      const int index = Index(pt);
+      cells->push_back(index);
+      if (brick_time_[index] > t) {
+        bricks->push_back(index);
+        break;
+      }
+      // Flames stop at bombs that haven't gone off yet.
+      bool hit_bomb = false;
+      for (size_t j = 0; j < bombs_.size(); ++j) {
+        const auto& other = bombs_[j];
+        if ((int)j == bomb_index || other.detonation < t ||
+            other.At(t - 1).pos != pt)
+          continue;
+        hit_bomb = true;
+        if (other.detonation > t) {
+          bombs->push_back(j);
+        }
+      }
+      if (hit_bomb)
+        break;
+    }
+  }
+}
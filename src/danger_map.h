@@ -0,0 +1,140 @@
+#ifndef BMAN_DANGER_MAP_H
+#define BMAN_DANGER_MAP_H
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "level.grpc.pb.h"
+#include "point.h"
+
+// Predicts, for every cell, when it will be covered by flame. Bombs are
+// detonated in order of their timers, following chain reactions (a flame
+// that reaches a bomb detonates it on the same tick), bricks that stop a
+// flame until an earlier explosion has destroyed them, and the path of
+// kicked bombs. Times are kept as absolute clocks so the map stays valid as
+// the game advances; Update only rebuilds when the bombs change other than
+// by new ones being placed.
+class DangerMap {
+public:
+  static constexpr int kNever = std::numeric_limits<int>::max();
+
+  DangerMap(const bman::GameConfig& config, const bman::GameState& game_state);
+
+  // Advances the map to a later state of the same game.
+  void Update(const bman::GameState& game_state);
+
+  // Adds a bomb whose timer is relative to the current clock (e.g., a bomb
+  // that an agent is thinking about placing).
+  void AddBomb(const bman::LevelState::Bomb& bomb);
+
+  int clock() const { return clock_; }
+
+  // Ticks until flame first covers pt: 0 if it's burning now, kNever if no
+  // bomb will reach it.
+  int TicksUntilFlame(const Point2i& pt) const {
+    const CellFlames& cell = flames_[Index(pt)];
+    for (int i = 0; i < cell.size; ++i) {
+      if (cell.flames[i].end > clock_)
+        return std::max(0, cell.flames[i].start - clock_);
+    }
+    return kNever;
+  }
+  // Ticks until pt is clear of all current and predicted flames.
+  int TicksUntilSafe(const Point2i& pt) const {
+    const CellFlames& cell = flames_[Index(pt)];
+    return cell.size ? std::max(0, cell.flames[cell.size - 1].end - clock_)
+                     : 0;
+  }
+  // Whether standing on pt will be deadly the given number of ticks from
+  // now.
+  bool InFlame(const Point2i& pt, int ticks) const {
+    const int t = clock_ + ticks;
+    const CellFlames& cell = flames_[Index(pt)];
+    for (int i = 0; i < cell.size; ++i) {
+      if (cell.flames[i].start <= t && t < cell.flames[i].end)
+        return true;
+    }
+    return false;
+  }
+  // Predicted ticks until the i'th bomb (in the order of the state's bombs,
+  // followed by added bombs) detonates.
+  int TicksUntilDetonation(int bomb_index) const {
+    return bombs_[bomb_index].detonation - clock_;
+  }
+  int num_bombs() const { return bombs_.size(); }
+
+  // Number of times the detonations were recomputed from scratch, and the
+  // number of bombs added without doing so.
+  int num_rebuilds() const { return num_rebuilds_; }
+  int num_incremental_updates() const { return num_incremental_updates_; }
+
+private:
+  // Clocks [start, end) that a cell is covered by flame.
+  struct Flame {
+    int start;
+    int end;
+  };
+  // Non-overlapping flames of a cell, in order. Kept inline so that the
+  // map is cheap to copy; if there are too many, the last ones are merged.
+  static constexpr int kMaxFlames = 4;
+  struct CellFlames {
+    int size = 0;
+    Flame flames[kMaxFlames];
+  };
+  struct PathPoint {
+    Point2i pos;
+    bool moving;
+  };
+  struct TrackedBomb {
+    bman::LevelState::Bomb bomb;
+    // Clock at which the bomb had bomb.timer() and was at path[0].
+    int clock;
+    // Position after each tick (until it stops or detonates).
+    std::vector<PathPoint> path;
+    int detonation;
+
+    const PathPoint& At(int t) const {
+      const int k = std::max(0, std::min<int>(t - clock, path.size() - 1));
+      return path[k];
+    }
+  };
+
+  int Index(const Point2i& pt) const { return pt.y * width_ + pt.x; }
+  bool InBounds(const Point2i& pt) const {
+    return pt.x >= 0 && pt.y >= 0 && pt.x < width_ && pt.y < height_;
+  }
+
+  void Rebuild(const bman::GameState& game_state);
+  // Detonates the bombs in order, starting from the explosions and bricks
+  // of the last rebuild.
+  void Recompute();
+  TrackedBomb Track(const bman::LevelState::Bomb& bomb) const;
+  bool Matches(const TrackedBomb& tracked,
+               const bman::LevelState::Bomb& bomb) const;
+  bool CanBombMove(const Point2i& pt, int t) const;
+  // Finds the cells covered by the bomb's flame, the bricks that stop it,
+  // and the bombs that it detonates early.
+  void Explode(int bomb_index, std::vector<int>* cells,
+               std::vector<int>* bricks, std::vector<int>* bombs) const;
+  // Adds a flame to a cell, merging it with any that it overlaps.
+  void Mark(int index, Flame flame);
+
+  int width_;
+  int height_;
+  int clock_;
+  // Static walls.
+  std::vector<bool> wall_;
+  // Clock at which the brick in each cell is destroyed (kNever if it
+  // isn't, -1 for no brick).
+  std::vector<int> brick_time_;
+  std::vector<CellFlames> flames_;
+  // The above at the last rebuild (i.e., without any bombs).
+  std::vector<int> base_brick_time_;
+  std::vector<CellFlames> base_flames_;
+  std::vector<TrackedBomb> bombs_;
+  int num_rebuilds_ = 0;
+  int num_incremental_updates_ = 0;
+};
+
+#endif
@@ -0,0 +1,200 @@
+
+#include <gtest/gtest.h>
+#include <set>
+
+#include "danger_map.h"
+#include "game.h"
+#include "simple_agent.h"
+
+class DangerMapTest : public testing::Test {
+public:
+  void SetUp() override {
+    // A padding larger than the level gives a level without any bricks.
+    game_.BuildSimpleLevel(kDefaultWidth);
+    game_.AddPlayer();
+    // Keep the player out of the way (and give them plenty of bombs).
+    game_.game_state().mutable_players(0)->set_x(16 * kSubpixelSize + 32);
+    game_.game_state().mutable_players(0)->set_y(12 * kSubpixelSize + 32);
+    game_.game_state().mutable_players(0)->set_num_bombs(10);
+  }
+
+  bman::LevelState::Bomb* AddBomb(int x, int y, int timer, int strength) {
+    auto* bomb = game_.game_state().mutable_level()->add_bombs();
+    bomb->set_x(x);
+    bomb->set_y(y);
+    bomb->set_timer(timer);
+    bomb->set_strength(strength);
+    bomb->set_player_id(0);
+    game_.game_state().mutable_players(0)->set_num_used_bombs(
+        game_.game_state().level().bombs_size());
+    return bomb;
+  }
+
+  void AddBrick(int x, int y) {
+    auto* brick = game_.game_state().mutable_level()->add_bricks();
+    brick->set_x(x);
+    brick->set_y(y);
+    brick->set_solid(true);
+  }
+
+  // Steps the game, checking that the cells covered by explosions are
+  // exactly the ones predicted.
+  void ExpectMatchesGame(const DangerMap& danger, int num_ticks) {
+    for (int tick = 1; tick <= num_ticks; ++tick) {
+      game_.Step(std::vector<bman::MovePlayerRequest>(1));
+      std::set<std::pair<int, int>> burning;
+      for (const auto& explosion : game_.game_state().level().explosions()) {
+        for (const auto& point : explosion.points()) {
+          burning.insert(std::make_pair(point.x(), point.y()));
+        }
+      }
+      for (int y = 0; y < kDefaultHeight; ++y) {
+        for (int x = 0; x < kDefaultWidth; ++x) {
+          EXPECT_EQ(burning.count(std::make_pair(x, y)) > 0,
+                    danger.InFlame(Point2i(x, y), tick))
+              << "at " << x << "," << y << " tick " << tick;
+        }
+      }
+    }
+  }
+
+protected:
+  Game game_;
+};
+
+TEST_F(DangerMapTest, TestSingleBomb) {
+  AddBomb(2, 0, 10, 2);
+  DangerMap danger(game_.config(), game_.game_state());
+  EXPECT_EQ(10, danger.TicksUntilDetonation(0));
+  EXPECT_EQ(10, danger.TicksUntilFlame(Point2i(2, 0)));
+  EXPECT_EQ(10, danger.TicksUntilFlame(Point2i(0, 0)));
+  EXPECT_EQ(10, danger.TicksUntilFlame(Point2i(4, 0)));
+  EXPECT_EQ(10, danger.TicksUntilFlame(Point2i(2, 2)));
+  EXPECT_EQ(DangerMap::kNever, danger.TicksUntilFlame(Point2i(5, 0)));
+  EXPECT_EQ(DangerMap::kNever, danger.TicksUntilFlame(Point2i(3, 1)));
+  EXPECT_EQ(10 + kExplosionTimer, danger.TicksUntilSafe(Point2i(2, 0)));
+  EXPECT_EQ(0, danger.TicksUntilSafe(Point2i(5, 0)));
+  EXPECT_FALSE(danger.InFlame(Point2i(2, 0), 9));
+  EXPECT_TRUE(danger.InFlame(Point2i(2, 0), 10));
+  EXPECT_FALSE(danger.InFlame(Point2i(2, 0), 10 + kExplosionTimer));
+  ExpectMatchesGame(danger, 50);
+}
+
+TEST_F(DangerMapTest, TestChainReaction) {
+  AddBomb(0, 0, 10, 2);
+  AddBomb(2, 0, 100, 2);
+  AddBomb(6, 0, 200, 2);
+  DangerMap danger(game_.config(), game_.game_state());
+  EXPECT_EQ(10, danger.TicksUntilDetonation(1));
+  EXPECT_EQ(10, danger.TicksUntilFlame(Point2i(4, 0)));
+  EXPECT_EQ(10, danger.TicksUntilFlame(Point2i(2, 2)));
+  // The third bomb isn't reached by the chain.
+  EXPECT_EQ(200, danger.TicksUntilDetonation(2));
+  EXPECT_EQ(200, danger.TicksUntilFlame(Point2i(7, 0)));
+  ExpectMatchesGame(danger, 250);
+}
+
+TEST_F(DangerMapTest, TestBricksStopFlames) {
+  AddBrick(1, 0);
+  AddBomb(0, 0, 10, 3);
+  AddBomb(4, 0, 50, 4);
+  DangerMap danger(game_.config(), game_.game_state());
+  EXPECT_EQ(10, danger.TicksUntilFlame(Point2i(1, 0)));
+  // Once the first bomb has broken the brick the second flame passes.
+  EXPECT_EQ(50, danger.TicksUntilFlame(Point2i(2, 0)));
+  EXPECT_EQ(10, danger.TicksUntilFlame(Point2i(0, 0)));
+  EXPECT_EQ(50 + kExplosionTimer, danger.TicksUntilSafe(Point2i(0, 0)));
+  ExpectMatchesGame(danger, 100);
+}
+
+TEST_F(DangerMapTest, TestMovingBomb) {
+  auto* bomb = AddBomb(2, 4, 60, 1);
+  bomb->set_dir(bman::DIR_RIGHT);
+  bomb->set_moving_x(2 * kSubpixelSize + kSubpixelSize / 2);
+  bomb->set_moving_y(4 * kSubpixelSize + kSubpixelSize / 2);
+  AddBomb(8, 4, 200, 1);
+  DangerMap danger(game_.config(), game_.game_state());
+  EXPECT_EQ(DangerMap::kNever, danger.TicksUntilFlame(Point2i(1, 4)));
+  EXPECT_EQ(60, danger.TicksUntilFlame(Point2i(6, 4)));
+  ExpectMatchesGame(danger, 100);
+}
+
+TEST_F(DangerMapTest, TestIncrementalUpdate) {
+  AddBomb(0, 0, 100, 2);
+  DangerMap danger(game_.config(), game_.game_state());
+  EXPECT_EQ(1, danger.num_rebuilds());
+
+  // Place a bomb out of reach of the first.
+  game_.game_state().mutable_players(0)->set_x(8 * kSubpixelSize + 32);
+  game_.game_state().mutable_players(0)->set_y(6 * kSubpixelSize + 32);
+  std::vector<bman::MovePlayerRequest> moves(1);
+  moves[0].add_actions()->set_place_bomb(true);
+  game_.Step(moves);
+  danger.Update(game_.game_state());
+  EXPECT_EQ(1, danger.num_rebuilds());
+  EXPECT_EQ(1, danger.num_incremental_updates());
+  EXPECT_EQ(2, danger.num_bombs());
+  EXPECT_EQ(99, danger.TicksUntilFlame(Point2i(0, 0)));
+  EXPECT_EQ(kDefaultBombTimer, danger.TicksUntilFlame(Point2i(8, 6)));
+
+  // The map is the same as building one from scratch.
+  DangerMap fresh(game_.config(), game_.game_state());
+  for (int y = 0; y < kDefaultHeight; ++y) {
+    for (int x = 0; x < kDefaultWidth; ++x) {
+      EXPECT_EQ(fresh.TicksUntilFlame(Point2i(x, y)),
+                danger.TicksUntilFlame(Point2i(x, y)));
+    }
+  }
+
+  // Detonating a bomb early (e.g., with a detonator) forces a rebuild.
+  game_.game_state().mutable_level()->mutable_bombs(0)->set_timer(1);
+  danger.Update(game_.game_state());
+  EXPECT_EQ(2, danger.num_rebuilds());
+  EXPECT_EQ(1, danger.TicksUntilFlame(Point2i(0, 0)));
+}
+
+TEST_F(DangerMapTest, TestHypotheticalBomb) {
+  AddBomb(0, 0, 100, 2);
+  DangerMap danger(game_.config(), game_.game_state());
+  bman::LevelState::Bomb bomb;
+  bomb.set_x(2);
+  bomb.set_y(0);
+  bomb.set_strength(2);
+  bomb.set_timer(kDefaultBombTimer);
+  danger.AddBomb(bomb);
+  // In range of the first bomb, so it chains.
+  EXPECT_EQ(2, danger.num_rebuilds());
+  EXPECT_EQ(100, danger.TicksUntilDetonation(1));
+  EXPECT_EQ(100, danger.TicksUntilFlame(Point2i(4, 0)));
+}
+
+TEST(DangerMapGameTest, TestPredictsAgentGame) {
+  Game game;
+  game.BuildSimpleLevel(2);
+  std::vector<std::unique_ptr<Agent>> agents;
+  for (int i = 0; i < 4; ++i) {
+    game.AddPlayer();
+    agents.emplace_back(new SimpleAgent(game.config(), i));
+  }
+  DangerMap danger(game.config(), game.game_state());
+  int num_burning = 0;
+  for (int tick = 0; tick < 5000; ++tick) {
+    std::vector<bman::MovePlayerRequest> moves;
+    for (auto& agent : agents) {
+      moves.push_back(agent->GetPlayerAction(game.game_state()));
+    }
+    game.Step(moves);
+    // Every burning cell was predicted by the previous tick's map.
+    for (const auto& explosion : game.game_state().level().explosions()) {
+      for (const auto& point : explosion.points()) {
+        EXPECT_TRUE(danger.InFlame(Point2i(point.x(), point.y()), 1));
+        num_burning++;
+      }
+    }
+    danger.Update(game.game_state());
+  }
+  EXPECT_GT(num_burning, 0);
+  EXPECT_GT(danger.num_incremental_updates(), 0);
+}
+
+int main() { return RUN_ALL_TESTS(); }
@@ -17,6 +17,8 @@
 class Game {
 public:
   Game() {}
+  Game(const bman::GameConfig& config, const bman::GameState& game_state)
+      : config_(config), game_state_(game_state) {}
 
   void BuildSimpleLevel(int padding) {
     config_.set_level_width(kDefaultWidth);
@@ -69,6 +71,13 @@ public:
     *game_state_.mutable_level() = *level_state;
   }
 
+  // Starts a game of the level (e.g., from LevelGenerator), without players.
+  void BuildLevel(const bman::GameConfig& config) {
+    config_ = config;
+    game_state_.Clear();
+    *game_state_.mutable_level() = config_.level_state();
+  }
+
   void AddPlayer() {
     game_state_.add_score(0);
     int player_index = game_state_.players_size();
@@ -82,6 +91,12 @@ public:
   }
 
   Point2i GetSpawnPoint(int player_index) {
+    if (config_.spawn_points_size()) {
+      const auto& point =
+          config_.spawn_points(player_index % config_.spawn_points_size());
+      return Point2i(point.x() * kSubpixelSize + kSubpixelSize / 2,
+                     point.y() * kSubpixelSize + kSubpixelSize / 2);
+    }
     if (player_index % 4 == 0) {
       return Point2i(kSubpixelSize / 2, kSubpixelSize / 2);
     } else if (player_index % 4 == 1) {
@@ -101,12 +116,95 @@ public:
       LOG(ERROR) << "Move request has invalid number of players";
       return false;
     }
-    // Build map of bombs and bricks
-    BombMap bomb_map = MakeBombMap(game_state_);
+    BrickMap brick_map = MakeBrickMap();
+    StepWithBricks(move_requests, brick_map);
+    return true;
+  }
+
+  // Steps up to num_frames times with the same moves, placing bombs only on
+  // the first frame, as an agent holding its action over a frame skip does.
+  // Stops after the frame in which player stop_player (if not -1) dies.
+  // Returns the number of frames stepped, each exactly as Step would; only
+  // the brick map, the bulk of a Step's cost, is built once rather than
+  // every frame (no frame adds or removes bricks).
+  int StepFrames(std::vector<bman::MovePlayerRequest> move_requests,
+                 int num_frames, int stop_player = -1) {
+    if ((int)move_requests.size() != (int)game_state_.players_size()) {
+      LOG(ERROR) << "Move request has invalid number of players";
+      return 0;
+    }
+    if (stop_player != -1) {
+      CHECK_GE(stop_player, 0);
+      CHECK_LT(stop_player, game_state_.players_size());
+    }
+    BrickMap brick_map = MakeBrickMap();
+    for (int frame = 0; frame < num_frames; ++frame) {
+      const bool was_alive =
+          stop_player >= 0 && game_state_.players(stop_player).health() > 0;
+      StepWithBricks(move_requests, brick_map);
+      if (was_alive && game_state_.players(stop_player).health() <= 0) {
+        return frame + 1;
+      }
+      if (frame == 0) {
+        for (auto& move : move_requests) {
+          for (auto& action : *move.mutable_actions()) {
+            action.clear_place_bomb();
+          }
+        }
+      }
+    }
+    return num_frames;
+  }
+
+  void set_game_state(const bman::GameState& state) { game_state_ = state; }
+  const bman::GameConfig& config() const { return config_; }
+  const bman::GameState& game_state() const { return game_state_; }
+  bman::GameState& game_state() { return game_state_; }
+
+  bool IsStaticBrick(int x, int y) const {
+    return IsStaticBrick(config_, x, y);
+  }
+
+  static bool IsStaticBrick(const bman::GameConfig& config, int x, int y) {
+    return IsStaticBrick(config.level_width(), config.level_height(), x, y);
+  }
+
+  static bool IsStaticBrick(int width, int height, int x, int y) {
+    if (x < 0 || y < 0 || x >= width || y >= height)
+      return true;
+    return (x % 2 == 1 && y % 2 == 1);
+  }
+
+  static BombMap MakeBombMap(bman::GameState& game_state) {
+    BombMap bomb_map = {};
+    for (auto& bomb : *game_state.mutable_level()->mutable_bombs()) {
+      bomb_map[Point2i(bomb.x(), bomb.y())] = &bomb;
+    }
+    return bomb_map;
+  }
+  static BombMapConst MakeBombMap(const bman::GameState& game_state) {
+    BombMapConst bomb_map = {};
+    for (const auto& bomb : game_state.level().bombs()) {
+      bomb_map[Point2i(bomb.x(), bomb.y())] = &bomb;
+    }
+    return bomb_map;
+  }
+
+private:
+  BrickMap MakeBrickMap() {
     BrickMap brick_map;
     for (auto& brick : *game_state_.mutable_level()->mutable_bricks()) {
       brick_map[Point2i(brick.x(), brick.y())] = &brick;
     }
+    return brick_map;
+  }
+
+  // A Step, with the map of the state's bricks.
+  void StepWithBricks(
+      const std::vector<bman::MovePlayerRequest>& move_requests,
+      BrickMap& brick_map) {
+    game_state_.clear_events();
+    BombMap bomb_map = MakeBombMap(game_state_);
 
     // Apply any player actions (e.g., move, drop bomb, etc.)
     std::vector<bman::LevelState::Bomb> new_bombs =
@@ -117,7 +215,14 @@ public:
       }
       bomb_map = MakeBombMap(game_state_);
     }
-    GridMap grid_map(config_, game_state_);
+    // Only needed (and built) if a bomb is moving.
+    std::unique_ptr<GridMap> grid_map;
+    for (const auto& bomb : game_state_.level().bombs()) {
+      if (bomb.has_dir()) {
+        grid_map.reset(new GridMap(config_, game_state_));
+        break;
+      }
+    }
 
     // Decrement timer on any active explosions
     for (auto& explosion : *game_state_.mutable_level()->mutable_explosions()) {
@@ -155,7 +260,7 @@ public:
             GridRound(bomb.moving_y() +
                       (kSubPixelSize / 2 + 1) * kDirs[bomb.dir()][1]));
         Point2i cur_point(bomb.x(), bomb.y());
-        if (next_point == cur_point || grid_map.CanMove(next_point)) {
+        if (next_point == cur_point || grid_map->CanMove(next_point)) {
           bomb.set_moving_x(bomb.moving_x() +
                             kBombSpeed * kDirs[bomb.dir()][0]);
           bomb.set_moving_y(bomb.moving_y() +
@@ -175,41 +280,8 @@ public:
     RemoveInactiveBombs();
 
     game_state_.set_clock(game_state_.clock() + 1);
-    return true;
-  }
-
-  void set_game_state(const bman::GameState& state) { game_state_ = state; }
-  const bman::GameConfig& config() const { return config_; }
-  const bman::GameState& game_state() const { return game_state_; }
-  bman::GameState& game_state() { return game_state_; }
-
-  bool IsStaticBrick(int x, int y) const {
-    return IsStaticBrick(config_, x, y);
-  }
-
-  static bool IsStaticBrick(const bman::GameConfig& config, int x, int y) {
-    if (x < 0 || y < 0 || x >= config.level_width() ||
-        y >= config.level_height())
-      return true;
-    return (x % 2 == 1 && y % 2 == 1);
-  }
-
-  static BombMap MakeBombMap(bman::GameState& game_state) {
-    BombMap bomb_map = {};
-    for (auto& bomb : *game_state.mutable_level()->mutable_bombs()) {
-      bomb_map[Point2i(bomb.x(), bomb.y())] = &bomb;
-    }
-    return bomb_map;
-  }
-  static BombMapConst MakeBombMap(const bman::GameState& game_state) {
-    BombMapConst bomb_map = {};
-    for (const auto& bomb : game_state.level().bombs()) {
-      bomb_map[Point2i(bomb.x(), bomb.y())] = &bomb;
-    }
-    return bomb_map;
   }
 
-private:
   std::vector<bman::LevelState::Bomb>
   MovePlayers(const std::vector<bman::MovePlayerRequest>& move_requests,
               const BrickMap& brick_map, const BombMap& bomb_map) {
@@ -234,6 +306,8 @@ private:
             Point2i pt = GetSpawnPoint(player_index);
             player->set_x(pt.x);
             player->set_y(pt.y);
+            AddEvent(bman::GameEvent::EVENT_PLAYER_RESPAWNED, GridRound(pt.x),
+                     GridRound(pt.y), player_index);
           }
           continue;
         } else if (player->state() == bman::PlayerState::STATE_SPAWNING) {
@@ -342,6 +416,8 @@ private:
         bomb->set_dir(player->dir());
         bomb->set_moving_x(bomb->x() * kSubpixelSize + kSubpixelSize / 2);
         bomb->set_moving_y(bomb->y() * kSubpixelSize + kSubpixelSize / 2);
+        AddEvent(bman::GameEvent::EVENT_BOMB_KICKED, bomb->x(), bomb->y(),
+                 player_index);
       }
     } else if (player->powerup() == bman::PUP_DETONATOR) {
       // Find the players earliest bomb and explode it.
@@ -360,6 +436,9 @@ private:
       if (brick->has_powerup()) {
         game_state_.set_score(player_index,
                               game_state_.score(player_index) + kPointsPowerUp);
+        AddEvent(bman::GameEvent::EVENT_POWERUP_TAKEN, brick->x(), brick->y(),
+                 player_index)
+            ->set_powerup(brick->powerup());
         switch (brick->powerup()) {
         case bman::PUP_NONE:
           break;
@@ -400,6 +479,7 @@ private:
       bomb.set_timer(kDefaultBombTimer + 1);
       bomb.set_player_id(player_index);
       player->set_num_used_bombs(player->num_used_bombs() + 1);
+      AddEvent(bman::GameEvent::EVENT_BOMB_PLACED, cur.x, cur.y, player_index);
     }
   }
 
@@ -434,6 +514,8 @@ private:
                    bman::LevelState::Bomb* bomb,
                    bman::LevelState::Explosion* explosion) {
     bomb->set_timer(0); // Marks bomb as inactive
+    AddEvent(bman::GameEvent::EVENT_BOMB_EXPLODED, bomb->x(), bomb->y(),
+             bomb->player_id());
 
     // Give the player back a bomb
     {
@@ -483,6 +565,13 @@ private:
                                 game_state_.score(bomb->player_id()) +
                                     kPointsBrick);
           brick_map[point]->set_solid(false);
+          AddEvent(bman::GameEvent::EVENT_BRICK_DESTROYED, point.x, point.y,
+                   bomb->player_id());
+          if (brick_map[point]->has_powerup()) {
+            AddEvent(bman::GameEvent::EVENT_POWERUP_REVEALED, point.x, point.y,
+                     bomb->player_id())
+                ->set_powerup(brick_map[point]->powerup());
+          }
           break;
         }
         // Explode other bombs
@@ -496,6 +585,16 @@ private:
     }
   }
 
+  bman::GameEvent* AddEvent(bman::GameEvent::Type type, int x, int y,
+                            int player_id) {
+    auto* event = game_state_.add_events();
+    event->set_type(type);
+    event->set_x(x);
+    event->set_y(y);
+    event->set_player_id(player_id);
+    return event;
+  }
+
   void MaybeDoDamage(bman::PlayerState& player, int player_index,
                      int bomb_player_id = -1) {
     if (player.health() > 0) {
@@ -504,6 +603,9 @@ private:
         VLOG(2) << "Player " << player_index << " is dead\n";
         player.set_state(bman::PlayerState::STATE_DYING);
         player.set_anim_counter(0);
+        AddEvent(bman::GameEvent::EVENT_PLAYER_DIED, GridRound(player.x()),
+                 GridRound(player.y()), player_index)
+            ->set_bomb_player_id(bomb_player_id);
 
         if (bomb_player_id == -1 || bomb_player_id == player_index) {
           game_state_.set_score(player_index,
@@ -1,5 +1,6 @@
 
 #include <gtest/gtest.h>
+#include <random>
 #include <vector>
 
 #include "game.h"
@@ -315,4 +316,155 @@ TEST_F(BombTest, TestPlaceTwoBombsVertical) {
   EXPECT_EQ(0, state.level().bombs_size());
 }
 
+class EventTest : public GameTest {
+public:
+  // Steps with the action until an event of the type, returning it.
+  bool StepUntil(bman::GameEvent::Type type,
+                 const std::vector<bman::MovePlayerRequest>& move,
+                 bman::GameEvent* event, int max_ticks = 1000) {
+    for (int t = 0; t < max_ticks; ++t) {
+      game_.Step(move);
+      for (const auto& e : game_.game_state().events()) {
+        if (e.type() == type) {
+          *event = e;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+};
+
+TEST_F(EventTest, TestBombAndBrickEvents) {
+  auto* brick = game_.game_state().mutable_level()->add_bricks();
+  brick->set_x(1);
+  brick->set_y(0);
+  brick->set_solid(true);
+  brick->set_powerup(bman::PUP_FLAME);
+
+  std::vector<bman::MovePlayerRequest> move(1);
+  move[0].add_actions()->set_place_bomb(true);
+  game_.Step(move);
+  ASSERT_EQ(1, game_.game_state().events_size());
+  const auto& placed = game_.game_state().events(0);
+  EXPECT_EQ(bman::GameEvent::EVENT_BOMB_PLACED, placed.type());
+  EXPECT_EQ(0, placed.x());
+  EXPECT_EQ(0, placed.y());
+  EXPECT_EQ(0, placed.player_id());
+
+  // Events only last a step.
+  move[0].mutable_actions(0)->set_place_bomb(false);
+  game_.Step(move);
+  EXPECT_EQ(0, game_.game_state().events_size());
+
+  bman::GameEvent event;
+  ASSERT_TRUE(StepUntil(bman::GameEvent::EVENT_BOMB_EXPLODED, move, &event));
+  std::vector<bman::GameEvent::Type> types;
+  for (const auto& e : game_.game_state().events()) {
+    types.push_back(e.type());
+  }
+  EXPECT_EQ(std::vector<bman::GameEvent::Type>(
+                {bman::GameEvent::EVENT_BOMB_EXPLODED,
+                 bman::GameEvent::EVENT_BRICK_DESTROYED,
+                 bman::GameEvent::EVENT_POWERUP_REVEALED}),
+            types);
+  EXPECT_EQ(1, game_.game_state().events(2).x());
+  EXPECT_EQ(bman::PUP_FLAME, game_.game_state().events(2).powerup());
+
+  // The player stayed on the bomb.
+  ASSERT_TRUE(StepUntil(bman::GameEvent::EVENT_PLAYER_DIED, move, &event, 2));
+  EXPECT_EQ(0, event.player_id());
+  EXPECT_EQ(0, event.bomb_player_id());
+  ASSERT_TRUE(
+      StepUntil(bman::GameEvent::EVENT_PLAYER_RESPAWNED, move, &event));
+  EXPECT_EQ(0, event.player_id());
+}
+
+TEST_F(EventTest, TestPowerupTakenEvent) {
+  auto* brick = game_.game_state().mutable_level()->add_bricks();
+  brick->set_x(1);
+  brick->set_y(0);
+  brick->set_powerup(bman::PUP_EXTRA_BOMB);
+
+  std::vector<bman::MovePlayerRequest> move(1);
+  move[0].add_actions()->set_dx(32);
+  game_.Step(move);
+  ASSERT_EQ(1, game_.game_state().events_size());
+  const auto& event = game_.game_state().events(0);
+  EXPECT_EQ(bman::GameEvent::EVENT_POWERUP_TAKEN, event.type());
+  EXPECT_EQ(1, event.x());
+  EXPECT_EQ(0, event.player_id());
+  EXPECT_EQ(bman::PUP_EXTRA_BOMB, event.powerup());
+}
+
+class StepFramesTest : public testing::Test {
+public:
+  void SetUp() {
+    game_.BuildSimpleLevel(2);
+    game_.AddPlayer();
+    game_.AddPlayer();
+  }
+
+  // Moves in a random direction, placing a bomb or using a power-up now and
+  // then.
+  bman::MovePlayerRequest RandomMove(std::mt19937* rng) {
+    static const int kDeltas[4][2] = {{4, 0}, {0, 4}, {-4, 0}, {0, -4}};
+    const int dir = (*rng)() % 4;
+    bman::MovePlayerRequest move;
+    auto* action = move.add_actions();
+    action->set_dir(static_cast<bman::Direction>(dir));
+    action->set_dx(kDeltas[dir][0]);
+    action->set_dy(kDeltas[dir][1]);
+    action->set_place_bomb((*rng)() % 4 == 0);
+    action->set_use_powerup((*rng)() % 8 == 0);
+    return move;
+  }
+
+  Game game_;
+};
+
+TEST_F(StepFramesTest, TestSameAsSteps) {
+  Game stepped = game_;
+  std::mt19937 rng(1);
+  int num_bricks_destroyed = 0;
+  for (int step = 0; step < 500; ++step) {
+    std::vector<bman::MovePlayerRequest> moves = {RandomMove(&rng),
+                                                  RandomMove(&rng)};
+    EXPECT_EQ(8, game_.StepFrames(moves, 8));
+    for (int i = 0; i < 8; ++i) {
+      ASSERT_TRUE(stepped.Step(moves));
+      for (const auto& event : stepped.game_state().events()) {
+        num_bricks_destroyed +=
+            event.type() == bman::GameEvent::EVENT_BRICK_DESTROYED;
+      }
+      for (auto& move : moves) {
+        move.mutable_actions(0)->set_place_bomb(false);
+      }
+    }
+    ASSERT_EQ(stepped.game_state().SerializeAsString(),
+              game_.game_state().SerializeAsString())
+        << "step " << step;
+  }
+  EXPECT_GT(num_bricks_destroyed, 0);
+}
+
+TEST_F(StepFramesTest, TestStopsWhenPlayerDies) {
+  // Player 0 sits on its bomb.
+  std::vector<bman::MovePlayerRequest> moves(2);
+  moves[0].add_actions()->set_place_bomb(true);
+  moves[1].add_actions();
+  Game stepped = game_;
+  const int num_frames = game_.StepFrames(moves, 1000, 0);
+  EXPECT_LT(num_frames, 1000);
+  EXPECT_LE(game_.game_state().players(0).health(), 0);
+  EXPECT_GT(game_.game_state().players(1).health(), 0);
+
+  for (int i = 0; i < num_frames; ++i) {
+    stepped.Step(moves);
+    moves[0].mutable_actions(0)->set_place_bomb(false);
+  }
+  EXPECT_EQ(stepped.game_state().SerializeAsString(),
+            game_.game_state().SerializeAsString());
+}
+
 int main() { return RUN_ALL_TESTS(); }
@@ -0,0 +1,40 @@
+// Generates a pool of random levels (see LevelPool) for GridEnv and
+// bman_env.BManVecEnv to reset to:
+//
+//   ./bazel-bin/generate_levels --output=/tmp/levels.pool --num_levels=1000000
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <cstdio>
+
+#include "level_generator.h"
+#include "timer.h"
+
+DEFINE_string(output, "levels.pool", "File to write the levels to");
+DEFINE_int64(num_levels, 1000000, "Number of levels");
+DEFINE_int64(seed, 1, "Seed of the first level (level i uses seed + i)");
+DEFINE_int32(width, kDefaultWidth, "Width of the levels (odd)");
+DEFINE_int32(height, kDefaultHeight, "Height of the levels (odd)");
+DEFINE_int32(num_players, 4, "Spawn points of each level");
+DEFINE_bool(random_spawns, false,
+            "Spawn anywhere, rather than in the corners");
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  bman::LevelGenerator::Options options;
+  options.width = FLAGS_width;
+  options.height = FLAGS_height;
+  options.num_players = FLAGS_num_players;
+  options.random_spawns = FLAGS_random_spawns;
+  bman::LevelGenerator generator(options);
+  bman::Timer timer;
+  if (!bman::LevelPool::Write(FLAGS_output, generator, FLAGS_num_levels,
+                              FLAGS_seed)) {
+    return 1;
+  }
+  printf("%ld levels in %.1fs\n", (long)FLAGS_num_levels,
+         timer.ElapsedMillis() / 1000);
+  return 0;
+}
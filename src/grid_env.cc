@@ -0,0 +1,471 @@
+#include "grid_env.h"
+
+#include <algorithm>
+
+#include "agent.h"
+#include "glog/logging.h"
+
+namespace bman {
+
+namespace {
+
+Game SimpleGame(int num_players) {
+  Game game;
+  game.BuildSimpleLevel(2);
+  for (int i = 0; i < num_players; ++i) {
+    game.AddPlayer();
+  }
+  return game;
+}
+
+// The simple level, or the first of the pool (any would do until Reset
+// picks one, they're all the same size).
+Game FirstGame(const GridEnv::Options& options, int num_players) {
+  if (!options.levels) {
+    return SimpleGame(num_players);
+  }
+  bman::GameConfig config;
+  options.levels->Get(0, &config);
+  Game game;
+  game.BuildLevel(config);
+  for (int i = 0; i < num_players; ++i) {
+    game.AddPlayer();
+  }
+  return game;
+}
+
+// Starts a random level of the pool with num_players players.
+void StartRandomLevel(const LevelPool& levels, int num_players,
+                      std::mt19937* rng, bman::GameConfig* config,
+                      Game* game) {
+  levels.Get((*rng)() % levels.size(), config);
+  game->BuildLevel(*config);
+  for (int i = 0; i < num_players; ++i) {
+    game->AddPlayer();
+  }
+}
+
+// Runs fn(i) for i in [0, n): on the pool if there is one, in which case
+// it may still be running when this returns (until the pool's Wait).
+template <typename Fn> void ScheduleFor(ThreadPool* pool, int n, Fn fn) {
+  if (!pool) {
+    for (int i = 0; i < n; ++i) {
+      fn(i);
+    }
+    return;
+  }
+  // One contiguous range per thread, always on the same thread (and CPU,
+  // with pinned threads).
+  const int num_tasks = pool->num_threads();
+  for (int t = 0; t < num_tasks; ++t) {
+    const int begin = n * t / num_tasks;
+    const int end = n * (t + 1) / num_tasks;
+    pool->ScheduleOn(t, [fn, begin, end] {
+      for (int i = begin; i < end; ++i) {
+        fn(i);
+      }
+    });
+  }
+}
+
+// Runs fn(i) for i in [0, n) and waits for it.
+template <typename Fn> void ParallelFor(ThreadPool* pool, int n, Fn fn) {
+  ScheduleFor(pool, n, std::move(fn));
+  if (pool) {
+    pool->Wait();
+  }
+}
+
+// Of a player that has moved from (x_before, y_before) while alive.
+float MoveReward(int x_before, int y_before,
+                 const bman::PlayerState& player) {
+  const float dx = x_before - player.x();
+  const float dy = y_before - player.y();
+  return (dx * dx + dy * dy) / 1000.0f;
+}
+
+} // namespace
+
+GridEnv::GridEnv(const Options& options)
+    : game_(FirstGame(options, 1)), initial_state_(game_.game_state()),
+      options_(options), rng_(options.seed), observation_(game_.config()),
+      tensor_observation_(game_.config(), options.tensor) {
+  CHECK(options_.tensor_observation || options_.frame_stack == 1)
+      << "Only tensor observations are stacked";
+  if (options_.tensor_observation) {
+    frames_.reset(
+        new FrameStack(tensor_observation_.size(), options_.frame_stack));
+    PushFrame();
+  }
+}
+
+void GridEnv::Reset() {
+  if (options_.levels) {
+    StartRandomLevel(*options_.levels, 1, &rng_, &level_config_, &game_);
+  } else {
+    game_.set_game_state(initial_state_);
+  }
+  if (frames_) {
+    frames_->Clear();
+    PushFrame();
+  }
+  if (recorder_) {
+    recorder_->BeginEpisode(game_.game_state());
+  }
+}
+
+bool GridEnv::StartRecording(const std::string& path,
+                             bool record_observations) {
+  TrajectoryWriter::Options options;
+  if (record_observations) {
+    options.observation_shape = observation_shape();
+    recorded_observation_.resize(observation_size());
+  }
+  recorder_.reset(new TrajectoryWriter(game_.config(), options));
+  if (!recorder_->Open(path)) {
+    recorder_.reset();
+    return false;
+  }
+  recorder_->BeginEpisode(game_.game_state());
+  return true;
+}
+
+void GridEnv::StopRecording() { recorder_.reset(); }
+
+void GridEnv::PushFrame() {
+  tensor_observation_.Build(game_.game_state(), 0, frames_->Push());
+}
+
+int GridEnv::observation_size() const {
+  return frames_ ? frames_->size() : observation_.size();
+}
+
+std::vector<int> GridEnv::observation_shape() const {
+  if (!frames_) {
+    return {observation_.height(), observation_.width()};
+  }
+  return {tensor_observation_.num_channels() * options_.frame_stack,
+          tensor_observation_.height(), tensor_observation_.width()};
+}
+
+int GridEnv::score() const {
+  return game_.game_state().score_size() ? game_.game_state().score(0) : 0;
+}
+
+bman::MovePlayerRequest GridEnv::ActionMove(int action) {
+  bman::MovePlayerRequest move;
+  auto* player_action = move.add_actions();
+  if (action >= 0 && action < 4) {
+    int dx = 0, dy = 0;
+    Agent::GetDeltaFromDir(action, &dx, &dy);
+    player_action->set_dir(static_cast<bman::Direction>(action));
+    player_action->set_dx(dx);
+    player_action->set_dy(dy);
+  } else if (action == 4) {
+    player_action->set_place_bomb(true);
+  } else if (action == 5) {
+    player_action->set_use_powerup(true);
+  }
+  return move;
+}
+
+float GridEnv::Step(int action, bool* done) {
+  const int score_before = score();
+  const int x_before = game_.game_state().players(0).x();
+  const int y_before = game_.game_state().players(0).y();
+
+  const std::vector<bman::MovePlayerRequest> moves = {ActionMove(action)};
+  if (recorder_ && recorder_->observation_size()) {
+    Observe(recorded_observation_.data());
+  }
+  const int num_frames = game_.StepFrames(moves, options_.frame_skip, 0);
+  if (frames_) {
+    PushFrame();
+  }
+
+  const auto& player = game_.game_state().players(0);
+  float reward = score() - score_before;
+  *done = player.health() <= 0;
+  if (!*done) {
+    reward += MoveReward(x_before, y_before, player);
+  }
+  if (recorder_) {
+    recorder_->Record(moves, num_frames, action, reward,
+                      recorded_observation_.data(), *done,
+                      game_.game_state());
+  }
+  return reward;
+}
+
+void GridEnv::Observe(float* data) const {
+  if (frames_) {
+    frames_->Copy(data);
+  } else {
+    observation_.Build(game_.game_state(), 0, data);
+  }
+}
+
+VecGridEnv::VecGridEnv(int num_envs, int num_threads,
+                       const GridEnv::Options& options, bool pin_threads) {
+  for (int i = 0; i < num_envs; ++i) {
+    GridEnv::Options env_options = options;
+    env_options.seed = options.seed + i;
+    envs_.emplace_back(new GridEnv(env_options));
+  }
+  if (num_threads > 1) {
+    pool_.reset(
+        new ThreadPool(std::min(num_threads, num_envs), pin_threads));
+  }
+}
+
+void VecGridEnv::Reset(float* observations) {
+  CHECK(!stepping_) << "Reset called before StepWait";
+  const int size = observation_size();
+  ParallelFor(pool_.get(), num_envs(), [&](int i) {
+    envs_[i]->Reset();
+    envs_[i]->Observe(observations + i * size);
+  });
+}
+
+void VecGridEnv::Step(const int32_t* actions, float* observations,
+                      float* rewards, uint8_t* dones,
+                      float* terminal_observations) {
+  StepAsync(actions, observations, rewards, dones, terminal_observations);
+  StepWait();
+}
+
+void VecGridEnv::StepAsync(const int32_t* actions, float* observations,
+                           float* rewards, uint8_t* dones,
+                           float* terminal_observations) {
+  CHECK(!stepping_) << "StepAsync called before StepWait";
+  stepping_ = true;
+  const int size = observation_size();
+  ScheduleFor(pool_.get(), num_envs(), [=](int i) {
+    bool done = false;
+    rewards[i] = envs_[i]->Step(actions[i], &done);
+    dones[i] = done;
+    if (done) {
+      envs_[i]->Observe(terminal_observations + i * size);
+      envs_[i]->Reset();
+    }
+    envs_[i]->Observe(observations + i * size);
+  });
+}
+
+void VecGridEnv::StepWait() {
+  CHECK(stepping_) << "StepWait called without StepAsync";
+  if (pool_) {
+    pool_->Wait();
+  }
+  stepping_ = false;
+}
+
+bool VecGridEnv::StartRecording(const std::string& prefix,
+                                bool record_observations) {
+  CHECK(!stepping_) << "StartRecording called before StepWait";
+  for (int i = 0; i < num_envs(); ++i) {
+    if (!envs_[i]->StartRecording(prefix + "-" + std::to_string(i) + ".traj",
+                                  record_observations)) {
+      StopRecording();
+      return false;
+    }
+  }
+  return true;
+}
+
+void VecGridEnv::StopRecording() {
+  CHECK(!stepping_) << "StopRecording called before StepWait";
+  for (auto& env : envs_) {
+    env->StopRecording();
+  }
+}
+
+MultiGridEnv::MultiGridEnv(const Options& options)
+    : game_(FirstGame(options.observation, options.num_players)),
+      initial_state_(game_.game_state()), options_(options),
+      rng_(options.observation.seed), observation_(game_.config()),
+      tensor_observation_(game_.config(), options.observation.tensor),
+      opponents_(game_.config()) {
+  CHECK_LE(options_.num_players,
+           game_.config().player_config().max_players());
+  CHECK_LE(options_.num_agents, options_.num_players);
+  CHECK(options_.observation.tensor_observation ||
+        options_.observation.frame_stack == 1)
+      << "Only tensor observations are stacked";
+  for (int i = options_.num_agents; i < options_.num_players; ++i) {
+    opponent_indices_.push_back(i);
+  }
+  if (options_.observation.tensor_observation) {
+    for (int i = 0; i < options_.num_agents; ++i) {
+      frames_.emplace_back(tensor_observation_.size(),
+                           options_.observation.frame_stack);
+    }
+    PushFrames();
+  }
+}
+
+void MultiGridEnv::Reset() {
+  if (options_.observation.levels) {
+    StartRandomLevel(*options_.observation.levels, options_.num_players,
+                     &rng_, &level_config_, &game_);
+  } else {
+    game_.set_game_state(initial_state_);
+  }
+  opponents_.ResetGame(0);
+  num_steps_ = 0;
+  for (auto& frames : frames_) {
+    frames.Clear();
+  }
+  PushFrames();
+}
+
+void MultiGridEnv::ResetAgentFrames(int agent) {
+  if (!frames_.empty()) {
+    frames_[agent].Clear();
+    tensor_observation_.Build(game_.game_state(), agent,
+                              frames_[agent].Push());
+  }
+}
+
+void MultiGridEnv::PushFrames() {
+  for (int i = 0; i < (int)frames_.size(); ++i) {
+    tensor_observation_.Build(game_.game_state(), i, frames_[i].Push());
+  }
+}
+
+int MultiGridEnv::observation_size() const {
+  return frames_.empty() ? observation_.size() : frames_[0].size();
+}
+
+std::vector<int> MultiGridEnv::observation_shape() const {
+  if (frames_.empty()) {
+    return {observation_.height(), observation_.width()};
+  }
+  return {tensor_observation_.num_channels() *
+              options_.observation.frame_stack,
+          tensor_observation_.height(), tensor_observation_.width()};
+}
+
+bool MultiGridEnv::Step(const int32_t* actions, float* rewards,
+                        uint8_t* dones) {
+  const int num_agents = options_.num_agents;
+  std::vector<bman::PlayerState> before(num_agents);
+  std::vector<int> scores_before(num_agents);
+  std::vector<bman::MovePlayerRequest> moves(options_.num_players);
+  for (int i = 0; i < num_agents; ++i) {
+    before[i] = game_.game_state().players(i);
+    scores_before[i] = score(i);
+    moves[i] = GridEnv::ActionMove(actions[i]);
+  }
+
+  const int frame_skip = options_.observation.frame_skip;
+  if (opponent_indices_.empty()) {
+    game_.StepFrames(std::move(moves), frame_skip);
+  } else {
+    // The opponents decide every tick.
+    for (int tick = 0; tick < frame_skip; ++tick) {
+      auto opponent_moves = opponents_.GetPlayerActionsInGame(
+          game_.game_state(), opponent_indices_);
+      for (size_t j = 0; j < opponent_indices_.size(); ++j) {
+        moves[opponent_indices_[j]] = std::move(opponent_moves[j]);
+      }
+      game_.Step(moves);
+      for (int i = 0; i < num_agents; ++i) {
+        moves[i].mutable_actions(0)->set_place_bomb(false);
+      }
+    }
+  }
+  PushFrames();
+
+  const bool game_over = ++num_steps_ >= options_.max_steps;
+  for (int i = 0; i < num_agents; ++i) {
+    const auto& player = game_.game_state().players(i);
+    const bool was_alive = before[i].health() > 0;
+    const bool alive = player.health() > 0;
+    rewards[i] = score(i) - scores_before[i];
+    // Not for respawning, which moves the player back to its corner.
+    if (was_alive && alive) {
+      rewards[i] += MoveReward(before[i].x(), before[i].y(), player);
+    }
+    dones[i] = game_over || (was_alive && !alive);
+  }
+  return game_over;
+}
+
+void MultiGridEnv::Observe(int agent, float* data) const {
+  if (!frames_.empty()) {
+    frames_[agent].Copy(data);
+  } else {
+    observation_.Build(game_.game_state(), agent, data);
+  }
+}
+
+VecMultiGridEnv::VecMultiGridEnv(int num_games, int num_threads,
+                                 const MultiGridEnv::Options& options,
+                                 bool pin_threads) {
+  for (int i = 0; i < num_games; ++i) {
+    MultiGridEnv::Options game_options = options;
+    game_options.observation.seed = options.observation.seed + i;
+    games_.emplace_back(new MultiGridEnv(game_options));
+  }
+  if (num_threads > 1) {
+    pool_.reset(
+        new ThreadPool(std::min(num_threads, num_games), pin_threads));
+  }
+}
+
+void VecMultiGridEnv::Reset(float* observations) {
+  CHECK(!stepping_) << "Reset called before StepWait";
+  const int num_agents = this->num_agents();
+  const int size = observation_size();
+  ParallelFor(pool_.get(), num_games(), [&](int g) {
+    games_[g]->Reset();
+    for (int i = 0; i < num_agents; ++i) {
+      games_[g]->Observe(i, observations + (g * num_agents + i) * size);
+    }
+  });
+}
+
+void VecMultiGridEnv::Step(const int32_t* actions, float* observations,
+                           float* rewards, uint8_t* dones,
+                           float* terminal_observations) {
+  StepAsync(actions, observations, rewards, dones, terminal_observations);
+  StepWait();
+}
+
+void VecMultiGridEnv::StepAsync(const int32_t* actions, float* observations,
+                                float* rewards, uint8_t* dones,
+                                float* terminal_observations) {
+  CHECK(!stepping_) << "StepAsync called before StepWait";
+  stepping_ = true;
+  const int num_agents = this->num_agents();
+  const int size = observation_size();
+  ScheduleFor(pool_.get(), num_games(), [=](int g) {
+    const int first = g * num_agents;
+    MultiGridEnv& game = *games_[g];
+    const bool game_over =
+        game.Step(actions + first, rewards + first, dones + first);
+    for (int i = 0; i < num_agents; ++i) {
+      if (dones[first + i]) {
+        game.Observe(i, terminal_observations + (first + i) * size);
+        game.ResetAgentFrames(i);
+      }
+    }
+    if (game_over) {
+      game.Reset();
+    }
+    for (int i = 0; i < num_agents; ++i) {
+      game.Observe(i, observations + (first + i) * size);
+    }
+  });
+}
+
+void VecMultiGridEnv::StepWait() {
+  CHECK(stepping_) << "StepWait called without StepAsync";
+  if (pool_) {
+    pool_->Wait();
+  }
+  stepping_ = false;
+}
+
+} // namespace bman
@@ -0,0 +1,235 @@
+#ifndef BMAN_GRID_ENV_H
+#define BMAN_GRID_ENV_H
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "agent_batch.h"
+#include "game.h"
+#include "level.grpc.pb.h"
+#include "level_generator.h"
+#include "observation.h"
+#include "thread_pool.h"
+#include "trajectory.h"
+
+namespace bman {
+
+// The single-agent environment of python/bman_env.py: the agent plays
+// player 0 of the simple level (or of a random level of a pool on each
+// reset), each step holds its action for frame_skip ticks (placing a bomb
+// only on the first, see Game::StepFrames), and the reward is the change in
+// score plus, while the player is alive, the squared distance moved over
+// 1000. The episode ends when the player dies, which also ends the step.
+// Actions are the directions, then place bomb, then use power-up.
+class GridEnv {
+public:
+  static constexpr int kFrameSkip = 8;
+
+  struct Options {
+    // Observe TensorObservations (with these options), stacking the last
+    // frame_stack of them, instead of the GridObservation that bman_env's
+    // policies were trained on (which VecFrameStack stacks).
+    bool tensor_observation = false;
+    TensorObservation::Options tensor;
+    int frame_stack = 1;
+    int frame_skip = kFrameSkip;
+    // If set, each reset starts a level of the pool picked with an rng
+    // seeded with seed.
+    std::shared_ptr<const LevelPool> levels;
+    uint32_t seed = 0;
+  };
+
+  GridEnv() : GridEnv(Options()) {}
+  explicit GridEnv(const Options& options);
+
+  void Reset();
+  // Returns the reward, sets done if the episode has ended.
+  float Step(int action, bool* done);
+  // Fills observation_size() values.
+  void Observe(float* data) const;
+
+  int observation_size() const;
+  // Height x width for grid observations, channels (of every stacked frame)
+  // x height x width for tensor ones.
+  std::vector<int> observation_shape() const;
+  const Game& game() const { return game_; }
+  int score() const;
+
+  // The move for the first tick of the action.
+  static bman::MovePlayerRequest ActionMove(int action);
+
+  // Records the steps to a trajectory file (see trajectory.h), from the
+  // current state, with the observations if record_observations. Returns
+  // false if the file can't be created.
+  bool StartRecording(const std::string& path, bool record_observations);
+  // Closes the file.
+  void StopRecording();
+
+private:
+  // Builds the tensor observation of the current state as the newest frame.
+  void PushFrame();
+
+  Game game_;
+  bman::GameState initial_state_;
+  const Options options_;
+  std::mt19937 rng_;
+  bman::GameConfig level_config_;
+  GridObservation observation_;
+  TensorObservation tensor_observation_;
+  // Of tensor observations.
+  std::unique_ptr<FrameStack> frames_;
+  std::unique_ptr<TrajectoryWriter> recorder_;
+  // The observation being recorded with a step.
+  std::vector<float> recorded_observation_;
+};
+
+// Steps num_envs GridEnvs in one call (spread over num_threads) and resets
+// those whose episode has ended, as stable-baselines' VecEnv does. Arrays
+// hold one row per env. Env i picks levels with seed options.seed + i.
+class VecGridEnv {
+public:
+  // With pin_threads, each thread runs on its own CPU (see ThreadPool).
+  VecGridEnv(int num_envs, int num_threads = 1,
+             const GridEnv::Options& options = GridEnv::Options(),
+             bool pin_threads = false);
+
+  int num_envs() const { return envs_.size(); }
+  const GridEnv& env(int index) const { return *envs_[index]; }
+  const Game& game(int index) const { return envs_[index]->game(); }
+  int score(int index) const { return envs_[index]->score(); }
+  // Of each env.
+  int observation_size() const { return envs_[0]->observation_size(); }
+  std::vector<int> observation_shape() const {
+    return envs_[0]->observation_shape();
+  }
+
+  // Resets every env and fills their observations.
+  void Reset(float* observations);
+  // Takes actions[i] in env i and fills the rewards and dones, and the
+  // observations after the step (of the new episode for envs that are done,
+  // the last of the old one going into that env's row of
+  // terminal_observations, whose other rows aren't written).
+  void Step(const int32_t* actions, float* observations, float* rewards,
+            uint8_t* dones, float* terminal_observations);
+  // Step in two halves, as VecEnv's step_async and step_wait: StepAsync
+  // starts stepping on the threads and returns, and StepWait waits for it
+  // to finish. The arrays mustn't be touched in between. (Without threads,
+  // StepAsync does all the work.)
+  void StepAsync(const int32_t* actions, float* observations, float* rewards,
+                 uint8_t* dones, float* terminal_observations);
+  void StepWait();
+
+  // Records env i to <prefix>-<i>.traj, as GridEnv::StartRecording.
+  bool StartRecording(const std::string& prefix, bool record_observations);
+  void StopRecording();
+
+private:
+  std::vector<std::unique_ptr<GridEnv>> envs_;
+  std::unique_ptr<ThreadPool> pool_;
+  bool stepping_ = false;
+};
+
+// Self-play on the simple level (or the levels of options.observation's
+// pool): num_players players, the first num_agents of which take the
+// actions passed to Step (with GridEnv's actions, frame skip and rewards,
+// though a step doesn't end when an agent dies) while the others are
+// SimpleAgents stepped in C++.
+// Players respawn, so an agent's episode ends when it dies and the next
+// starts as it respawns in the same game. The game restarts after
+// max_steps steps, which ends every agent's episode.
+class MultiGridEnv {
+public:
+  struct Options {
+    int num_players = 4;
+    int num_agents = 4;
+    int max_steps = 1000;
+    // What each agent observes, as seen by its player, the frame skip and
+    // the levels.
+    GridEnv::Options observation;
+  };
+
+  MultiGridEnv() : MultiGridEnv(Options()) {}
+  explicit MultiGridEnv(const Options& options);
+
+  void Reset();
+  // Takes actions[i] for agent i and fills num_agents() rewards and dones.
+  // Returns true once the game has run max_steps (every agent is done and
+  // the game should be Reset).
+  bool Step(const int32_t* actions, float* rewards, uint8_t* dones);
+  // Fills observation_size() values, as seen by the agent.
+  void Observe(int agent, float* data) const;
+  // Starts the agent's stacked frames over from the current one, for the
+  // episode after its done step.
+  void ResetAgentFrames(int agent);
+
+  int num_agents() const { return options_.num_agents; }
+  int observation_size() const;
+  std::vector<int> observation_shape() const;
+  const Game& game() const { return game_; }
+  int score(int agent) const { return game_.game_state().score(agent); }
+
+private:
+  void PushFrames();
+
+  Game game_;
+  bman::GameState initial_state_;
+  const Options options_;
+  std::mt19937 rng_;
+  bman::GameConfig level_config_;
+  GridObservation observation_;
+  TensorObservation tensor_observation_;
+  // Of tensor observations, one per agent.
+  std::vector<FrameStack> frames_;
+  SimpleAgentBatch opponents_;
+  std::vector<int> opponent_indices_;
+  int num_steps_ = 0;
+};
+
+// Steps num_games MultiGridEnvs in one call (spread over num_threads). Each
+// agent is an env of the VecEnv, so arrays hold a row per agent: game 0's
+// agents, then game 1's, and so on. Game i picks levels as VecGridEnv's
+// env i. Rows are done as their agent's episode
+// ends, and games are restarted as VecGridEnv resets its envs.
+class VecMultiGridEnv {
+public:
+  VecMultiGridEnv(
+      int num_games, int num_threads = 1,
+      const MultiGridEnv::Options& options = MultiGridEnv::Options(),
+      bool pin_threads = false);
+
+  int num_games() const { return games_.size(); }
+  int num_agents() const { return games_[0]->num_agents(); }
+  int num_envs() const { return num_games() * num_agents(); }
+  const MultiGridEnv& env(int game) const { return *games_[game]; }
+  // Of the row's agent.
+  const Game& game(int row) const {
+    return games_[row / num_agents()]->game();
+  }
+  int score(int row) const {
+    return games_[row / num_agents()]->score(row % num_agents());
+  }
+  int observation_size() const { return games_[0]->observation_size(); }
+  std::vector<int> observation_shape() const {
+    return games_[0]->observation_shape();
+  }
+
+  // As VecGridEnv's, with a row per agent.
+  void Reset(float* observations);
+  void Step(const int32_t* actions, float* observations, float* rewards,
+            uint8_t* dones, float* terminal_observations);
+  void StepAsync(const int32_t* actions, float* observations, float* rewards,
+                 uint8_t* dones, float* terminal_observations);
+  void StepWait();
+
+private:
+  std::vector<std::unique_ptr<MultiGridEnv>> games_;
+  std::unique_ptr<ThreadPool> pool_;
+  bool stepping_ = false;
+};
+
+} // namespace bman
+
+#endif
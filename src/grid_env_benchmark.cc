@@ -0,0 +1,84 @@
+// Measures how VecGridEnv's stepping scales with threads: steps num_envs
+// envs with random actions on 1, 2, 4, ... up to --max_threads threads and
+// reports the env steps per second of each:
+//
+//   ./bazel-bin/grid_env_benchmark --num_envs=256 --max_threads=32
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "grid_env.h"
+#include "timer.h"
+
+DEFINE_int32(num_envs, 256, "Envs stepped together");
+DEFINE_int32(num_steps, 1000, "Steps of every env per thread count");
+DEFINE_int32(max_threads, 0, "Most threads to try (0 for the CPU count)");
+DEFINE_bool(pin_threads, true, "Pin each thread to its own CPU");
+DEFINE_bool(tensor_observation, false, "Observe TensorObservations");
+DEFINE_string(level_pool, "",
+              "If set, reset to random levels of this pool (see "
+              "generate_levels)");
+
+namespace {
+
+// Returns the env steps per second on num_threads threads.
+double Run(int num_threads) {
+  bman::GridEnv::Options options;
+  options.tensor_observation = FLAGS_tensor_observation;
+  if (!FLAGS_level_pool.empty()) {
+    auto levels = std::make_shared<bman::LevelPool>();
+    CHECK(levels->Open(FLAGS_level_pool));
+    options.levels = levels;
+  }
+  bman::VecGridEnv env(FLAGS_num_envs, num_threads, options,
+                       FLAGS_pin_threads);
+  const int size = env.observation_size();
+  std::vector<float> observations(FLAGS_num_envs * size);
+  std::vector<float> terminal_observations(FLAGS_num_envs * size);
+  std::vector<float> rewards(FLAGS_num_envs);
+  std::vector<uint8_t> dones(FLAGS_num_envs);
+  std::vector<int32_t> actions(FLAGS_num_envs);
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> random_action(0, 4);
+  env.Reset(observations.data());
+
+  bman::Timer timer;
+  for (int step = 0; step < FLAGS_num_steps; ++step) {
+    for (auto& action : actions) {
+      action = random_action(rng);
+    }
+    env.Step(actions.data(), observations.data(), rewards.data(),
+             dones.data(), terminal_observations.data());
+  }
+  return double(FLAGS_num_envs) * FLAGS_num_steps /
+         (timer.ElapsedMillis() / 1000);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  const int max_threads = FLAGS_max_threads > 0
+                              ? FLAGS_max_threads
+                              : sysconf(_SC_NPROCESSORS_ONLN);
+  double one_thread_rate = 0;
+  for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+    const double rate = Run(num_threads);
+    if (num_threads == 1) {
+      one_thread_rate = rate;
+    }
+    printf("%3d threads %10.0f env steps/s, %5.2fx\n", num_threads, rate,
+           rate / one_thread_rate);
+    if (num_threads < max_threads && num_threads * 2 > max_threads) {
+      num_threads = max_threads / 2;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,276 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+
+#include "grid_env.h"
+
+namespace {
+
+// Random actions, bombs included, so that players die now and then.
+std::vector<int32_t> RandomActions(int num_envs, std::mt19937* rng) {
+  std::uniform_int_distribution<int> random_action(0, 4);
+  std::vector<int32_t> actions(num_envs);
+  for (auto& action : actions) {
+    action = random_action(*rng);
+  }
+  return actions;
+}
+
+} // namespace
+
+TEST(GridEnvTest, TestRewardForMoving) {
+  bman::GridEnv env;
+  env.Reset();
+  bool done = true;
+  // Moving right from the corner, 4 subpixels a tick.
+  EXPECT_FLOAT_EQ(32 * 32 / 1000.0f, env.Step(1, &done));
+  EXPECT_FALSE(done);
+  // And back again.
+  EXPECT_FLOAT_EQ(32 * 32 / 1000.0f, env.Step(0, &done));
+  EXPECT_EQ(0, env.score());
+}
+
+TEST(GridEnvTest, TestStacksTensorFrames) {
+  bman::GridEnv::Options options;
+  options.tensor_observation = true;
+  options.frame_stack = 3;
+  bman::GridEnv env(options);
+  bman::TensorObservation tensor(env.game().config());
+  const int frame_size = tensor.size();
+  ASSERT_EQ(3 * frame_size, env.observation_size());
+  EXPECT_EQ(std::vector<int>({3 * tensor.num_channels(), tensor.height(),
+                              tensor.width()}),
+            env.observation_shape());
+
+  // After a reset only the newest frame is filled.
+  env.Reset();
+  std::vector<float> observation(env.observation_size());
+  std::vector<float> frames[3];
+  for (auto& frame : frames) {
+    frame.resize(frame_size);
+  }
+  tensor.Build(env.game().game_state(), 0, frames[0].data());
+  env.Observe(observation.data());
+  EXPECT_TRUE(std::all_of(observation.begin(),
+                          observation.begin() + 2 * frame_size,
+                          [](float value) { return value == 0; }));
+  EXPECT_TRUE(std::equal(frames[0].begin(), frames[0].end(),
+                         &observation[2 * frame_size]));
+
+  // Each step shifts the older frames towards the front.
+  bool done = false;
+  for (int step = 1; step <= 4; ++step) {
+    env.Step(1 + step % 2, &done);
+    ASSERT_FALSE(done);
+    tensor.Build(env.game().game_state(), 0, frames[step % 3].data());
+    env.Observe(observation.data());
+    for (int age = 0; age < 3 && age <= step; ++age) {
+      const auto& frame = frames[(step - age) % 3];
+      EXPECT_TRUE(std::equal(frame.begin(), frame.end(),
+                             &observation[(2 - age) * frame_size]))
+          << "step " << step << " age " << age;
+    }
+  }
+}
+
+TEST(MultiGridEnvTest, TestRestartsFramesOfDoneAgents) {
+  bman::MultiGridEnv::Options options;
+  options.observation.tensor_observation = true;
+  options.observation.frame_stack = 3;
+  bman::VecMultiGridEnv vec_env(1, 1, options);
+  bman::TensorObservation tensor(vec_env.game(0).config());
+  const int frame_size = tensor.size();
+  const int num_envs = vec_env.num_envs();
+  const int size = vec_env.observation_size();
+  std::vector<float> observations(num_envs * size);
+  std::vector<float> terminal_observations(num_envs * size);
+  std::vector<float> rewards(num_envs);
+  std::vector<uint8_t> dones(num_envs);
+  std::vector<float> frame(frame_size);
+  vec_env.Reset(observations.data());
+
+  // An agent's next episode doesn't see the frames of its previous life.
+  std::mt19937 rng(1);
+  int num_deaths = 0;
+  for (int step = 0; step < 500; ++step) {
+    const auto actions = RandomActions(num_envs, &rng);
+    vec_env.Step(actions.data(), observations.data(), rewards.data(),
+                 dones.data(), terminal_observations.data());
+    for (int i = 0; i < num_envs; ++i) {
+      if (!dones[i]) {
+        continue;
+      }
+      ++num_deaths;
+      const float* observation = &observations[i * size];
+      EXPECT_TRUE(std::all_of(observation, observation + 2 * frame_size,
+                              [](float value) { return value == 0; }))
+          << "step " << step << " agent " << i;
+      tensor.Build(vec_env.game(i).game_state(), i, frame.data());
+      EXPECT_TRUE(std::equal(frame.begin(), frame.end(),
+                             observation + 2 * frame_size));
+      // The terminal observation still holds the earlier frames.
+      const float* terminal = &terminal_observations[i * size];
+      EXPECT_FALSE(std::all_of(terminal, terminal + 2 * frame_size,
+                               [](float value) { return value == 0; }));
+    }
+  }
+  EXPECT_GT(num_deaths, 0);
+}
+
+TEST(GridEnvTest, TestVecEnvMatchesSingleEnvs) {
+  const int num_envs = 3;
+  bman::VecGridEnv vec_env(num_envs);
+  std::vector<bman::GridEnv> envs(num_envs);
+  const int size = vec_env.observation_size();
+  std::vector<float> observations(num_envs * size);
+  std::vector<float> terminal_observations(num_envs * size);
+  std::vector<float> rewards(num_envs);
+  std::vector<uint8_t> dones(num_envs);
+  std::vector<float> expected(size);
+  vec_env.Reset(observations.data());
+
+  std::mt19937 rng(1);
+  int num_done = 0;
+  for (int step = 0; step < 1000; ++step) {
+    const auto actions = RandomActions(num_envs, &rng);
+    vec_env.Step(actions.data(), observations.data(), rewards.data(),
+                 dones.data(), terminal_observations.data());
+    for (int i = 0; i < num_envs; ++i) {
+      bool done = false;
+      EXPECT_FLOAT_EQ(envs[i].Step(actions[i], &done), rewards[i]);
+      ASSERT_EQ(done, dones[i]);
+      if (done) {
+        num_done++;
+        envs[i].Observe(expected.data());
+        EXPECT_TRUE(std::equal(expected.begin(), expected.end(),
+                               &terminal_observations[i * size]));
+        envs[i].Reset();
+      }
+      envs[i].Observe(expected.data());
+      EXPECT_TRUE(
+          std::equal(expected.begin(), expected.end(), &observations[i * size]))
+          << "step " << step << " env " << i;
+    }
+  }
+  EXPECT_GT(num_done, 0);
+}
+
+TEST(GridEnvTest, TestThreadsMatchOneThread) {
+  const int num_envs = 8;
+  const bool pin_threads = true;
+  bman::VecGridEnv serial(num_envs);
+  bman::VecGridEnv threaded(num_envs, 3, bman::GridEnv::Options(),
+                            pin_threads);
+  const int size = serial.observation_size();
+  std::vector<float> observations[2], terminal_observations[2], rewards[2];
+  std::vector<uint8_t> dones[2];
+  for (int k = 0; k < 2; ++k) {
+    observations[k].resize(num_envs * size);
+    terminal_observations[k].resize(num_envs * size);
+    rewards[k].resize(num_envs);
+    dones[k].resize(num_envs);
+  }
+  serial.Reset(observations[0].data());
+  threaded.Reset(observations[1].data());
+  std::mt19937 rng(2);
+  for (int step = 0; step < 300; ++step) {
+    const auto actions = RandomActions(num_envs, &rng);
+    serial.Step(actions.data(), observations[0].data(), rewards[0].data(),
+                dones[0].data(), terminal_observations[0].data());
+    threaded.StepAsync(actions.data(), observations[1].data(),
+                       rewards[1].data(), dones[1].data(),
+                       terminal_observations[1].data());
+    threaded.StepWait();
+    ASSERT_EQ(observations[0], observations[1]);
+    ASSERT_EQ(rewards[0], rewards[1]);
+    ASSERT_EQ(dones[0], dones[1]);
+  }
+}
+
+TEST(MultiGridEnvTest, TestOpponentsPlay) {
+  bman::MultiGridEnv::Options options;
+  options.num_agents = 1;
+  bman::MultiGridEnv env(options);
+  const bman::GameState initial_state = env.game().game_state();
+  // The agent does nothing (no power-up to use), the SimpleAgents move.
+  const int32_t action = 5;
+  float reward = 0;
+  uint8_t done = 0;
+  for (int step = 0; step < 20; ++step) {
+    EXPECT_FALSE(env.Step(&action, &reward, &done));
+  }
+  for (int i = 1; i < 4; ++i) {
+    const auto& player = env.game().game_state().players(i);
+    const auto& initial_player = initial_state.players(i);
+    EXPECT_TRUE(player.x() != initial_player.x() ||
+                player.y() != initial_player.y())
+        << "player " << i;
+  }
+  const auto& agent = env.game().game_state().players(0);
+  EXPECT_EQ(initial_state.players(0).x(), agent.x());
+  EXPECT_EQ(initial_state.players(0).y(), agent.y());
+}
+
+TEST(MultiGridEnvTest, TestVecEnvMatchesGames) {
+  const int num_games = 3;
+  bman::MultiGridEnv::Options options;
+  options.num_agents = 2;
+  options.max_steps = 100;
+  options.observation.tensor_observation = true;
+  options.observation.frame_stack = 2;
+  bman::VecMultiGridEnv vec_env(num_games, 2, options);
+  std::vector<std::unique_ptr<bman::MultiGridEnv>> games;
+  for (int g = 0; g < num_games; ++g) {
+    games.emplace_back(new bman::MultiGridEnv(options));
+  }
+  const int num_envs = vec_env.num_envs();
+  ASSERT_EQ(num_games * 2, num_envs);
+  const int size = vec_env.observation_size();
+  std::vector<float> observations(num_envs * size);
+  std::vector<float> terminal_observations(num_envs * size);
+  std::vector<float> rewards(num_envs), expected_rewards(2);
+  std::vector<uint8_t> dones(num_envs), expected_dones(2);
+  std::vector<float> expected(size);
+  vec_env.Reset(observations.data());
+
+  std::mt19937 rng(3);
+  int num_deaths = 0, num_game_overs = 0;
+  for (int step = 0; step < 250; ++step) {
+    const auto actions = RandomActions(num_envs, &rng);
+    vec_env.Step(actions.data(), observations.data(), rewards.data(),
+                 dones.data(), terminal_observations.data());
+    for (int g = 0; g < num_games; ++g) {
+      const bool game_over =
+          games[g]->Step(&actions[g * 2], expected_rewards.data(),
+                         expected_dones.data());
+      num_game_overs += game_over;
+      for (int i = 0; i < 2; ++i) {
+        const int row = g * 2 + i;
+        EXPECT_FLOAT_EQ(expected_rewards[i], rewards[row]);
+        ASSERT_EQ(expected_dones[i], dones[row]);
+        EXPECT_TRUE(!game_over || dones[row]);
+        if (dones[row]) {
+          num_deaths += !game_over;
+          games[g]->Observe(i, expected.data());
+          EXPECT_TRUE(std::equal(expected.begin(), expected.end(),
+                                 &terminal_observations[row * size]));
+          games[g]->ResetAgentFrames(i);
+        }
+      }
+      if (game_over) {
+        games[g]->Reset();
+      }
+      for (int i = 0; i < 2; ++i) {
+        games[g]->Observe(i, expected.data());
+        EXPECT_TRUE(std::equal(expected.begin(), expected.end(),
+                               &observations[(g * 2 + i) * size]))
+            << "step " << step << " game " << g << " agent " << i;
+      }
+    }
+  }
+  EXPECT_GT(num_deaths, 0);
+  EXPECT_EQ(2 * num_games, num_game_overs);
+}
+
+int main() { return RUN_ALL_TESTS(); }
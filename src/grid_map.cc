@@ -3,7 +3,7 @@
 
 GridMap::GridMap(const bman::GameConfig& config,
                  const bman::GameState& game_state)
-    : game_config_(config), width_(config.level_width()) {
+    : width_(config.level_width()), height_(config.level_height()) {
   data_.resize(config.level_width() * config.level_height());
 
   BombMapConst bomb_map = Game::MakeBombMap(game_state);
@@ -33,7 +33,7 @@ GridMap::GridMap(const bman::GameConfig& config,
 }
 
 bool GridMap::CanMove(const Point2i& pt) const {
-  if (Game::IsStaticBrick(game_config_, pt.x, pt.y))
+  if (Game::IsStaticBrick(width_, height_, pt.x, pt.y))
     return false;
   const State& state = data_[pt.y * width_ + pt.x];
   return !(state.solid || state.bomb_player_id >= 0);
@@ -43,9 +43,9 @@ public:
   }
 
 private:
-  bman::GameConfig game_config_;
   std::vector<State> data_;
   int width_;
+  int height_;
 };
 
 #endif
@@ -0,0 +1,345 @@
+#include "level_generator.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+
+#include "game.h"
+#include "glog/logging.h"
+#include "point.h"
+
+namespace bman {
+
+namespace {
+
+struct PoolHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t num_players;
+  uint32_t config_size;
+  uint64_t num_levels;
+  // Followed by the config of every level (without bricks or spawn points)
+  // padded to 8 bytes, then the levels.
+};
+
+static_assert(sizeof(PoolHeader) == 24, "PoolHeader is packed");
+
+constexpr char kPoolMagic[4] = {'B', 'M', 'L', 'P'};
+constexpr uint32_t kPoolVersion = 1;
+
+size_t Padded(size_t size) { return (size + 7) & ~size_t(7); }
+
+// A level is a cell a nibble (row by row, low nibble first), 0 for none,
+// 1 for a brick and 2 + powerup for one hiding a powerup, then x and y a
+// byte each of the spawn points.
+size_t LevelSize(int width, int height, int num_players) {
+  return (width * height + 1) / 2 + 2 * num_players;
+}
+
+} // namespace
+
+LevelGenerator::LevelGenerator(const Options& options) : options_(options) {
+  CHECK(options_.width % 2 == 1 && options_.height % 2 == 1)
+      << "Levels must be an odd size";
+  CHECK_LE(options_.width, 255);
+  CHECK_LE(options_.height, 255);
+  CHECK_GT(options_.num_players, 0);
+  CHECK_LE(options_.min_brick_density, options_.max_brick_density);
+  CHECK_LE(options_.min_powerup_density, options_.max_powerup_density);
+  CHECK_LE((int)options_.powerup_weights.size(), bman::Powerup_ARRAYSIZE);
+}
+
+bool LevelGenerator::IsSafe(const std::vector<bool>& blocked, int x, int y,
+                            int strength) const {
+  const int width = options_.width, height = options_.height;
+  std::vector<bool> visited(blocked.size());
+  std::deque<Point2i> queue = {Point2i(x, y)};
+  visited[y * width + x] = true;
+  while (!queue.empty()) {
+    const Point2i p = queue.front();
+    queue.pop_front();
+    // Flames are stopped by walls, but this doesn't count on it.
+    const bool in_blast = (p.x == x && std::abs(p.y - y) <= strength) ||
+                          (p.y == y && std::abs(p.x - x) <= strength);
+    if (!in_blast) {
+      return true;
+    }
+    const Point2i neighbours[] = {Point2i(p.x - 1, p.y), Point2i(p.x + 1, p.y),
+                                  Point2i(p.x, p.y - 1),
+                                  Point2i(p.x, p.y + 1)};
+    for (const Point2i& n : neighbours) {
+      if (n.x < 0 || n.y < 0 || n.x >= width || n.y >= height ||
+          visited[n.y * width + n.x] || blocked[n.y * width + n.x]) {
+        continue;
+      }
+      visited[n.y * width + n.x] = true;
+      queue.push_back(n);
+    }
+  }
+  return false;
+}
+
+bman::GameConfig LevelGenerator::Generate(uint64_t seed) const {
+  std::seed_seq seq = {static_cast<uint32_t>(seed),
+                       static_cast<uint32_t>(seed >> 32)};
+  std::mt19937 rng(seq);
+  const int width = options_.width, height = options_.height;
+
+  // As BuildSimpleLevel's.
+  bman::GameConfig config;
+  config.set_level_width(width);
+  config.set_level_height(height);
+  auto* player_config = config.mutable_player_config();
+  player_config->set_num_bombs(2);
+  player_config->set_strength(1);
+  player_config->set_max_players(options_.num_players);
+  player_config->set_health(1);
+
+  std::vector<Point2i> spawns;
+  if (!options_.random_spawns) {
+    std::vector<Point2i> corners = {Point2i(0, 0),
+                                    Point2i(width - 1, height - 1),
+                                    Point2i(0, height - 1),
+                                    Point2i(width - 1, 0)};
+    std::shuffle(corners.begin(), corners.end(), rng);
+    for (int i = 0; i < options_.num_players; ++i) {
+      spawns.push_back(corners[i % corners.size()]);
+    }
+  } else {
+    std::vector<Point2i> cells;
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        if (!Game::IsStaticBrick(width, height, x, y)) {
+          cells.push_back(Point2i(x, y));
+        }
+      }
+    }
+    std::shuffle(cells.begin(), cells.end(), rng);
+    // Closer and closer until there's room for everyone.
+    for (int distance = options_.min_spawn_distance;
+         (int)spawns.size() < options_.num_players && distance > 0;
+         --distance) {
+      for (const Point2i& cell : cells) {
+        if ((int)spawns.size() == options_.num_players) {
+          break;
+        }
+        bool far_enough = true;
+        for (const Point2i& spawn : spawns) {
+          far_enough &= std::abs(cell.x - spawn.x) +
+                            std::abs(cell.y - spawn.y) >=
+                        distance;
+        }
+        if (far_enough) {
+          spawns.push_back(cell);
+        }
+      }
+    }
+    // More players than cells share them.
+    for (int i = 0; (int)spawns.size() < options_.num_players; ++i) {
+      spawns.push_back(spawns[i]);
+    }
+  }
+
+  // Clears the cells around each spawn, counting every other cell as a
+  // brick, until there's an escape from a bomb on it.
+  std::vector<bool> cleared(width * height);
+  const int strength = player_config->strength();
+  for (const Point2i& spawn : spawns) {
+    for (int radius = 0;; ++radius) {
+      std::vector<bool> blocked(width * height);
+      for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+          const int distance =
+              std::abs(x - spawn.x) + std::abs(y - spawn.y);
+          if (Game::IsStaticBrick(width, height, x, y)) {
+            blocked[y * width + x] = true;
+          } else if (distance <= radius) {
+            cleared[y * width + x] = true;
+          }
+          blocked[y * width + x] =
+              blocked[y * width + x] || !cleared[y * width + x];
+        }
+      }
+      if (IsSafe(blocked, spawn.x, spawn.y, strength)) {
+        break;
+      }
+      CHECK_LT(radius, width + height) << "No escape from a spawn";
+    }
+  }
+
+  std::uniform_real_distribution<float> uniform(0, 1);
+  const float brick_density =
+      options_.min_brick_density +
+      uniform(rng) * (options_.max_brick_density - options_.min_brick_density);
+  const float powerup_density =
+      options_.min_powerup_density +
+      uniform(rng) *
+          (options_.max_powerup_density - options_.min_powerup_density);
+  std::vector<float> weights = options_.powerup_weights;
+  if (!weights.empty()) {
+    weights[0] = 0;
+  }
+  const bool has_powerups = std::any_of(weights.begin(), weights.end(),
+                                        [](float w) { return w > 0; });
+  std::discrete_distribution<int> random_powerup(weights.begin(),
+                                                 weights.end());
+  auto* level_state = config.mutable_level_state();
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      if (Game::IsStaticBrick(width, height, x, y) ||
+          cleared[y * width + x] || uniform(rng) >= brick_density) {
+        continue;
+      }
+      auto* brick = level_state->add_bricks();
+      brick->set_x(x);
+      brick->set_y(y);
+      brick->set_solid(true);
+      if (has_powerups && uniform(rng) < powerup_density) {
+        brick->set_powerup(static_cast<bman::Powerup>(random_powerup(rng)));
+      }
+    }
+  }
+  for (const Point2i& spawn : spawns) {
+    auto* point = config.add_spawn_points();
+    point->set_x(spawn.x);
+    point->set_y(spawn.y);
+  }
+  return config;
+}
+
+bool LevelPool::Write(const std::string& path,
+                      const LevelGenerator& generator, int64_t num_levels,
+                      uint64_t seed) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (!file) {
+    LOG(ERROR) << "Unable to create " << path;
+    return false;
+  }
+  const LevelGenerator::Options& options = generator.options();
+  bman::GameConfig config = generator.Generate(seed);
+  config.clear_level_state();
+  config.clear_spawn_points();
+  const std::string config_data = config.SerializeAsString();
+
+  PoolHeader header = {};
+  std::memcpy(header.magic, kPoolMagic, sizeof(kPoolMagic));
+  header.version = kPoolVersion;
+  header.num_players = options.num_players;
+  header.config_size = config_data.size();
+  header.num_levels = num_levels;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  std::string padded = config_data;
+  padded.resize(Padded(config_data.size()));
+  ok = ok && fwrite(padded.data(), 1, padded.size(), file) == padded.size();
+
+  const int width = options.width, height = options.height;
+  std::vector<uint8_t> level(
+      LevelSize(width, height, options.num_players));
+  for (int64_t i = 0; i < num_levels && ok; ++i) {
+    config = generator.Generate(seed + i);
+    std::fill(level.begin(), level.end(), 0);
+    for (const auto& brick : config.level_state().bricks()) {
+      const int cell = brick.y() * width + brick.x();
+      const uint8_t value = brick.powerup() == bman::PUP_NONE
+                                ? 1
+                                : 2 + static_cast<int>(brick.powerup());
+      level[cell / 2] |= value << (4 * (cell % 2));
+    }
+    uint8_t* spawns = &level[(width * height + 1) / 2];
+    for (int p = 0; p < options.num_players; ++p) {
+      spawns[2 * p] = config.spawn_points(p).x();
+      spawns[2 * p + 1] = config.spawn_points(p).y();
+    }
+    ok = fwrite(level.data(), 1, level.size(), file) == level.size();
+  }
+  ok = fclose(file) == 0 && ok;
+  if (!ok) {
+    LOG(ERROR) << "Failed to write " << path;
+  }
+  return ok;
+}
+
+LevelPool::~LevelPool() {
+  if (data_) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+}
+
+bool LevelPool::Open(const std::string& path) {
+  CHECK(!data_) << "Already open";
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(ERROR) << "Unable to open " << path;
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(PoolHeader)) {
+    close(fd);
+    LOG(ERROR) << path << " is not a level pool";
+    return false;
+  }
+  size_ = st.st_size;
+  void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    LOG(ERROR) << "Unable to map " << path;
+    return false;
+  }
+  data_ = static_cast<const uint8_t*>(data);
+
+  PoolHeader header;
+  std::memcpy(&header, data_, sizeof(header));
+  const size_t levels_offset = sizeof(header) + Padded(header.config_size);
+  if (std::memcmp(header.magic, kPoolMagic, sizeof(kPoolMagic)) != 0 ||
+      header.version != kPoolVersion || levels_offset > size_ ||
+      !config_.ParseFromArray(data_ + sizeof(header), header.config_size)) {
+    LOG(ERROR) << path << " is not a level pool";
+    return false;
+  }
+  num_players_ = header.num_players;
+  level_size_ = LevelSize(width(), height(), num_players_);
+  if (levels_offset + header.num_levels * level_size_ > size_) {
+    LOG(ERROR) << path << " is truncated";
+    return false;
+  }
+  num_levels_ = header.num_levels;
+  levels_ = data_ + levels_offset;
+  return true;
+}
+
+void LevelPool::Get(int64_t index, bman::GameConfig* config) const {
+  CHECK(index >= 0 && index < num_levels_) << "No level " << index;
+  const uint8_t* level = levels_ + index * level_size_;
+  config->CopyFrom(config_);
+  auto* level_state = config->mutable_level_state();
+  const int num_cells = width() * height();
+  for (int cell = 0; cell < num_cells; ++cell) {
+    const int value = (level[cell / 2] >> (4 * (cell % 2))) & 0xf;
+    if (!value) {
+      continue;
+    }
+    auto* brick = level_state->add_bricks();
+    brick->set_x(cell % width());
+    brick->set_y(cell / width());
+    brick->set_solid(true);
+    if (value > 1) {
+      brick->set_powerup(static_cast<bman::Powerup>(value - 2));
+    }
+  }
+  const uint8_t* spawns = level + (num_cells + 1) / 2;
+  for (int p = 0; p < num_players_; ++p) {
+    auto* point = config->add_spawn_points();
+    point->set_x(spawns[2 * p]);
+    point->set_y(spawns[2 * p + 1]);
+  }
+}
+
+} // namespace bman
@@ -0,0 +1,98 @@
+#ifndef BMAN_LEVEL_GENERATOR_H
+#define BMAN_LEVEL_GENERATOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "constants.h"
+#include "level.grpc.pb.h"
+
+namespace bman {
+
+// Generates random levels from a seed, so that agents don't learn a single
+// map: the bricks, the powerups they hide and where the players spawn all
+// vary. Every spawn is left safe: a player dropping a bomb on it can reach
+// a cell out of the blast without breaking a brick.
+class LevelGenerator {
+public:
+  struct Options {
+    // Odd, so that the walls end at the edges as in the simple level.
+    int width = kDefaultWidth;
+    int height = kDefaultHeight;
+    int num_players = 4;
+    // Each level's chance of a brick on a free cell is drawn from
+    // [min_brick_density, max_brick_density], and the chance of a brick
+    // hiding a powerup from [min_powerup_density, max_powerup_density].
+    float min_brick_density = 0.3f;
+    float max_brick_density = 0.8f;
+    float min_powerup_density = 0.1f;
+    float max_powerup_density = 0.5f;
+    // Relative odds of each powerup, by bman::Powerup (PUP_NONE's is
+    // ignored).
+    std::vector<float> powerup_weights = {0, 1, 1, 1, 1};
+    // Spawn on random cells at least min_spawn_distance apart (closer if
+    // there isn't room), instead of the corners in a random order.
+    bool random_spawns = false;
+    int min_spawn_distance = 8;
+  };
+
+  LevelGenerator() : LevelGenerator(Options()) {}
+  explicit LevelGenerator(const Options& options);
+
+  // The level for the seed, for Game::BuildLevel: its size, player config,
+  // bricks (in level_state) and spawn points.
+  bman::GameConfig Generate(uint64_t seed) const;
+
+  const Options& options() const { return options_; }
+
+private:
+  // Whether a player can escape its own bomb on the spawn through the
+  // cells that aren't walls or bricks.
+  bool IsSafe(const std::vector<bool>& blocked, int x, int y,
+              int strength) const;
+
+  const Options options_;
+};
+
+// Levels generated ahead of time into a file, so that resets don't pay for
+// generation: each is 4 bits a cell and 2 bytes a spawn point (about 120
+// bytes for the simple level's size), and the file is memory mapped, so a
+// pool of millions only loads the pages of the levels used. All the levels
+// have the generator's size and number of players.
+class LevelPool {
+public:
+  LevelPool() = default;
+  ~LevelPool();
+  LevelPool(const LevelPool&) = delete;
+  LevelPool& operator=(const LevelPool&) = delete;
+
+  // Generates num_levels levels into the file, level i from seed + i.
+  // Returns false if it can't be written.
+  static bool Write(const std::string& path, const LevelGenerator& generator,
+                    int64_t num_levels, uint64_t seed);
+
+  // Maps the file. Returns false if it's missing or not a level pool.
+  bool Open(const std::string& path);
+
+  int64_t size() const { return num_levels_; }
+  int width() const { return config_.level_width(); }
+  int height() const { return config_.level_height(); }
+
+  // Fills config with the level, reusing its memory.
+  void Get(int64_t index, bman::GameConfig* config) const;
+
+private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  // Of every level, without the bricks or spawn points.
+  bman::GameConfig config_;
+  int num_players_ = 0;
+  int64_t num_levels_ = 0;
+  const uint8_t* levels_ = nullptr;
+  size_t level_size_ = 0;
+};
+
+} // namespace bman
+
+#endif
@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <memory>
+#include <set>
+
+#include "game.h"
+#include "grid_env.h"
+#include "level_generator.h"
+
+namespace {
+
+std::set<std::pair<int, int>> Bricks(const bman::GameConfig& config) {
+  std::set<std::pair<int, int>> bricks;
+  for (const auto& brick : config.level_state().bricks()) {
+    bricks.insert({brick.x(), brick.y()});
+  }
+  return bricks;
+}
+
+// Whether a player on (x, y) can walk out of a strength 1 blast from there.
+bool CanEscape(const bman::GameConfig& config, int x, int y) {
+  const int width = config.level_width(), height = config.level_height();
+  const auto bricks = Bricks(config);
+  auto is_free = [&](int cx, int cy) {
+    return cx >= 0 && cy >= 0 && cx < width && cy < height &&
+           !Game::IsStaticBrick(width, height, cx, cy) &&
+           !bricks.count({cx, cy});
+  };
+  // Two steps out along a row or column, or one and then around a corner.
+  const int dx[] = {-1, 1, 0, 0}, dy[] = {0, 0, -1, 1};
+  for (int d = 0; d < 4; ++d) {
+    const int nx = x + dx[d], ny = y + dy[d];
+    if (!is_free(nx, ny)) {
+      continue;
+    }
+    if (is_free(nx + dx[d], ny + dy[d]) || is_free(nx + dy[d], ny + dx[d]) ||
+        is_free(nx - dy[d], ny - dx[d])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+TEST(LevelGeneratorTest, TestIsDeterministic) {
+  bman::LevelGenerator generator;
+  EXPECT_EQ(generator.Generate(7).SerializeAsString(),
+            generator.Generate(7).SerializeAsString());
+  EXPECT_NE(generator.Generate(7).SerializeAsString(),
+            generator.Generate(8).SerializeAsString());
+}
+
+TEST(LevelGeneratorTest, TestSpawnsAreSafe) {
+  for (bool random_spawns : {false, true}) {
+    bman::LevelGenerator::Options options;
+    options.random_spawns = random_spawns;
+    options.min_brick_density = options.max_brick_density = 1;
+    bman::LevelGenerator generator(options);
+    for (uint64_t seed = 0; seed < 100; ++seed) {
+      const bman::GameConfig config = generator.Generate(seed);
+      const auto bricks = Bricks(config);
+      ASSERT_EQ(4, config.spawn_points_size());
+      for (const auto& spawn : config.spawn_points()) {
+        EXPECT_FALSE(bricks.count({spawn.x(), spawn.y()}));
+        EXPECT_FALSE(Game::IsStaticBrick(config.level_width(),
+                                         config.level_height(), spawn.x(),
+                                         spawn.y()));
+        EXPECT_TRUE(CanEscape(config, spawn.x(), spawn.y()))
+            << "Seed " << seed << " spawn " << spawn.x() << "," << spawn.y();
+      }
+    }
+  }
+}
+
+TEST(LevelGeneratorTest, TestVariesLevels) {
+  bman::LevelGenerator::Options options;
+  options.width = 21;
+  options.height = 15;
+  options.random_spawns = true;
+  options.min_spawn_distance = 10;
+  bman::LevelGenerator generator(options);
+  std::set<int> num_bricks;
+  std::set<int> powerups;
+  for (uint64_t seed = 0; seed < 100; ++seed) {
+    const bman::GameConfig config = generator.Generate(seed);
+    EXPECT_EQ(21, config.level_width());
+    EXPECT_EQ(15, config.level_height());
+    num_bricks.insert(config.level_state().bricks_size());
+    for (const auto& brick : config.level_state().bricks()) {
+      powerups.insert(brick.powerup());
+    }
+    // There's room for 4 spawns that far apart.
+    for (int i = 0; i < config.spawn_points_size(); ++i) {
+      for (int j = 0; j < i; ++j) {
+        const auto &a = config.spawn_points(i), &b = config.spawn_points(j);
+        EXPECT_GE(std::abs(a.x() - b.x()) + std::abs(a.y() - b.y()), 10);
+      }
+    }
+  }
+  EXPECT_GT(num_bricks.size(), 20u);
+  EXPECT_EQ(5u, powerups.size());
+}
+
+TEST(LevelGeneratorTest, TestPlayersSpawnAtSpawnPoints) {
+  bman::LevelGenerator::Options options;
+  options.num_players = 2;
+  options.random_spawns = true;
+  const bman::GameConfig config =
+      bman::LevelGenerator(options).Generate(3);
+  Game game;
+  game.BuildLevel(config);
+  for (int i = 0; i < 3; ++i) {
+    game.AddPlayer();
+  }
+  ASSERT_EQ(3, game.game_state().players_size());
+  for (int i = 0; i < 3; ++i) {
+    const auto& spawn = config.spawn_points(i % 2);
+    EXPECT_EQ(spawn.x() * kSubpixelSize + kSubpixelSize / 2,
+              game.game_state().players(i).x());
+    EXPECT_EQ(spawn.y() * kSubpixelSize + kSubpixelSize / 2,
+              game.game_state().players(i).y());
+  }
+  EXPECT_EQ(config.level_state().bricks_size(),
+            game.game_state().level().bricks_size());
+}
+
+TEST(LevelPoolTest, TestReadsGeneratedLevels) {
+  const std::string path = testing::TempDir() + "/level_pool_test.pool";
+  bman::LevelGenerator generator;
+  ASSERT_TRUE(bman::LevelPool::Write(path, generator, 50, 100));
+
+  bman::LevelPool pool;
+  ASSERT_TRUE(pool.Open(path));
+  EXPECT_EQ(50, pool.size());
+  EXPECT_EQ(kDefaultWidth, pool.width());
+  EXPECT_EQ(kDefaultHeight, pool.height());
+  bman::GameConfig config;
+  for (int i = 0; i < 50; ++i) {
+    pool.Get(i, &config);
+    EXPECT_EQ(generator.Generate(100 + i).SerializeAsString(),
+              config.SerializeAsString())
+        << "Level " << i;
+  }
+
+  bman::LevelPool missing_pool;
+  EXPECT_FALSE(missing_pool.Open(path + ".missing"));
+}
+
+TEST(LevelPoolTest, TestGridEnvResetsToRandomLevels) {
+  const std::string path = testing::TempDir() + "/grid_env_test.pool";
+  ASSERT_TRUE(bman::LevelPool::Write(path, bman::LevelGenerator(), 1000, 1));
+  auto levels = std::make_shared<bman::LevelPool>();
+  ASSERT_TRUE(levels->Open(path));
+
+  bman::GridEnv::Options options;
+  options.levels = levels;
+  bman::GridEnv env(options);
+  std::set<std::string> starts;
+  for (int i = 0; i < 20; ++i) {
+    env.Reset();
+    ASSERT_EQ(1, env.game().game_state().players_size());
+    starts.insert(env.game().game_state().SerializeAsString());
+  }
+  EXPECT_GT(starts.size(), 15u);
+
+  // Envs of a VecGridEnv are seeded apart.
+  bman::VecGridEnv vec_env(2, 1, options);
+  std::vector<float> observations(2 * vec_env.observation_size());
+  vec_env.Reset(observations.data());
+  EXPECT_NE(vec_env.game(0).game_state().SerializeAsString(),
+            vec_env.game(1).game_state().SerializeAsString());
+}
+
+int main() { return RUN_ALL_TESTS(); }
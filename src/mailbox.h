@@ -0,0 +1,56 @@
+#ifndef BMAN_MAILBOX_H
+#define BMAN_MAILBOX_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace bman {
+
+// Hands the newest of a stream of values from one thread to another without
+// either ever waiting (a triple buffer): the writer fills back() and
+// publishes it, replacing any value the reader hasn't taken yet, and the
+// reader takes the newest. Values are reused in place, so T's memory (e.g.,
+// a proto's) is allocated once.
+template <typename T> class Mailbox {
+public:
+  // The writer's value, to fill before Publish.
+  T* back() { return &values_[back_]; }
+
+  // Hands back() to the reader. The writer gets another value to fill.
+  void Publish() {
+    back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) &
+            kIndexMask;
+  }
+
+  // Whether the reader has taken the last published value, so that the
+  // writer can skip filling a value until it's wanted.
+  bool empty() const {
+    return !(middle_.load(std::memory_order_relaxed) & kFresh);
+  }
+
+  // Returns the newest value, or null if none has been published since the
+  // last Take. It's the reader's until the next Take.
+  const T* Take() {
+    if (empty()) {
+      return nullptr;
+    }
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    return &values_[front_];
+  }
+
+private:
+  static constexpr int kIndexMask = 3;
+  static constexpr int kFresh = 4;
+
+  T values_[3];
+  // Owned by the writer.
+  int back_ = 0;
+  // The index of the value between the threads, and whether it's fresh.
+  std::atomic<int> middle_{1};
+  // Owned by the reader.
+  int front_ = 2;
+};
+
+} // namespace bman
+
+#endif
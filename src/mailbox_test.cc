@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <pthread.h>
+
+#include "mailbox.h"
+
+namespace {
+
+// Two copies of a count, to catch values read while they're written.
+struct Value {
+  int64_t count = 0;
+  int64_t copy = 0;
+};
+
+constexpr int64_t kNumValues = 1000000;
+
+void* Write(void* arg) {
+  auto* mailbox = static_cast<bman::Mailbox<Value>*>(arg);
+  for (int64_t i = 1; i <= kNumValues; ++i) {
+    mailbox->back()->count = i;
+    mailbox->back()->copy = i;
+    mailbox->Publish();
+  }
+  return nullptr;
+}
+
+} // namespace
+
+TEST(MailboxTest, TestTakesNewest) {
+  bman::Mailbox<int> mailbox;
+  EXPECT_TRUE(mailbox.empty());
+  EXPECT_EQ(nullptr, mailbox.Take());
+
+  *mailbox.back() = 1;
+  mailbox.Publish();
+  EXPECT_FALSE(mailbox.empty());
+  *mailbox.back() = 2;
+  mailbox.Publish();
+  const int* value = mailbox.Take();
+  ASSERT_NE(nullptr, value);
+  EXPECT_EQ(2, *value);
+  EXPECT_TRUE(mailbox.empty());
+  EXPECT_EQ(nullptr, mailbox.Take());
+
+  // Publishing doesn't touch the value the reader holds.
+  *mailbox.back() = 3;
+  mailbox.Publish();
+  *mailbox.back() = 4;
+  EXPECT_EQ(2, *value);
+  EXPECT_EQ(3, *mailbox.Take());
+}
+
+TEST(MailboxTest, TestHandsOverBetweenThreads) {
+  bman::Mailbox<Value> mailbox;
+  pthread_t writer;
+  pthread_create(&writer, nullptr, &Write, &mailbox);
+  int64_t last = 0;
+  while (last < kNumValues) {
+    const Value* value = mailbox.Take();
+    if (!value) {
+      continue;
+    }
+    ASSERT_EQ(value->count, value->copy);
+    ASSERT_GT(value->count, last);
+    last = value->count;
+  }
+  pthread_join(writer, nullptr);
+}
+
+int main() { return RUN_ALL_TESTS(); }
@@ -13,6 +13,4 @@ inline int SignedMin(int val, int mag) {
   return sign(val) * std::min(abs(val), abs(mag));
 }
 
-inline double random_double() { return double(::rand()) / RAND_MAX; }
-
 #endif
@@ -0,0 +1,359 @@
+#include "mcts_agent.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "glog/logging.h"
+#include "timer.h"
+#include "world_analysis.h"
+
+namespace {
+// Iterations run by a task before it reschedules itself (so that idle
+// workers can steal the continuation).
+const int kIterationsPerTask = 4;
+
+// Node::children for actions that haven't been tried, and for those that
+// aren't worth trying.
+const int kUnexpanded = -1;
+const int kPruned = -2;
+} // namespace
+
+MctsAgent::MctsAgent(const bman::GameConfig& config, int player_index,
+                     const Options& options,
+                     std::shared_ptr<bman::ThreadPool> pool)
+    : game_config_(config), player_index_(player_index), options_(options),
+      pool_(pool ? pool
+                 : std::make_shared<bman::ThreadPool>(options.num_trees)),
+      num_iterations_(0), num_steps_(0) {
+  for (int i = 0; i < options_.num_trees; ++i) {
+    trees_.emplace_back(new Tree(config));
+  }
+}
+
+bman::MovePlayerRequest
+MctsAgent::GetPlayerAction(const bman::GameState& game_state) {
+  return GetPlayerActionBy(game_state,
+                           std::numeric_limits<double>::infinity());
+}
+
+bman::MovePlayerRequest
+MctsAgent::GetPlayerActionBy(const bman::GameState& game_state,
+                             double deadline_millis) {
+  bman::MovePlayerRequest move;
+  auto* action = move.add_actions();
+  if (player_index_ >= game_state.players_size()) {
+    return move;
+  }
+  const auto& player = game_state.players(player_index_);
+  if (player.state() == bman::PlayerState::STATE_DYING ||
+      player.state() == bman::PlayerState::STATE_SPAWNING) {
+    action_ticks_ = 0;
+    return move;
+  }
+  // Carry on with the current action until it's done (or we walked into
+  // something, as in Apply).
+  const Point2i pos(player.x(), player.y());
+  const bool stuck = action_ != ACTION_NONE && pos == last_pos_;
+  last_pos_ = pos;
+  if (action_ticks_ > 0 && !stuck &&
+      SetMove(player, action_, target_, /*first_tick=*/false, action)) {
+    action_ticks_--;
+    return move;
+  }
+  action_ = Search(game_state, deadline_millis);
+  target_ = GetTarget(player, action_);
+  action_ticks_ = (action_ == ACTION_NONE ? 1 : 2) * options_.ticks_per_action - 1;
+  SetMove(player, action_, target_, /*first_tick=*/true, action);
+  return move;
+}
+
+MctsAgent::Action MctsAgent::Search(const bman::GameState& game_state,
+                                    double deadline_millis) {
+  bman::Timer timer;
+  const double deadline = std::min(
+      deadline_millis, bman::Timer::NowMillis() + options_.budget_ms);
+  for (size_t i = 0; i < trees_.size(); ++i) {
+    Tree* tree = trees_[i].get();
+    tree->nodes.assign(1, Node());
+    tree->rng.seed(options_.seed * 7919 + num_decisions_ * 131 + i);
+    tree->iterations = 0;
+    pool_->Schedule([this, tree, &game_state, deadline] {
+      RunTree(tree, game_state, deadline);
+    });
+  }
+  pool_->Wait();
+  num_decisions_++;
+  search_millis_ += timer.ElapsedMillis();
+
+  // Most visited action over all of the trees (ties go to the higher
+  // value).
+  int visits[NUM_ACTIONS] = {0};
+  double values[NUM_ACTIONS] = {0};
+  for (const auto& tree : trees_) {
+    for (int a = 0; a < NUM_ACTIONS; ++a) {
+      const int child = tree->nodes[0].children[a];
+      if (child >= 0) {
+        visits[a] += tree->nodes[child].visits;
+        values[a] += tree->nodes[child].value;
+      }
+    }
+  }
+  Action best = ACTION_NONE;
+  for (int a = 1; a < NUM_ACTIONS; ++a) {
+    if (visits[a] > visits[best] ||
+        (visits[a] == visits[best] && values[a] > values[best])) {
+      best = static_cast<Action>(a);
+    }
+  }
+  VLOG(1) << "Player " << player_index_ << " action " << best << " after "
+          << timer.ElapsedMillis() << "ms";
+  return best;
+}
+
+void MctsAgent::RunTree(Tree* tree, const bman::GameState& root_state,
+                        double deadline_ms) {
+  for (int i = 0; i < kIterationsPerTask; ++i) {
+    const bool done = options_.max_iterations > 0
+                          ? tree->iterations >= options_.max_iterations
+                          : bman::Timer::NowMillis() >= deadline_ms;
+    if (done)
+      return;
+    Iterate(tree, root_state);
+  }
+  pool_->Schedule([this, tree, &root_state, deadline_ms] {
+    RunTree(tree, root_state, deadline_ms);
+  });
+}
+
+void MctsAgent::Iterate(Tree* tree, const bman::GameState& root_state) {
+  tree->game.set_game_state(root_state);
+  std::vector<int> path = {0};
+  bool alive = true;
+  int depth = 0;
+
+  // Selection and expansion (of the first untried action).
+  int node = 0;
+  while (alive && depth < options_.max_depth) {
+    int action = -1;
+    for (int a = 0; a < NUM_ACTIONS && action < 0; ++a) {
+      if (tree->nodes[node].children[a] != kUnexpanded)
+        continue;
+      // Walking into a wall is the same as waiting, don't search it twice.
+      const Point2i target = GetTarget(
+          tree->game.game_state().players(player_index_), static_cast<Action>(a));
+      if (a >= ACTION_LEFT && a <= ACTION_DOWN &&
+          Game::IsStaticBrick(game_config_, target.x, target.y)) {
+        tree->nodes[node].children[a] = kPruned;
+      } else {
+        action = a;
+      }
+    }
+    const bool expand = action >= 0;
+    if (expand) {
+      tree->nodes[node].children[action] = tree->nodes.size();
+      tree->nodes.emplace_back();
+    } else {
+      action = SelectChild(tree, node);
+    }
+    node = tree->nodes[node].children[action];
+    path.push_back(node);
+    alive = Apply(tree, static_cast<Action>(action));
+    depth++;
+    if (expand)
+      break;
+  }
+
+  // Random rollout. Only the tree places bombs, random bombs mostly end up
+  // blowing us up and drown out the value of the actions being searched.
+  std::uniform_int_distribution<int> random_action(ACTION_NONE, ACTION_DOWN);
+  while (alive && depth < options_.max_depth) {
+    alive = Apply(tree, static_cast<Action>(random_action(tree->rng)));
+    depth++;
+  }
+
+  const double value = Evaluate(*tree, root_state, alive);
+  for (int index : path) {
+    tree->nodes[index].visits++;
+    tree->nodes[index].value += value;
+  }
+  tree->iterations++;
+  num_iterations_++;
+}
+
+int MctsAgent::SelectChild(Tree* tree, int node) const {
+  const Node& parent = tree->nodes[node];
+  const double log_visits = std::log(std::max(1, parent.visits));
+  int best = 0;
+  double best_score = -1;
+  for (int a = 0; a < NUM_ACTIONS; ++a) {
+    if (parent.children[a] == kPruned)
+      continue;
+    const Node& child = tree->nodes[parent.children[a]];
+    const double score =
+        child.value / child.visits +
+        options_.exploration * std::sqrt(log_visits / child.visits);
+    if (score > best_score) {
+      best_score = score;
+      best = a;
+    }
+  }
+  return best;
+}
+
+bool MctsAgent::Apply(Tree* tree, Action action) {
+  Game& game = tree->game;
+  const int num_players = game.game_state().players_size();
+  tree->moves.resize(num_players);
+  std::uniform_int_distribution<int> random_move(ACTION_LEFT, ACTION_DOWN);
+  std::vector<Action> actions(num_players);
+  std::vector<Point2i> targets(num_players);
+  for (int i = 0; i < num_players; ++i) {
+    actions[i] = i == player_index_
+                     ? action
+                     : static_cast<Action>(random_move(tree->rng));
+    targets[i] = GetTarget(game.game_state().players(i), actions[i]);
+    if (!tree->moves[i].actions_size()) {
+      tree->moves[i].add_actions();
+    }
+  }
+  const int max_ticks =
+      action == ACTION_NONE ? options_.ticks_per_action
+                            : 2 * options_.ticks_per_action;
+  int ticks = 0;
+  while (ticks < max_ticks) {
+    const auto& player = game.game_state().players(player_index_);
+    const int x = player.x(), y = player.y();
+    bool done = true;
+    for (int i = 0; i < num_players; ++i) {
+      const bool active =
+          SetMove(game.game_state().players(i), actions[i], targets[i],
+                  ticks == 0, tree->moves[i].mutable_actions(0));
+      if (i == player_index_) {
+        done = !active;
+      }
+    }
+    if (done)
+      break;
+    game.Step(tree->moves);
+    ticks++;
+    const auto& moved = game.game_state().players(player_index_);
+    if (moved.state() == bman::PlayerState::STATE_DYING) {
+      num_steps_ += ticks;
+      return false;
+    }
+    // Walked into something.
+    if (action != ACTION_NONE && moved.x() == x && moved.y() == y)
+      break;
+  }
+  num_steps_ += ticks;
+  return true;
+}
+
+double MctsAgent::Evaluate(const Tree& tree, const bman::GameState& root_state,
+                           bool alive) const {
+  const bman::GameState& state = tree.game.game_state();
+  double value = state.score(player_index_) - root_state.score(player_index_);
+  if (!alive) {
+    value -= kPointsKill;
+    return std::max(0.0, 0.5 + value / (2.0 * kPointsKill));
+  }
+
+  // Bombs rarely go off within the horizon, so look ahead with the danger
+  // map: we're as good as dead if we can't get to a cell that no flame will
+  // reach in time, and the bricks our bombs will break are worth their
+  // points (plus the chance of a power-up).
+  const double brick_value = kPointsBrick + kPointsPowerUp / 3.0;
+  const int ticks_per_cell = kSubpixelSize / kAgentSpeed;
+  WorldAnalysis analysis(game_config_, state);
+  const DangerMap& danger_map = analysis.danger_map();
+  const GridMap& grid_map = analysis.grid_map();
+  const int ticks_until_flame =
+      danger_map.TicksUntilFlame(analysis.player_pos(player_index_));
+  bool can_escape = ticks_until_flame == DangerMap::kNever;
+  int brick_distance = -1;
+  for (int index : analysis.bfs_order(player_index_)) {
+    const Point2i cur = analysis.FromIndex(index);
+    const int distance = analysis.Distance(player_index_, cur);
+    // Leave a cell of slack, the other players (and our own rounding to
+    // cell centers) can slow us down.
+    if (!can_escape && danger_map.TicksUntilSafe(cur) == 0 &&
+        (distance + 1) * ticks_per_cell < ticks_until_flame) {
+      can_escape = true;
+    }
+    if (brick_distance < 0) {
+      for (const auto& dir : kDirs) {
+        const Point2i next(cur.x + dir[0], cur.y + dir[1]);
+        if (analysis.InBounds(next) && grid_map.HasSolidBrick(next)) {
+          brick_distance = distance;
+          break;
+        }
+      }
+    }
+    if (can_escape && brick_distance >= 0)
+      break;
+  }
+  if (!can_escape) {
+    value -= kPointsKill;
+  } else if (ticks_until_flame < 4 * ticks_per_cell) {
+    // Even when there's a way out, don't hang around where a flame is about
+    // to be.
+    value -= 2 * brick_value;
+  }
+  // A small pull towards bricks, so there's something to aim for when
+  // there are none in range.
+  if (brick_distance >= 0) {
+    value += 0.5 * brick_value / (1 + brick_distance);
+  }
+
+  for (const auto& bomb : state.level().bombs()) {
+    if (bomb.player_id() != player_index_)
+      continue;
+    for (const auto& dir : kDirs) {
+      for (int i = 1; i <= bomb.strength(); ++i) {
+        const Point2i pt(bomb.x() + dir[0] * i, bomb.y() + dir[1] * i);
+        if (Game::IsStaticBrick(game_config_, pt.x, pt.y))
+          break;
+        if (grid_map.HasSolidBrick(pt)) {
+          value += brick_value;
+          break;
+        }
+      }
+    }
+  }
+  return std::max(0.0, std::min(1.0, 0.5 + value / (2.0 * kPointsKill)));
+}
+
+Point2i MctsAgent::GetTarget(const bman::PlayerState& player,
+                             Action action) {
+  Point2i target(GridRound(player.x()), GridRound(player.y()));
+  if (action >= ACTION_LEFT && action <= ACTION_DOWN) {
+    target.x += kDirs[action - ACTION_LEFT][0];
+    target.y += kDirs[action - ACTION_LEFT][1];
+  }
+  return target;
+}
+
+bool MctsAgent::SetMove(const bman::PlayerState& player, Action action,
+                        const Point2i& target, bool first_tick,
+                        bman::MovePlayerRequest::Action* move) {
+  move->Clear();
+  if (action == ACTION_NONE)
+    return true;
+  if (action == ACTION_BOMB) {
+    move->set_place_bomb(first_tick);
+    return first_tick;
+  }
+  // Same as SimpleAgent, head for the center of the cell.
+  const Point2i delta(target.x * kSubpixelSize + kSubpixelSize / 2 - player.x(),
+                      target.y * kSubpixelSize + kSubpixelSize / 2 -
+                          player.y());
+  if (abs(delta.x) <= 2 && abs(delta.y) <= 2)
+    return false;
+  const int dir = Agent::GetDirFromDelta(delta.x, delta.y);
+  int dx, dy;
+  Agent::GetDeltaFromDir(dir, &dx, &dy);
+  move->set_dir(static_cast<bman::Direction>(dir));
+  move->set_dx(dx);
+  move->set_dy(dy);
+  return true;
+}
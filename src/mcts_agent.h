@@ -0,0 +1,128 @@
+#ifndef BMAN_MCTS_AGENT_H
+#define BMAN_MCTS_AGENT_H
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "agent.h"
+#include "game.h"
+#include "level.grpc.pb.h"
+#include "thread_pool.h"
+
+// Agent that picks actions with Monte Carlo tree search. Actions are
+// grid-aligned (walk to a neighbouring cell, wait, or place a bomb) and the
+// tree is over our own action sequences; each iteration replays the
+// sequence from the current state on a copy of the game, with the other
+// players walking at random (open-loop search). Search is root-parallel:
+// each worker grows its own tree and the root visit counts are summed to
+// pick an action.
+class MctsAgent : public Agent {
+public:
+  // Macro actions that the search chooses between.
+  enum Action {
+    ACTION_NONE,
+    ACTION_LEFT,
+    ACTION_RIGHT,
+    ACTION_UP,
+    ACTION_DOWN,
+    ACTION_BOMB,
+    NUM_ACTIONS,
+  };
+
+  struct Options {
+    // Hard budget for each decision (in wall-clock milliseconds).
+    double budget_ms = 8;
+    // If > 0, stop after this many iterations (per tree) instead, which
+    // makes the search deterministic.
+    int max_iterations = 0;
+    int num_trees = 4;
+    // Ticks to wait for ACTION_NONE (walking to a cell may take up to twice
+    // this).
+    int ticks_per_action = kSubpixelSize / kAgentSpeed;
+    // Number of actions in a rollout (including those from the tree).
+    int max_depth = 4;
+    double exploration = 1.0;
+    int seed = 1;
+  };
+
+  // The pool may be shared between agents, if none is given the agent
+  // creates one with a thread per tree.
+  MctsAgent(const bman::GameConfig& config, int player_index,
+            const Options& options,
+            std::shared_ptr<bman::ThreadPool> pool = nullptr);
+
+  bman::MovePlayerRequest
+  GetPlayerAction(const bman::GameState& game_state) override;
+  // Searches until the deadline if that's sooner than the budget.
+  bman::MovePlayerRequest
+  GetPlayerActionBy(const bman::GameState& game_state,
+                    double deadline_millis) override;
+  void Seed(uint32_t seed) override { options_.seed = seed; }
+
+  // Runs a search from the state and returns the best action.
+  Action Search(const bman::GameState& game_state,
+                double deadline_millis =
+                    std::numeric_limits<double>::infinity());
+
+  int64_t num_iterations() const { return num_iterations_; }
+  int64_t num_steps() const { return num_steps_; }
+  double search_millis() const { return search_millis_; }
+
+private:
+  struct Node {
+    int visits = 0;
+    double value = 0;
+    // Index of the child for each action (negative if not expanded).
+    int children[NUM_ACTIONS] = {-1, -1, -1, -1, -1, -1};
+  };
+  struct Tree {
+    explicit Tree(const bman::GameConfig& config) : game(config, {}) {}
+
+    Game game;
+    std::mt19937 rng;
+    std::vector<Node> nodes;
+    std::vector<bman::MovePlayerRequest> moves;
+    int iterations = 0;
+  };
+
+  // Runs a batch of iterations and reschedules itself until out of time.
+  void RunTree(Tree* tree, const bman::GameState& root_state,
+               double deadline_ms);
+  void Iterate(Tree* tree, const bman::GameState& root_state);
+  int SelectChild(Tree* tree, int node) const;
+  // Plays the action until it's done (other players walk to random
+  // neighbouring cells). Returns false if we died.
+  bool Apply(Tree* tree, Action action);
+  // Value in [0, 1] of the game state reached from the root.
+  double Evaluate(const Tree& tree, const bman::GameState& root_state,
+                  bool alive) const;
+
+  // Cell that the action walks to.
+  static Point2i GetTarget(const bman::PlayerState& player, Action action);
+  // Sets the move for the next tick of the action, returns false if the
+  // action is already done.
+  static bool SetMove(const bman::PlayerState& player, Action action,
+                      const Point2i& target, bool first_tick,
+                      bman::MovePlayerRequest::Action* move);
+
+  bman::GameConfig game_config_;
+  const int player_index_;
+  Options options_;
+  std::shared_ptr<bman::ThreadPool> pool_;
+  std::vector<std::unique_ptr<Tree>> trees_;
+
+  Action action_ = ACTION_NONE;
+  Point2i target_;
+  Point2i last_pos_;
+  int action_ticks_ = 0;
+  int num_decisions_ = 0;
+
+  std::atomic<int64_t> num_iterations_;
+  std::atomic<int64_t> num_steps_;
+  double search_millis_ = 0;
+};
+
+#endif
@@ -0,0 +1,102 @@
+// Benchmarks MctsAgent: search speed (iterations and simulated ticks per
+// second) and how it does against SimpleAgent. The MCTS agent plays as
+// player 0 against SimpleAgents in headless games:
+//
+//   ./bazel-bin/mcts_benchmark --num_games=20 --budget_ms=8 --num_trees=4
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "game.h"
+#include "mcts_agent.h"
+#include "simple_agent.h"
+
+DEFINE_int32(num_games, 10, "Number of games to play");
+DEFINE_int32(num_players, 4, "Number of players (one is MCTS)");
+DEFINE_int32(num_ticks, 60 * 60, "Length of each game in ticks");
+DEFINE_double(budget_ms, 8, "Search budget per decision");
+DEFINE_int32(max_iterations, 0,
+             "If set, search a fixed number of iterations per tree instead");
+DEFINE_int32(num_trees, 4, "Number of root-parallel trees (and threads)");
+DEFINE_int32(max_depth, 8, "Rollout depth (in actions)");
+DEFINE_int32(seed, 1, "Random seed");
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  MctsAgent::Options options;
+  options.budget_ms = FLAGS_budget_ms;
+  options.max_iterations = FLAGS_max_iterations;
+  options.num_trees = FLAGS_num_trees;
+  options.max_depth = FLAGS_max_depth;
+  auto pool = std::make_shared<bman::ThreadPool>(FLAGS_num_trees);
+
+  double wins = 0;
+  int64_t iterations = 0, steps = 0;
+  double search_millis = 0;
+  std::vector<double> total_scores(FLAGS_num_players, 0);
+  std::vector<int> deaths(FLAGS_num_players, 0);
+  printf("%5s %10s %10s  %s\n", "game", "iters/s", "ticks/s", "scores");
+  for (int g = 0; g < FLAGS_num_games; ++g) {
+    options.seed = FLAGS_seed + g;
+    Game game;
+    game.BuildSimpleLevel(2);
+    for (int i = 0; i < FLAGS_num_players; ++i) {
+      game.AddPlayer();
+    }
+    MctsAgent* mcts = new MctsAgent(game.config(), 0, options, pool);
+    std::vector<std::unique_ptr<Agent>> agents;
+    agents.emplace_back(mcts);
+    auto analysis_cache = std::make_shared<WorldAnalysisCache>();
+    for (int i = 1; i < FLAGS_num_players; ++i) {
+      agents.emplace_back(new SimpleAgent(game.config(), i, analysis_cache));
+    }
+
+    for (int tick = 0; tick < FLAGS_num_ticks; ++tick) {
+      std::vector<bman::MovePlayerRequest> moves;
+      for (auto& agent : agents) {
+        moves.push_back(agent->GetPlayerAction(game.game_state()));
+      }
+      game.Step(moves);
+      for (const auto& event : game.game_state().events()) {
+        if (event.type() == bman::GameEvent::EVENT_PLAYER_DIED) {
+          deaths[event.player_id()]++;
+        }
+      }
+    }
+
+    // Ties for the top score share the win.
+    const auto& scores = game.game_state().score();
+    const int best = *std::max_element(scores.begin(), scores.end());
+    const int num_best = std::count(scores.begin(), scores.end(), best);
+    if (scores[0] == best) {
+      wins += 1.0 / num_best;
+    }
+    std::string scores_str;
+    for (int i = 0; i < FLAGS_num_players; ++i) {
+      total_scores[i] += scores[i];
+      scores_str += std::to_string(scores[i]) + " ";
+    }
+    const double seconds = mcts->search_millis() / 1000;
+    printf("%5d %10.0f %10.0f  %s\n", g, mcts->num_iterations() / seconds,
+           mcts->num_steps() / seconds, scores_str.c_str());
+    iterations += mcts->num_iterations();
+    steps += mcts->num_steps();
+    search_millis += mcts->search_millis();
+  }
+
+  printf("\nmcts: %.0f iterations/s, %.0f simulated ticks/s, %ld steals\n",
+         iterations / (search_millis / 1000), steps / (search_millis / 1000),
+         pool->num_steals());
+  printf("win rate: %.3f\n", wins / FLAGS_num_games);
+  for (int i = 0; i < FLAGS_num_players; ++i) {
+    printf("player %d (%s): mean score %.1f, deaths %.1f\n", i,
+           i == 0 ? "mcts" : "simple", total_scores[i] / FLAGS_num_games,
+           double(deaths[i]) / FLAGS_num_games);
+  }
+  return 0;
+}
@@ -0,0 +1,102 @@
+#include "net_emulator.h"
+
+#include "glog/logging.h"
+#include <sstream>
+
+namespace bman {
+
+static bool GetProfile(const std::string& name, NetConditions* conditions) {
+  NetConditions c;
+  if (name == "lan") {
+    c.latency_ms = 1;
+    c.jitter_ms = 0.5;
+  } else if (name == "wifi") {
+    c.latency_ms = 15;
+    c.jitter_ms = 5;
+    c.loss = 0.005;
+  } else if (name == "mobile") {
+    c.latency_ms = 60;
+    c.jitter_ms = 20;
+    c.distribution = NetConditions::DIST_PARETO;
+    c.loss = 0.02;
+    c.reorder = 0.01;
+    c.bandwidth_kbps = 1000;
+  } else if (name == "congested") {
+    c.latency_ms = 120;
+    c.jitter_ms = 40;
+    c.loss = 0.05;
+    c.reorder = 0.05;
+    c.bandwidth_kbps = 256;
+  } else {
+    return false;
+  }
+  *conditions = c;
+  return true;
+}
+
+static bool GetDistribution(const std::string& name,
+                            NetConditions::Distribution* dist) {
+  if (name == "constant") {
+    *dist = NetConditions::DIST_CONSTANT;
+  } else if (name == "uniform") {
+    *dist = NetConditions::DIST_UNIFORM;
+  } else if (name == "normal") {
+    *dist = NetConditions::DIST_NORMAL;
+  } else if (name == "pareto") {
+    *dist = NetConditions::DIST_PARETO;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool ParseNetConditions(const std::string& desc, NetConditions* conditions) {
+  NetConditions result;
+  std::stringstream stream(desc);
+  std::string token;
+  while (std::getline(stream, token, ',')) {
+    if (token.empty())
+      continue;
+    const size_t eq = token.find('=');
+    if (eq == std::string::npos) {
+      if (!GetProfile(token, &result)) {
+        LOG(ERROR) << "Unknown network profile: " << token;
+        return false;
+      }
+      continue;
+    }
+    const std::string key = token.substr(0, eq);
+    const std::string value = token.substr(eq + 1);
+    if (key == "dist") {
+      if (!GetDistribution(value, &result.distribution)) {
+        LOG(ERROR) << "Unknown latency distribution: " << value;
+        return false;
+      }
+      continue;
+    }
+    char* end = nullptr;
+    const double number = strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0' || number < 0) {
+      LOG(ERROR) << "Invalid value for " << key << ": " << value;
+      return false;
+    }
+    if (key == "latency") {
+      result.latency_ms = number;
+    } else if (key == "jitter") {
+      result.jitter_ms = number;
+    } else if (key == "loss") {
+      result.loss = number;
+    } else if (key == "reorder") {
+      result.reorder = number;
+    } else if (key == "bandwidth") {
+      result.bandwidth_kbps = number;
+    } else {
+      LOG(ERROR) << "Unknown network parameter: " << key;
+      return false;
+    }
+  }
+  *conditions = result;
+  return true;
+}
+
+} // namespace bman
@@ -0,0 +1,170 @@
+#ifndef BMAN_NET_EMULATOR_H
+#define BMAN_NET_EMULATOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace bman {
+
+// Parameters of an emulated (one-way) network link.
+struct NetConditions {
+  enum Distribution {
+    DIST_CONSTANT = 0,
+    DIST_UNIFORM = 1,
+    DIST_NORMAL = 2,
+    DIST_PARETO = 3,
+  };
+  double latency_ms = 0;
+  double jitter_ms = 0;
+  Distribution distribution = DIST_NORMAL;
+  // Probability that an unreliable message is dropped.
+  double loss = 0;
+  // Probability that an unreliable message is allowed to overtake (or be
+  // overtaken by) its neighbours.
+  double reorder = 0;
+  // Link capacity in kilobits per second (0 means unlimited).
+  double bandwidth_kbps = 0;
+
+  bool enabled() const {
+    return latency_ms > 0 || jitter_ms > 0 || loss > 0 || reorder > 0 ||
+           bandwidth_kbps > 0;
+  }
+};
+
+// Parse a description of the form "profile,key=value,...". Known profiles
+// are lan, wifi, mobile and congested; keys are latency, jitter, dist
+// (constant, uniform, normal, pareto), loss, reorder and bandwidth.
+bool ParseNetConditions(const std::string& desc, NetConditions* conditions);
+
+struct NetLinkStats {
+  int sent = 0;
+  int dropped = 0;
+  int delivered = 0;
+  int reordered = 0;
+  int64_t bytes = 0;
+  double total_latency_ms = 0;
+
+  double mean_latency_ms() const {
+    return delivered ? total_latency_ms / delivered : 0;
+  }
+};
+
+// A simulated one-way link carrying messages of type T (anything with a
+// ByteSizeLong, e.g., a proto). Time is supplied by the caller, so a link
+// driven from a virtual clock with a fixed seed is fully deterministic.
+//
+// Reliable messages (unary RPCs) are never dropped and are delivered in
+// order. Unreliable ones (streaming messages) are subject to loss and
+// reordering.
+template <typename T> class NetLink {
+public:
+  NetLink(const NetConditions& conditions = NetConditions(),
+          uint32_t seed = 0)
+      : conditions_(conditions), rng_(seed) {}
+
+  // Returns false if the message was dropped.
+  bool Send(const T& message, double now_ms, bool reliable = true) {
+    const int64_t bytes = message.ByteSizeLong();
+    stats_.sent++;
+    stats_.bytes += bytes;
+    if (!reliable && Uniform() < conditions_.loss) {
+      stats_.dropped++;
+      return false;
+    }
+    // Messages queue behind each other for the link's capacity.
+    double departure = now_ms;
+    if (conditions_.bandwidth_kbps > 0) {
+      departure = std::max(now_ms, busy_until_ms_) +
+                  bytes * 8 / conditions_.bandwidth_kbps;
+      busy_until_ms_ = departure;
+    }
+    double delivery = departure + SampleLatency();
+    const bool may_reorder = !reliable && Uniform() < conditions_.reorder;
+    if (!may_reorder) {
+      delivery = std::max(delivery, last_delivery_ms_);
+      last_delivery_ms_ = delivery;
+    }
+    queue_.push({delivery, now_ms, next_sequence_++, message});
+    return true;
+  }
+
+  // Append all messages deliverable by now_ms to out, in arrival order.
+  // Returns the number of messages appended.
+  int Receive(double now_ms, std::vector<T>* out) {
+    int count = 0;
+    while (!queue_.empty() && queue_.top().delivery_ms <= now_ms) {
+      const Pending& pending = queue_.top();
+      if (pending.sequence < last_sequence_delivered_) {
+        stats_.reordered++;
+      }
+      last_sequence_delivered_ =
+          std::max(last_sequence_delivered_, pending.sequence);
+      stats_.delivered++;
+      stats_.total_latency_ms += pending.delivery_ms - pending.sent_ms;
+      out->push_back(pending.message);
+      queue_.pop();
+      count++;
+    }
+    return count;
+  }
+
+  int num_pending() const { return queue_.size(); }
+  const NetLinkStats& stats() const { return stats_; }
+  const NetConditions& conditions() const { return conditions_; }
+
+private:
+  struct Pending {
+    double delivery_ms;
+    double sent_ms;
+    int64_t sequence;
+    T message;
+
+    bool operator<(const Pending& other) const {
+      // Reversed as std::priority_queue is a max-heap.
+      if (delivery_ms != other.delivery_ms)
+        return delivery_ms > other.delivery_ms;
+      return sequence > other.sequence;
+    }
+  };
+
+  double Uniform() { return std::uniform_real_distribution<double>()(rng_); }
+
+  double SampleLatency() {
+    double latency = conditions_.latency_ms;
+    const double jitter = conditions_.jitter_ms;
+    switch (conditions_.distribution) {
+    case NetConditions::DIST_CONSTANT:
+      break;
+    case NetConditions::DIST_UNIFORM:
+      latency += jitter * (2 * Uniform() - 1);
+      break;
+    case NetConditions::DIST_NORMAL:
+      latency += jitter * std::normal_distribution<double>()(rng_);
+      break;
+    case NetConditions::DIST_PARETO: {
+      // Heavy tail with shape 2.5, whose mean is 2/3 of the scale.
+      const double u = std::max(1e-9, Uniform());
+      latency += jitter * (std::pow(u, -1 / 2.5) - 1);
+      break;
+    }
+    }
+    return std::max(0.0, latency);
+  }
+
+  NetConditions conditions_;
+  std::mt19937 rng_;
+  std::priority_queue<Pending> queue_;
+  double busy_until_ms_ = 0;
+  double last_delivery_ms_ = 0;
+  int64_t next_sequence_ = 0;
+  int64_t last_sequence_delivered_ = -1;
+  NetLinkStats stats_;
+};
+
+} // namespace bman
+
+#endif
@@ -0,0 +1,200 @@
+// A reproducible benchmark of the game under emulated network conditions.
+//
+// Runs SimpleAgent clients against an in-process server loop (mirroring
+// GameRunner in bman_server.cc) on a virtual clock, with every request and
+// response passing through a NetLink. For a fixed seed the output is
+// deterministic, so latency-hiding and bandwidth changes can be compared
+// run to run on a single machine:
+//
+//   ./bazel-bin/net_emulator_benchmark --profiles="lan;mobile,loss=0.1"
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "game.h"
+#include "level.grpc.pb.h"
+#include "net_emulator.h"
+#include "simple_agent.h"
+
+DEFINE_string(profiles, "lan;wifi;mobile;congested",
+              "Semi-colon separated list of network conditions to run");
+DEFINE_int32(num_players, 4, "Number of agents in the game");
+DEFINE_int32(num_ticks, 60 * 60, "Number of server ticks to simulate");
+DEFINE_int32(seed, 1, "Random seed (for the network)");
+DEFINE_bool(streaming, false,
+            "Treat messages as unreliable streaming messages");
+DEFINE_bool(send_on_change, false,
+            "Clients only send input when it changes, the server holds the "
+            "last input and pushes the state every tick");
+
+namespace {
+
+const double kTickMs = 1000.0 / 60;
+
+struct Result {
+  bman::NetLinkStats up;
+  bman::NetLinkStats down;
+  double mean_state_age = 0;
+  double mean_input_delay = 0;
+  std::vector<int> scores;
+};
+
+Result RunScenario(const bman::NetConditions& conditions) {
+  Game game;
+  game.BuildSimpleLevel(2);
+  auto analysis_cache = std::make_shared<WorldAnalysisCache>();
+  std::vector<std::unique_ptr<Agent>> agents;
+  std::vector<bman::NetLink<bman::MovePlayerRequest>> uplinks;
+  std::vector<bman::NetLink<bman::MovePlayerResponse>> downlinks;
+  for (int i = 0; i < FLAGS_num_players; ++i) {
+    game.AddPlayer();
+    agents.emplace_back(new SimpleAgent(game.config(), i, analysis_cache));
+    uplinks.emplace_back(conditions, FLAGS_seed * 1000 + 2 * i);
+    downlinks.emplace_back(conditions, FLAGS_seed * 1000 + 2 * i + 1);
+  }
+  const bool reliable = !FLAGS_streaming;
+
+  std::vector<bman::GameState> client_states(FLAGS_num_players,
+                                             game.game_state());
+  std::vector<bman::MovePlayerRequest::Action> last_sent(FLAGS_num_players);
+  std::vector<bman::MovePlayerRequest::Action> held(FLAGS_num_players);
+  int64_t total_state_age = 0;
+  int64_t total_input_delay = 0;
+  int64_t num_inputs = 0;
+
+  for (int tick = 0; tick < FLAGS_num_ticks; ++tick) {
+    const double now = tick * kTickMs;
+
+    // Clients act on whatever state they have and send their input.
+    for (int i = 0; i < FLAGS_num_players; ++i) {
+      bman::MovePlayerRequest request =
+          agents[i]->GetPlayerAction(client_states[i]);
+      request.set_player_index(i);
+      request.set_client_clock(client_states[i].clock());
+      for (auto& action : *request.mutable_actions()) {
+        action.set_clock(tick);
+      }
+      if (FLAGS_send_on_change && request.actions_size()) {
+        const auto& action = request.actions(0);
+        if (tick > 0 && action.dx() == last_sent[i].dx() &&
+            action.dy() == last_sent[i].dy() && !action.place_bomb() &&
+            !action.use_powerup()) {
+          continue;
+        }
+        last_sent[i] = action;
+      }
+      uplinks[i].Send(request, now, reliable);
+    }
+
+    // The server merges delivered input, steps, and answers each request.
+    std::vector<bman::MovePlayerRequest> moves(FLAGS_num_players);
+    std::vector<int> num_responses(FLAGS_num_players, 0);
+    for (int i = 0; i < FLAGS_num_players; ++i) {
+      std::vector<bman::MovePlayerRequest> delivered;
+      uplinks[i].Receive(now, &delivered);
+      for (const auto& request : delivered) {
+        for (const auto& action : request.actions()) {
+          *moves[i].add_actions() = action;
+          total_input_delay += tick - action.clock();
+          num_inputs++;
+        }
+      }
+      num_responses[i] = delivered.size();
+      if (FLAGS_send_on_change) {
+        if (moves[i].actions_size()) {
+          held[i] = moves[i].actions(moves[i].actions_size() - 1);
+          held[i].clear_place_bomb();
+          held[i].clear_use_powerup();
+        } else {
+          *moves[i].add_actions() = held[i];
+        }
+        num_responses[i] = 1;
+      }
+    }
+    game.Step(moves);
+    for (int i = 0; i < FLAGS_num_players; ++i) {
+      bman::MovePlayerResponse response;
+      *response.mutable_game_state() = game.game_state();
+      for (int k = 0; k < num_responses[i]; ++k) {
+        downlinks[i].Send(response, now, reliable);
+      }
+    }
+
+    // Clients keep the newest state that has arrived.
+    for (int i = 0; i < FLAGS_num_players; ++i) {
+      std::vector<bman::MovePlayerResponse> responses;
+      downlinks[i].Receive(now, &responses);
+      for (const auto& response : responses) {
+        if (response.game_state().clock() >= client_states[i].clock()) {
+          client_states[i] = response.game_state();
+        }
+      }
+      total_state_age += game.game_state().clock() - client_states[i].clock();
+    }
+  }
+
+  Result result;
+  for (int i = 0; i < FLAGS_num_players; ++i) {
+    const auto& up = uplinks[i].stats();
+    const auto& down = downlinks[i].stats();
+    result.up.sent += up.sent;
+    result.up.dropped += up.dropped;
+    result.up.delivered += up.delivered;
+    result.up.reordered += up.reordered;
+    result.up.bytes += up.bytes;
+    result.up.total_latency_ms += up.total_latency_ms;
+    result.down.sent += down.sent;
+    result.down.dropped += down.dropped;
+    result.down.delivered += down.delivered;
+    result.down.reordered += down.reordered;
+    result.down.bytes += down.bytes;
+    result.down.total_latency_ms += down.total_latency_ms;
+    result.scores.push_back(game.game_state().score(i));
+  }
+  result.mean_state_age =
+      double(total_state_age) / (FLAGS_num_ticks * FLAGS_num_players);
+  result.mean_input_delay = num_inputs ? double(total_input_delay) / num_inputs
+                                       : 0;
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  const double seconds = FLAGS_num_ticks * kTickMs / 1000;
+  printf("%-40s %8s %7s %7s %9s %9s %9s %9s  %s\n", "conditions", "up_ms",
+         "drop%", "reord", "up_kbps", "down_kbps", "state_age", "input_lag",
+         "scores");
+
+  std::stringstream stream(FLAGS_profiles);
+  std::string profile;
+  while (std::getline(stream, profile, ';')) {
+    bman::NetConditions conditions;
+    if (!bman::ParseNetConditions(profile, &conditions)) {
+      LOG(ERROR) << "Skipping invalid conditions: " << profile;
+      continue;
+    }
+    const Result result = RunScenario(conditions);
+    std::string scores;
+    for (int score : result.scores) {
+      scores += std::to_string(score) + " ";
+    }
+    const int sent = result.up.sent + result.down.sent;
+    printf("%-40s %8.2f %7.2f %7d %9.1f %9.1f %9.2f %9.2f  %s\n",
+           profile.c_str(), result.up.mean_latency_ms(),
+           sent ? 100.0 * (result.up.dropped + result.down.dropped) / sent : 0,
+           result.up.reordered + result.down.reordered,
+           result.up.bytes * 8 / 1000.0 / seconds,
+           result.down.bytes * 8 / 1000.0 / seconds, result.mean_state_age,
+           result.mean_input_delay, scores.c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,127 @@
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "level.grpc.pb.h"
+#include "net_emulator.h"
+
+typedef bman::NetLink<bman::MovePlayerRequest> RequestLink;
+
+class NetEmulatorTest : public testing::Test {
+public:
+  bman::MovePlayerRequest MakeRequest(int clock) {
+    bman::MovePlayerRequest request;
+    request.set_client_clock(clock);
+    request.add_actions()->set_dx(4);
+    return request;
+  }
+};
+
+TEST_F(NetEmulatorTest, TestConstantLatency) {
+  bman::NetConditions conditions;
+  conditions.latency_ms = 50;
+  conditions.distribution = bman::NetConditions::DIST_CONSTANT;
+  RequestLink link(conditions);
+
+  EXPECT_TRUE(link.Send(MakeRequest(1), 0));
+  std::vector<bman::MovePlayerRequest> out;
+  EXPECT_EQ(0, link.Receive(49.9, &out));
+  EXPECT_EQ(1, link.Receive(50, &out));
+  EXPECT_EQ(1, out[0].client_clock());
+  EXPECT_EQ(50, link.stats().mean_latency_ms());
+}
+
+TEST_F(NetEmulatorTest, TestLossOnlyAffectsUnreliable) {
+  bman::NetConditions conditions;
+  conditions.loss = 0.25;
+  RequestLink link(conditions, 7);
+
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_TRUE(link.Send(MakeRequest(i), i, /*reliable=*/true));
+  }
+  EXPECT_EQ(0, link.stats().dropped);
+
+  for (int i = 0; i < 1000; ++i) {
+    link.Send(MakeRequest(i), i, /*reliable=*/false);
+  }
+  EXPECT_GT(link.stats().dropped, 200);
+  EXPECT_LT(link.stats().dropped, 300);
+}
+
+TEST_F(NetEmulatorTest, TestReliableIsInOrder) {
+  bman::NetConditions conditions;
+  conditions.latency_ms = 30;
+  conditions.jitter_ms = 30;
+  conditions.reorder = 1;
+  RequestLink link(conditions, 3);
+  for (int i = 0; i < 100; ++i) {
+    link.Send(MakeRequest(i), i);
+  }
+  std::vector<bman::MovePlayerRequest> out;
+  link.Receive(1e6, &out);
+  ASSERT_EQ(100, (int)out.size());
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(i, out[i].client_clock());
+  }
+  EXPECT_EQ(0, link.stats().reordered);
+}
+
+TEST_F(NetEmulatorTest, TestUnreliableReorders) {
+  bman::NetConditions conditions;
+  conditions.latency_ms = 30;
+  conditions.jitter_ms = 30;
+  conditions.reorder = 0.5;
+  RequestLink link(conditions, 3);
+  for (int i = 0; i < 100; ++i) {
+    link.Send(MakeRequest(i), i, /*reliable=*/false);
+  }
+  std::vector<bman::MovePlayerRequest> out;
+  link.Receive(1e6, &out);
+  EXPECT_EQ(100, (int)out.size());
+  EXPECT_GT(link.stats().reordered, 0);
+}
+
+TEST_F(NetEmulatorTest, TestBandwidthCap) {
+  bman::NetConditions conditions;
+  conditions.bandwidth_kbps = 8; // One byte per millisecond.
+  RequestLink link(conditions);
+  const bman::MovePlayerRequest request = MakeRequest(1);
+  const int bytes = request.ByteSizeLong();
+
+  link.Send(request, 0);
+  link.Send(request, 0);
+  std::vector<bman::MovePlayerRequest> out;
+  EXPECT_EQ(1, link.Receive(bytes, &out));
+  EXPECT_EQ(0, link.Receive(2 * bytes - 0.5, &out));
+  EXPECT_EQ(1, link.Receive(2 * bytes, &out));
+}
+
+TEST_F(NetEmulatorTest, TestDeterministic) {
+  bman::NetConditions conditions;
+  EXPECT_TRUE(bman::ParseNetConditions("mobile", &conditions));
+  RequestLink a(conditions, 11), b(conditions, 11);
+  std::vector<bman::MovePlayerRequest> out_a, out_b;
+  for (int i = 0; i < 200; ++i) {
+    a.Send(MakeRequest(i), i * 16.0, false);
+    b.Send(MakeRequest(i), i * 16.0, false);
+    EXPECT_EQ(a.Receive(i * 16.0, &out_a), b.Receive(i * 16.0, &out_b));
+  }
+  EXPECT_EQ(a.stats().total_latency_ms, b.stats().total_latency_ms);
+}
+
+TEST_F(NetEmulatorTest, TestParse) {
+  bman::NetConditions conditions;
+  EXPECT_TRUE(bman::ParseNetConditions(
+      "wifi,latency=40,dist=uniform,bandwidth=128", &conditions));
+  EXPECT_EQ(40, conditions.latency_ms);
+  EXPECT_EQ(5, conditions.jitter_ms);
+  EXPECT_EQ(bman::NetConditions::DIST_UNIFORM, conditions.distribution);
+  EXPECT_EQ(128, conditions.bandwidth_kbps);
+  EXPECT_TRUE(conditions.enabled());
+
+  EXPECT_FALSE(bman::ParseNetConditions("satellite", &conditions));
+  EXPECT_FALSE(bman::ParseNetConditions("latency=fast", &conditions));
+  EXPECT_FALSE(bman::ParseNetConditions("mtu=1500", &conditions));
+}
+
+int main() { return RUN_ALL_TESTS(); }
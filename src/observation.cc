@@ -0,0 +1,132 @@
+#include "observation.h"
+
+#include <algorithm>
+
+#include "constants.h"
+#include "danger_map.h"
+#include "game.h"
+#include "grid_map.h"
+#include "math.h"
+
+namespace bman {
+
+void GridObservation::BuildGrid(const bman::GameState& game_state,
+                                float* data) const {
+  const int w = config_.level_width();
+  const int h = config_.level_height();
+  GridMap gm(config_, game_state);
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      Point2i pt(x, y);
+      float value = 0;
+      if (gm.HasSolidBrick(pt)) {
+        value = 0.75;
+      } else if (gm.HasBomb(pt)) {
+        value = -0.5;
+      } else if (gm.IsExplosion(pt)) {
+        value = -1.0;
+      } else if (gm.HasPowerup(pt)) {
+        value = 1.0;
+      } else if (!gm.CanMove(pt)) {
+        value = 0.5;
+      }
+      for (int i = 0; i < expand_; ++i) {
+        for (int j = 0; j < expand_; ++j) {
+          data[(y * expand_ + i) * w * expand_ + (x * expand_ + j)] = value;
+        }
+      }
+    }
+  }
+}
+
+void GridObservation::MarkPlayer(const bman::GameState& game_state,
+                                 int player_index, float* data) const {
+  if (player_index < game_state.players_size()) {
+    const auto& player = game_state.players(player_index);
+    Point2i pt(GridRound(player.x() * expand_),
+               GridRound(player.y() * expand_));
+    data[pt.y * width() + pt.x] = 0.25;
+  }
+}
+
+TensorObservation::TensorObservation(const bman::GameConfig& config,
+                                     const Options& options)
+    : config_(config), options_(options), walls_(channel_size()) {
+  for (int y = 0; y < height(); ++y) {
+    for (int x = 0; x < width(); ++x) {
+      walls_[y * width() + x] = Game::IsStaticBrick(config, x, y);
+    }
+  }
+}
+
+void TensorObservation::Build(const bman::GameState& game_state,
+                              int player_index, float* data) const {
+  const int w = width();
+  const int h = height();
+  auto channel = [&](int c) { return data + c * channel_size(); };
+  auto in_bounds = [&](int x, int y) {
+    return x >= 0 && y >= 0 && x < w && y < h;
+  };
+  std::copy(walls_.begin(), walls_.end(), channel(kWalls));
+  std::fill(data + channel_size(), data + size(), 0.0f);
+
+  for (const auto& brick : game_state.level().bricks()) {
+    if (!in_bounds(brick.x(), brick.y()))
+      continue;
+    const int index = brick.y() * w + brick.x();
+    if (brick.solid()) {
+      channel(kBricks)[index] = 1;
+    } else if (brick.powerup() != bman::PUP_NONE) {
+      channel(powerup_channel(brick.powerup()))[index] = 1;
+    }
+  }
+  for (const auto& bomb : game_state.level().bombs()) {
+    if (in_bounds(bomb.x(), bomb.y())) {
+      channel(kBombs)[bomb.y() * w + bomb.x()] =
+          std::max(0, bomb.timer()) / float(kDefaultBombTimer);
+    }
+  }
+  for (const auto& explosion : game_state.level().explosions()) {
+    const float value =
+        std::max(0, explosion.timer()) / float(kExplosionTimer);
+    for (const auto& point : explosion.points()) {
+      if (in_bounds(point.x(), point.y())) {
+        float& cell = channel(kFlames)[point.y() * w + point.x()];
+        cell = std::max(cell, value);
+      }
+    }
+  }
+
+  // The observed player first, then the others.
+  int slot = 0;
+  for (int i = -1; i < game_state.players_size(); ++i) {
+    const int index = i < 0 ? player_index : i;
+    if (i == player_index || index >= game_state.players_size())
+      continue;
+    if (slot >= options_.num_players)
+      break;
+    const auto& player = game_state.players(index);
+    const int x = GridRound(player.x());
+    const int y = GridRound(player.y());
+    if (player.state() != bman::PlayerState::STATE_DYING &&
+        in_bounds(x, y)) {
+      channel(player_channel(slot))[y * w + x] = 1;
+    }
+    slot++;
+  }
+
+  if (options_.danger) {
+    const DangerMap danger(config_, game_state);
+    float* danger_data = channel(danger_channel());
+    for (int y = 0; y < h; ++y) {
+      for (int x = 0; x < w; ++x) {
+        const int ticks = danger.TicksUntilFlame(Point2i(x, y));
+        if (ticks < kDefaultBombTimer) {
+          danger_data[y * w + x] = 1 - ticks / float(kDefaultBombTimer);
+        }
+      }
+    }
+  }
+}
+
+} // namespace bman
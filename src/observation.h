@@ -0,0 +1,142 @@
+#ifndef BMAN_OBSERVATION_H
+#define BMAN_OBSERVATION_H
+
+#include <algorithm>
+#include <vector>
+
+#include "level.grpc.pb.h"
+
+namespace bman {
+
+// The observation that the grid policies are trained on (python/bman_env.py
+// through game_wrapper's Map): one value per cell, scaled up expand times in
+// each direction, with the player marked in the scaled up grid. Row-major,
+// height() rows of width() values.
+class GridObservation {
+public:
+  static constexpr int kDefaultExpand = 3;
+
+  explicit GridObservation(const bman::GameConfig& config,
+                           int expand = kDefaultExpand)
+      : config_(config), expand_(expand) {}
+
+  int width() const { return config_.level_width() * expand_; }
+  int height() const { return config_.level_height() * expand_; }
+  int size() const { return width() * height(); }
+
+  // Fills size() values of data, marking player_index as the player.
+  void Build(const bman::GameState& game_state, int player_index,
+             float* data) const {
+    BuildGrid(game_state, data);
+    MarkPlayer(game_state, player_index, data);
+  }
+  // The two halves of Build, so that the grid (the same for every player)
+  // can be built once and copied for each player.
+  void BuildGrid(const bman::GameState& game_state, float* data) const;
+  void MarkPlayer(const bman::GameState& game_state, int player_index,
+                  float* data) const;
+
+private:
+  bman::GameConfig config_;
+  int expand_;
+};
+
+// A richer observation for training new policies: channels-first (C x H x
+// W) at cell resolution, with a channel for each kind of thing rather than
+// one plane of magic values:
+//
+//   walls, bricks      1 where there's one
+//   bombs              the bomb's remaining timer over kDefaultBombTimer
+//   flames             the flame's remaining timer over kExplosionTimer
+//   players            a channel each (the observed player first, then the
+//                      others in order), 1 where they are
+//   powerups           a channel per type from PUP_FLAME, 1 where revealed
+//   danger (optional)  1 - (ticks until flame) / kDefaultBombTimer as
+//                      predicted by DangerMap, 0 if no bomb will reach it
+class TensorObservation {
+public:
+  struct Options {
+    int num_players = 4;
+    bool danger = false;
+  };
+  enum Channel {
+    kWalls = 0,
+    kBricks = 1,
+    kBombs = 2,
+    kFlames = 3,
+    kPlayers = 4,
+  };
+  static constexpr int kNumPowerups = bman::Powerup_MAX;
+
+  explicit TensorObservation(const bman::GameConfig& config)
+      : TensorObservation(config, Options()) {}
+  TensorObservation(const bman::GameConfig& config, const Options& options);
+
+  int width() const { return config_.level_width(); }
+  int height() const { return config_.level_height(); }
+  int num_channels() const {
+    return kPlayers + options_.num_players + kNumPowerups + options_.danger;
+  }
+  int channel_size() const { return width() * height(); }
+  int size() const { return num_channels() * channel_size(); }
+
+  int player_channel(int i) const { return kPlayers + i; }
+  int powerup_channel(bman::Powerup powerup) const {
+    return kPlayers + options_.num_players + powerup - 1;
+  }
+  int danger_channel() const {
+    return kPlayers + options_.num_players + kNumPowerups;
+  }
+
+  // Fills size() values of data, as seen by player_index.
+  void Build(const bman::GameState& game_state, int player_index,
+             float* data) const;
+
+private:
+  bman::GameConfig config_;
+  Options options_;
+  // The walls channel, which never changes.
+  std::vector<float> walls_;
+};
+
+// The last num_frames observations (of frame_size values each) in a ring,
+// so that pushing a frame overwrites the oldest in place rather than
+// shifting the others. Stacked, the frames are concatenated oldest first,
+// i.e. along the channel axis of a TensorObservation.
+class FrameStack {
+public:
+  FrameStack(int frame_size, int num_frames)
+      : frame_size_(frame_size), num_frames_(num_frames),
+        frames_(frame_size * num_frames) {}
+
+  int frame_size() const { return frame_size_; }
+  int num_frames() const { return num_frames_; }
+  int size() const { return frames_.size(); }
+
+  // Returns where to build the newest frame (replacing the oldest).
+  float* Push() {
+    float* frame = &frames_[oldest_ * frame_size_];
+    oldest_ = (oldest_ + 1) % num_frames_;
+    return frame;
+  }
+  // Zeroes every frame (e.g., at the start of an episode).
+  void Clear() { std::fill(frames_.begin(), frames_.end(), 0.0f); }
+  // Copies the frames, oldest first, to size() values of data.
+  void Copy(float* data) const {
+    const int split = oldest_ * frame_size_;
+    std::copy(frames_.begin() + split, frames_.end(), data);
+    std::copy(frames_.begin(), frames_.begin() + split,
+              data + frames_.size() - split);
+  }
+
+private:
+  const int frame_size_;
+  const int num_frames_;
+  std::vector<float> frames_;
+  // Slot of the oldest frame.
+  int oldest_ = 0;
+};
+
+} // namespace bman
+
+#endif
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include "game.h"
+#include "observation.h"
+
+class TensorObservationTest : public testing::Test {
+public:
+  void SetUp() override {
+    game_.BuildSimpleLevel(2);
+    game_.AddPlayer();
+    game_.AddPlayer();
+  }
+
+  // Value of the channel at (x, y).
+  float At(const bman::TensorObservation& observation,
+           const std::vector<float>& data, int channel, int x, int y) {
+    return data[(channel * observation.height() + y) * observation.width() +
+                x];
+  }
+
+  Game game_;
+};
+
+TEST_F(TensorObservationTest, TestChannels) {
+  auto* level = game_.game_state().mutable_level();
+  auto* bomb = level->add_bombs();
+  bomb->set_x(2);
+  bomb->set_y(0);
+  bomb->set_timer(kDefaultBombTimer / 2);
+  auto* explosion = level->add_explosions();
+  explosion->set_timer(kExplosionTimer);
+  auto* point = explosion->add_points();
+  point->set_x(4);
+  point->set_y(0);
+  auto* brick = level->add_bricks();
+  brick->set_x(6);
+  brick->set_y(0);
+  brick->set_powerup(bman::PUP_KICK);
+
+  bman::TensorObservation::Options options;
+  options.danger = true;
+  bman::TensorObservation observation(game_.config(), options);
+  std::vector<float> data(observation.size(), -1);
+  observation.Build(game_.game_state(), 1, data.data());
+
+  using Tensor = bman::TensorObservation;
+  EXPECT_EQ(1, At(observation, data, Tensor::kWalls, 1, 1));
+  EXPECT_EQ(0, At(observation, data, Tensor::kWalls, 0, 0));
+  EXPECT_FLOAT_EQ(0.5, At(observation, data, Tensor::kBombs, 2, 0));
+  EXPECT_EQ(1, At(observation, data, Tensor::kFlames, 4, 0));
+  EXPECT_EQ(1, At(observation, data,
+                  observation.powerup_channel(bman::PUP_KICK), 6, 0));
+  EXPECT_EQ(0, At(observation, data, Tensor::kBricks, 6, 0));
+
+  // Player 1 sees itself first, in the opposite corner.
+  EXPECT_EQ(1, At(observation, data, observation.player_channel(0),
+                  kDefaultWidth - 1, kDefaultHeight - 1));
+  EXPECT_EQ(1, At(observation, data, observation.player_channel(1), 0, 0));
+  EXPECT_EQ(0, At(observation, data, observation.player_channel(1),
+                  kDefaultWidth - 1, kDefaultHeight - 1));
+
+  // The bomb's cell burns in half a bomb timer, the flame's cell now.
+  EXPECT_FLOAT_EQ(0.5, At(observation, data, observation.danger_channel(), 2,
+                          0));
+  EXPECT_EQ(1, At(observation, data, observation.danger_channel(), 4, 0));
+  EXPECT_EQ(0, At(observation, data, observation.danger_channel(), 10, 6));
+
+  for (float value : data) {
+    EXPECT_TRUE(value >= 0 && value <= 1);
+  }
+}
+
+TEST(FrameStackTest, TestOldestFirst) {
+  bman::FrameStack stack(2, 3);
+  for (int frame = 1; frame <= 4; ++frame) {
+    float* data = stack.Push();
+    data[0] = frame;
+    data[1] = -frame;
+  }
+  std::vector<float> stacked(stack.size());
+  stack.Copy(stacked.data());
+  EXPECT_EQ(std::vector<float>({2, -2, 3, -3, 4, -4}), stacked);
+
+  stack.Clear();
+  stack.Push()[0] = 5;
+  stack.Copy(stacked.data());
+  EXPECT_EQ(std::vector<float>({0, 0, 0, 0, 5, 0}), stacked);
+}
+
+int main() { return RUN_ALL_TESTS(); }
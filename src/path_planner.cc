@@ -0,0 +1,235 @@
+#include "path_planner.h"
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <map>
+
+#include "game.h"
+
+namespace {
+
+// Same neighbour order as the agents' searches.
+const Point2i kNeighbors[4] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+// All-pairs distances over the static walls (a BFS from every cell), by
+// level size. Levels are small (17x13 cells is 48k entries).
+std::shared_ptr<const std::vector<int>> GetStaticDistances(int width,
+                                                           int height) {
+  static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  static auto* cache =
+      new std::map<std::pair<int, int>, std::shared_ptr<std::vector<int>>>;
+  pthread_mutex_lock(&mutex);
+  auto& distances = (*cache)[std::make_pair(width, height)];
+  if (!distances) {
+    const int size = width * height;
+    distances = std::make_shared<std::vector<int>>(size * size,
+                                                   PathPlanner::kInfinity);
+    std::vector<int> queue;
+    for (int source = 0; source < size; ++source) {
+      if (Game::IsStaticBrick(width, height, source % width, source / width))
+        continue;
+      int* row = &(*distances)[source * size];
+      row[source] = 0;
+      queue.assign(1, source);
+      for (size_t head = 0; head < queue.size(); ++head) {
+        const Point2i cur(queue[head] % width, queue[head] / width);
+        for (const auto& n : kNeighbors) {
+          const Point2i other = cur + n;
+          if (Game::IsStaticBrick(width, height, other.x, other.y))
+            continue;
+          const int index = other.y * width + other.x;
+          if (row[index] == PathPlanner::kInfinity) {
+            row[index] = row[queue[head]] + 1;
+            queue.push_back(index);
+          }
+        }
+      }
+    }
+  }
+  std::shared_ptr<const std::vector<int>> result = distances;
+  pthread_mutex_unlock(&mutex);
+  return result;
+}
+
+} // namespace
+
+PathPlanner::PathPlanner(const bman::GameConfig& config)
+    : width_(config.level_width()), height_(config.level_height()),
+      size_(width_ * height_),
+      static_distances_(GetStaticDistances(width_, height_)),
+      neighbors_(size_), blocked_(size_, false), g_(size_, kInfinity),
+      rhs_(size_, kInfinity), queued_key_(size_), in_queue_(size_, false) {
+  for (int index = 0; index < size_; ++index) {
+    const Point2i cur = FromIndex(index);
+    if (Game::IsStaticBrick(width_, height_, cur.x, cur.y)) {
+      blocked_[index] = true;
+      continue;
+    }
+    cells_.push_back(cur);
+    for (const auto& n : kNeighbors) {
+      const Point2i other = cur + n;
+      if (!Game::IsStaticBrick(width_, height_, other.x, other.y)) {
+        neighbors_[index].push_back(Index(other));
+      }
+    }
+  }
+}
+
+void PathPlanner::SetGoal(const Point2i& goal) {
+  goal_ = goal;
+  has_goal_ = true;
+  km_ = 0;
+  last_start_ = start_;
+  std::fill(g_.begin(), g_.end(), kInfinity);
+  std::fill(rhs_.begin(), rhs_.end(), kInfinity);
+  std::fill(in_queue_.begin(), in_queue_.end(), false);
+  queue_ = decltype(queue_)();
+  const int index = Index(goal_);
+  rhs_[index] = 0;
+  in_queue_[index] = true;
+  queued_key_[index] = CalculateKey(index);
+  queue_.push({queued_key_[index], index});
+}
+
+void PathPlanner::SetStart(const Point2i& start) {
+  if (has_goal_) {
+    // Keys already in the queue were computed from the old start, rather
+    // than updating them all, offset every new key by how much the
+    // heuristic can have dropped.
+    km_ += Heuristic(Index(last_start_), Index(start));
+    last_start_ = start;
+  }
+  start_ = start;
+}
+
+void PathPlanner::SetBlocked(const Point2i& pt, bool blocked) {
+  if (!Game::IsStaticBrick(width_, height_, pt.x, pt.y) &&
+      blocked_[Index(pt)] != blocked) {
+    SetBlocked(Index(pt), blocked);
+  }
+}
+
+void PathPlanner::Update(const GridMap& grid_map) {
+  for (const auto& pt : cells_) {
+    const bool blocked = !grid_map.CanMove(pt);
+    if (blocked_[Index(pt)] != blocked) {
+      SetBlocked(Index(pt), blocked);
+    }
+  }
+}
+
+void PathPlanner::SetBlocked(int index, bool blocked) {
+  num_changed_cells_++;
+  blocked_[index] = blocked;
+  if (!has_goal_)
+    return;
+  // Only the cost of entering the cell changed, which affects the rhs of
+  // its neighbours.
+  for (int other : neighbors_[index]) {
+    UpdateVertex(other);
+  }
+}
+
+bool PathPlanner::ComputePath(std::vector<Point2i>* path) {
+  path->clear();
+  if (!has_goal_)
+    return false;
+  ComputeShortestPath();
+  int cur = Index(start_);
+  if (rhs_[cur] >= kInfinity)
+    return false;
+  const int goal = Index(goal_);
+  while (cur != goal) {
+    int best = -1;
+    int best_cost = kInfinity;
+    for (int other : neighbors_[cur]) {
+      if (blocked_[other] || g_[other] >= kInfinity)
+        continue;
+      if (g_[other] + 1 < best_cost) {
+        best_cost = g_[other] + 1;
+        best = other;
+      }
+    }
+    if (best < 0)
+      return false;
+    cur = best;
+    path->push_back(FromIndex(cur));
+  }
+  return true;
+}
+
+PathPlanner::Key PathPlanner::CalculateKey(int index) const {
+  const int value = std::min(g_[index], rhs_[index]);
+  if (value >= kInfinity)
+    return Key(kInfinity, kInfinity);
+  return Key(value + Heuristic(Index(start_), index) + km_, value);
+}
+
+void PathPlanner::UpdateVertex(int index) {
+  if (index != Index(goal_)) {
+    int rhs = kInfinity;
+    for (int other : neighbors_[index]) {
+      if (!blocked_[other] && g_[other] < kInfinity) {
+        rhs = std::min(rhs, g_[other] + 1);
+      }
+    }
+    rhs_[index] = rhs;
+  }
+  if (g_[index] != rhs_[index]) {
+    const Key key = CalculateKey(index);
+    if (!in_queue_[index] || queued_key_[index] != key) {
+      in_queue_[index] = true;
+      queued_key_[index] = key;
+      queue_.push({key, index});
+    }
+  } else {
+    in_queue_[index] = false;
+  }
+}
+
+bool PathPlanner::Top(QueueEntry* entry) {
+  while (!queue_.empty()) {
+    const QueueEntry& top = queue_.top();
+    if (in_queue_[top.index] && queued_key_[top.index] == top.key) {
+      *entry = top;
+      return true;
+    }
+    queue_.pop();
+  }
+  return false;
+}
+
+void PathPlanner::ComputeShortestPath() {
+  const int start = Index(start_);
+  QueueEntry top;
+  while (Top(&top) &&
+         (top.key < CalculateKey(start) || rhs_[start] > g_[start])) {
+    const int index = top.index;
+    const Key key = CalculateKey(index);
+    num_expansions_++;
+    if (top.key < key) {
+      // Queued with an old start.
+      queue_.pop();
+      queued_key_[index] = key;
+      queue_.push({key, index});
+    } else if (g_[index] > rhs_[index]) {
+      queue_.pop();
+      in_queue_[index] = false;
+      g_[index] = rhs_[index];
+      if (!blocked_[index]) {
+        for (int other : neighbors_[index]) {
+          UpdateVertex(other);
+        }
+      }
+    } else {
+      queue_.pop();
+      in_queue_[index] = false;
+      g_[index] = kInfinity;
+      UpdateVertex(index);
+      for (int other : neighbors_[index]) {
+        UpdateVertex(other);
+      }
+    }
+  }
+}
@@ -0,0 +1,110 @@
+#ifndef BMAN_PATH_PLANNER_H
+#define BMAN_PATH_PLANNER_H
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "grid_map.h"
+#include "level.grpc.pb.h"
+#include "point.h"
+
+// Incremental shortest paths to a goal cell (D* Lite, Koenig & Likhachev
+// 2002). The search runs backwards from the goal so that the start can move
+// and cells can become blocked (bombs) or free (bricks destroyed, bombs
+// exploded) without starting over: only the cells whose distance actually
+// changes are expanded again. The heuristic is the distance over the static
+// walls alone, which is precomputed once per level size and shared.
+class PathPlanner {
+public:
+  static constexpr int kInfinity = std::numeric_limits<int>::max() / 2;
+
+  explicit PathPlanner(const bman::GameConfig& config);
+
+  // Starts a new search to the goal.
+  void SetGoal(const Point2i& goal);
+  void SetStart(const Point2i& start);
+  // Cells that can't be entered (the start can always be left, even if the
+  // player is standing on a bomb).
+  void SetBlocked(const Point2i& pt, bool blocked);
+  // Calls SetBlocked for every cell that changed since the last update (a
+  // scan of the map, the search only revisits what changed).
+  void Update(const GridMap& grid_map);
+
+  // Finds the shortest path from the start to the goal (excluding the start
+  // itself). Returns false if the goal can't be reached.
+  bool ComputePath(std::vector<Point2i>* path);
+  // Steps from the start to the goal, kInfinity if unreachable (valid after
+  // ComputePath, the search stops once the start's rhs is settled).
+  int Distance() const { return rhs_[Index(start_)]; }
+
+  const Point2i& goal() const { return goal_; }
+  const Point2i& start() const { return start_; }
+  bool has_goal() const { return has_goal_; }
+
+  // Distance between cells considering only the static walls.
+  int StaticDistance(const Point2i& a, const Point2i& b) const {
+    return (*static_distances_)[Index(a) * size_ + Index(b)];
+  }
+
+  // Totals over the lifetime of the planner.
+  int64_t num_expansions() const { return num_expansions_; }
+  int64_t num_changed_cells() const { return num_changed_cells_; }
+
+private:
+  typedef std::pair<int, int> Key;
+  struct QueueEntry {
+    Key key;
+    int index;
+    bool operator>(const QueueEntry& other) const {
+      return key > other.key;
+    }
+  };
+
+  int Index(const Point2i& pt) const { return pt.y * width_ + pt.x; }
+  Point2i FromIndex(int index) const {
+    return Point2i(index % width_, index / width_);
+  }
+  int Heuristic(int a, int b) const {
+    return (*static_distances_)[a * size_ + b];
+  }
+  void SetBlocked(int index, bool blocked);
+  Key CalculateKey(int index) const;
+  // Recomputes rhs from the successors and requeues the cell if it's
+  // inconsistent.
+  void UpdateVertex(int index);
+  void ComputeShortestPath();
+  // Pops stale entries, returns false if the queue is empty.
+  bool Top(QueueEntry* entry);
+
+  int width_;
+  int height_;
+  int size_;
+  std::shared_ptr<const std::vector<int>> static_distances_;
+  // Cells that aren't static walls, and their neighbours that aren't either.
+  std::vector<Point2i> cells_;
+  std::vector<std::vector<int>> neighbors_;
+  std::vector<uint8_t> blocked_;
+
+  bool has_goal_ = false;
+  Point2i goal_;
+  Point2i start_;
+  Point2i last_start_;
+  int km_ = 0;
+  std::vector<int> g_;
+  std::vector<int> rhs_;
+  // Key of each cell in the queue (entries with another key are stale).
+  std::vector<Key> queued_key_;
+  std::vector<bool> in_queue_;
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>,
+                      std::greater<QueueEntry>>
+      queue_;
+
+  int64_t num_expansions_ = 0;
+  int64_t num_changed_cells_ = 0;
+};
+
+#endif
@@ -0,0 +1,140 @@
+// Benchmarks PathPlanner against a BFS from scratch on busy maps: SimpleAgents
+// play headless games (placing bombs and destroying bricks) while every
+// player keeps a path to a random goal up to date, replanning each tick:
+//
+//   ./bazel-bin/path_planner_benchmark --num_games=10 --goal_ticks=64
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "game.h"
+#include "grid_map.h"
+#include "path_planner.h"
+#include "simple_agent.h"
+#include "timer.h"
+
+DEFINE_int32(num_games, 10, "Number of games to play");
+DEFINE_int32(num_players, 4, "Number of players");
+DEFINE_int32(num_ticks, 60 * 60, "Length of each game in ticks");
+DEFINE_int32(goal_ticks, 64, "Ticks before choosing a new goal");
+DEFINE_int32(seed, 1, "Random seed");
+
+namespace {
+
+// Shortest distance by BFS, -1 if the goal can't be reached. The buffers are
+// reused so that only the search itself is measured.
+int BfsDistance(const bman::GameConfig& config, const GridMap& grid_map,
+                const Point2i& start, const Point2i& goal,
+                std::vector<int>* distance, std::vector<Point2i>* queue) {
+  const int width = config.level_width();
+  const int height = config.level_height();
+  distance->assign(width * height, -1);
+  queue->assign(1, start);
+  (*distance)[start.y * width + start.x] = 0;
+  for (size_t head = 0; head < queue->size(); ++head) {
+    const Point2i cur = (*queue)[head];
+    if (cur == goal)
+      return (*distance)[cur.y * width + cur.x];
+    for (const auto& dir : kDirs) {
+      const Point2i other(cur.x + dir[0], cur.y + dir[1]);
+      if (other.x < 0 || other.y < 0 || other.x >= width ||
+          other.y >= height || !grid_map.CanMove(other) ||
+          (*distance)[other.y * width + other.x] >= 0)
+        continue;
+      (*distance)[other.y * width + other.x] =
+          (*distance)[cur.y * width + cur.x] + 1;
+      queue->push_back(other);
+    }
+  }
+  return -1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  std::mt19937 rng(FLAGS_seed);
+  int64_t replans = 0, expansions = 0, changed_cells = 0, new_goals = 0;
+  double planner_millis = 0, bfs_millis = 0;
+  std::vector<int> distance;
+  std::vector<Point2i> queue;
+  std::vector<Point2i> path;
+  for (int g = 0; g < FLAGS_num_games; ++g) {
+    Game game;
+    game.BuildSimpleLevel(2);
+    for (int i = 0; i < FLAGS_num_players; ++i) {
+      game.AddPlayer();
+    }
+    std::vector<std::unique_ptr<Agent>> agents;
+    std::vector<std::unique_ptr<PathPlanner>> planners;
+    auto analysis_cache = std::make_shared<WorldAnalysisCache>();
+    for (int i = 0; i < FLAGS_num_players; ++i) {
+      agents.emplace_back(new SimpleAgent(game.config(), i, analysis_cache));
+      planners.emplace_back(new PathPlanner(game.config()));
+    }
+    std::uniform_int_distribution<int> random_x(
+        0, game.config().level_width() - 1);
+    std::uniform_int_distribution<int> random_y(
+        0, game.config().level_height() - 1);
+
+    for (int tick = 0; tick < FLAGS_num_ticks; ++tick) {
+      std::vector<bman::MovePlayerRequest> moves;
+      for (auto& agent : agents) {
+        moves.push_back(agent->GetPlayerAction(game.game_state()));
+      }
+      game.Step(moves);
+
+      const GridMap grid_map(game.config(), game.game_state());
+      for (int i = 0; i < FLAGS_num_players; ++i) {
+        const auto& player = game.game_state().players(i);
+        const Point2i start(GridRound(player.x()), GridRound(player.y()));
+        PathPlanner* planner = planners[i].get();
+        if (!planner->has_goal() || planner->goal() == start ||
+            tick % FLAGS_goal_ticks == 0) {
+          Point2i goal;
+          do {
+            goal = Point2i(random_x(rng), random_y(rng));
+          } while (Game::IsStaticBrick(game.config(), goal.x, goal.y));
+          planner->SetStart(start);
+          planner->SetGoal(goal);
+          new_goals++;
+        }
+
+        const int64_t expansions_before = planner->num_expansions();
+        const int64_t changed_before = planner->num_changed_cells();
+        bman::Timer timer;
+        planner->Update(grid_map);
+        planner->SetStart(start);
+        const bool found = planner->ComputePath(&path);
+        planner_millis += timer.ElapsedMillis();
+        expansions += planner->num_expansions() - expansions_before;
+        changed_cells += planner->num_changed_cells() - changed_before;
+        replans++;
+
+        timer.Start();
+        const int expected =
+            BfsDistance(game.config(), grid_map, start, planner->goal(),
+                        &distance, &queue);
+        bfs_millis += timer.ElapsedMillis();
+        CHECK_EQ(expected >= 0, found);
+        if (found) {
+          CHECK_EQ(expected, planner->Distance());
+        }
+      }
+    }
+  }
+
+  printf("%ld replans (%ld new goals)\n", replans, new_goals);
+  printf("d* lite: %.0f replans/s, %.1f expansions and %.2f changed cells "
+         "per replan\n",
+         replans / (planner_millis / 1000), double(expansions) / replans,
+         double(changed_cells) / replans);
+  printf("bfs:     %.0f replans/s\n", replans / (bfs_millis / 1000));
+  return 0;
+}
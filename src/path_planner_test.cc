@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "game.h"
+#include "path_planner.h"
+
+class PathPlannerTest : public testing::Test {
+public:
+  void SetUp() override {
+    config_.set_level_width(kDefaultWidth);
+    config_.set_level_height(kDefaultHeight);
+    blocked_.assign(kDefaultWidth * kDefaultHeight, false);
+  }
+
+  void SetBlocked(PathPlanner* planner, const Point2i& pt, bool blocked) {
+    blocked_[pt.y * kDefaultWidth + pt.x] = blocked;
+    planner->SetBlocked(pt, blocked);
+  }
+
+  bool IsFree(const Point2i& pt) const {
+    return !Game::IsStaticBrick(config_, pt.x, pt.y) &&
+           !blocked_[pt.y * kDefaultWidth + pt.x];
+  }
+
+  // Distance by BFS from scratch (-1 if unreachable).
+  int BfsDistance(const Point2i& start, const Point2i& goal) const {
+    std::vector<int> distance(kDefaultWidth * kDefaultHeight, -1);
+    std::vector<Point2i> queue = {start};
+    distance[start.y * kDefaultWidth + start.x] = 0;
+    for (size_t head = 0; head < queue.size(); ++head) {
+      const Point2i cur = queue[head];
+      if (cur == goal)
+        return distance[cur.y * kDefaultWidth + cur.x];
+      for (const auto& dir : kDirs) {
+        const Point2i other(cur.x + dir[0], cur.y + dir[1]);
+        if (!IsFree(other) || distance[other.y * kDefaultWidth + other.x] >= 0)
+          continue;
+        distance[other.y * kDefaultWidth + other.x] =
+            distance[cur.y * kDefaultWidth + cur.x] + 1;
+        queue.push_back(other);
+      }
+    }
+    return -1;
+  }
+
+  // Checks that the path is a walk through free cells from start to goal.
+  void ExpectValidPath(const Point2i& start, const Point2i& goal,
+                       const std::vector<Point2i>& path) {
+    ASSERT_FALSE(path.empty());
+    EXPECT_EQ(goal, path.back());
+    Point2i prev = start;
+    for (const auto& pt : path) {
+      EXPECT_EQ(1, abs(pt.x - prev.x) + abs(pt.y - prev.y));
+      EXPECT_TRUE(IsFree(pt));
+      prev = pt;
+    }
+  }
+
+  bman::GameConfig config_;
+  std::vector<bool> blocked_;
+};
+
+TEST_F(PathPlannerTest, TestStaticDistance) {
+  PathPlanner planner(config_);
+  EXPECT_EQ(3, planner.StaticDistance(Point2i(0, 0), Point2i(2, 1)));
+  // Has to go around the wall at (1, 1).
+  EXPECT_EQ(4, planner.StaticDistance(Point2i(1, 0), Point2i(1, 2)));
+}
+
+TEST_F(PathPlannerTest, TestOpenLevel) {
+  PathPlanner planner(config_);
+  planner.SetStart(Point2i(0, 0));
+  planner.SetGoal(Point2i(kDefaultWidth - 1, kDefaultHeight - 1));
+  std::vector<Point2i> path;
+  ASSERT_TRUE(planner.ComputePath(&path));
+  EXPECT_EQ(kDefaultWidth + kDefaultHeight - 2, planner.Distance());
+  EXPECT_EQ(planner.Distance(), path.size());
+  ExpectValidPath(Point2i(0, 0), planner.goal(), path);
+}
+
+TEST_F(PathPlannerTest, TestBlockedAndUnblocked) {
+  PathPlanner planner(config_);
+  planner.SetStart(Point2i(0, 0));
+  planner.SetGoal(Point2i(4, 0));
+  std::vector<Point2i> path;
+  ASSERT_TRUE(planner.ComputePath(&path));
+  EXPECT_EQ(4, planner.Distance());
+
+  // A bomb in the way means going around the wall.
+  SetBlocked(&planner, Point2i(2, 0), true);
+  ASSERT_TRUE(planner.ComputePath(&path));
+  EXPECT_EQ(8, planner.Distance());
+  ExpectValidPath(Point2i(0, 0), Point2i(4, 0), path);
+
+  // Walled in.
+  SetBlocked(&planner, Point2i(0, 1), true);
+  EXPECT_FALSE(planner.ComputePath(&path));
+  EXPECT_EQ(PathPlanner::kInfinity, planner.Distance());
+
+  SetBlocked(&planner, Point2i(2, 0), false);
+  ASSERT_TRUE(planner.ComputePath(&path));
+  EXPECT_EQ(4, planner.Distance());
+}
+
+TEST_F(PathPlannerTest, TestBlockedGoal) {
+  PathPlanner planner(config_);
+  planner.SetStart(Point2i(0, 0));
+  planner.SetGoal(Point2i(4, 0));
+  SetBlocked(&planner, Point2i(4, 0), true);
+  std::vector<Point2i> path;
+  EXPECT_FALSE(planner.ComputePath(&path));
+}
+
+TEST_F(PathPlannerTest, TestMatchesBfs) {
+  // Random changes and moves, compared against a BFS from scratch.
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> random_x(0, kDefaultWidth - 1);
+  std::uniform_int_distribution<int> random_y(0, kDefaultHeight - 1);
+  auto random_free = [&]() {
+    while (true) {
+      const Point2i pt(random_x(rng), random_y(rng));
+      if (IsFree(pt))
+        return pt;
+    }
+  };
+  for (int i = 0; i < 60; ++i) {
+    const Point2i pt(random_x(rng), random_y(rng));
+    if (!Game::IsStaticBrick(config_, pt.x, pt.y))
+      blocked_[pt.y * kDefaultWidth + pt.x] = true;
+  }
+
+  PathPlanner planner(config_);
+  for (int i = 0; i < kDefaultWidth * kDefaultHeight; ++i) {
+    const Point2i pt(i % kDefaultWidth, i / kDefaultWidth);
+    planner.SetBlocked(pt, blocked_[i]);
+  }
+  Point2i start = random_free();
+  planner.SetStart(start);
+  planner.SetGoal(random_free());
+  int64_t expansions_from_scratch = 0;
+  for (int step = 0; step < 500; ++step) {
+    if (step % 100 == 0) {
+      planner.SetGoal(random_free());
+    }
+    const int change = rng() % 3;
+    if (change == 0) {
+      const Point2i pt(random_x(rng), random_y(rng));
+      if (!Game::IsStaticBrick(config_, pt.x, pt.y) && !(pt == start)) {
+        SetBlocked(&planner, pt, !blocked_[pt.y * kDefaultWidth + pt.x]);
+      }
+    } else if (change == 1) {
+      // Take a step along the current path.
+      std::vector<Point2i> path;
+      if (planner.ComputePath(&path)) {
+        start = path[0];
+        planner.SetStart(start);
+      }
+    }
+
+    const int64_t before = planner.num_expansions();
+    std::vector<Point2i> path;
+    const int expected = BfsDistance(start, planner.goal());
+    ASSERT_EQ(expected >= 0, planner.ComputePath(&path)) << step;
+    if (expected >= 0) {
+      EXPECT_EQ(expected, planner.Distance()) << step;
+      EXPECT_EQ(expected, path.size()) << step;
+      if (expected > 0) {
+        ExpectValidPath(start, planner.goal(), path);
+      }
+    }
+    if (step % 100 == 0) {
+      expansions_from_scratch += planner.num_expansions() - before;
+    }
+  }
+  // Repairs are much cheaper than the searches from scratch.
+  EXPECT_LT(planner.num_expansions(), 50 * expansions_from_scratch);
+}
+
+int main() { return RUN_ALL_TESTS(); }
@@ -0,0 +1,236 @@
+#include "pixel_renderer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "constants.h"
+#include "game.h"
+
+namespace bman {
+
+namespace {
+
+int ReadInt(const std::vector<uint8_t>& data, int offset, int bytes) {
+  uint32_t value = 0;
+  for (int i = bytes - 1; i >= 0; --i) {
+    value = (value << 8) | data[offset + i];
+  }
+  return bytes == 4 ? static_cast<int32_t>(value) : static_cast<int>(value);
+}
+
+} // namespace
+
+bool LoadBmp(const std::string& path, Image* image) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+  if (data.size() < 54 || data[0] != 'B' || data[1] != 'M') {
+    return false;
+  }
+  const int offset = ReadInt(data, 10, 4);
+  const int width = ReadInt(data, 18, 4);
+  const int height = ReadInt(data, 22, 4);
+  const int bits_per_pixel = ReadInt(data, 28, 2);
+  const int compression = ReadInt(data, 30, 4);
+  if (bits_per_pixel != 24 || compression != 0 || width <= 0 || height == 0) {
+    return false;
+  }
+  // Rows are padded to 4 bytes, and bottom up unless the height is negative.
+  const int rows = std::abs(height);
+  const int stride = (width * 3 + 3) & ~3;
+  if ((int)data.size() < offset + stride * rows) {
+    return false;
+  }
+  image->width = width;
+  image->height = rows;
+  image->rgb.resize(width * rows * 3);
+  for (int y = 0; y < rows; ++y) {
+    const int row = height > 0 ? rows - 1 - y : y;
+    const uint8_t* src = &data[offset + stride * row];
+    uint8_t* dest = &image->rgb[y * width * 3];
+    for (int x = 0; x < width; ++x) {
+      dest[3 * x] = src[3 * x + 2];
+      dest[3 * x + 1] = src[3 * x + 1];
+      dest[3 * x + 2] = src[3 * x];
+    }
+  }
+  return true;
+}
+
+PixelRenderer::PixelRenderer(const bman::GameConfig& config,
+                             const Options& options)
+    : config_(config), options_(options) {}
+
+bool PixelRenderer::Load() {
+  const std::string& dir = options_.data_dir;
+  if (!LoadBmp(dir + "/background.bmp", &background_) ||
+      !LoadBmp(dir + "/bomb.bmp", &bomb_) ||
+      !LoadBmp(dir + "/explosion.bmp", &explosion_) ||
+      !LoadBmp(dir + "/man.bmp", &player_) ||
+      !LoadBmp(dir + "/powerup.bmp", &powerup_)) {
+    return false;
+  }
+  board_.assign(size(), 0);
+  for (int y = 0; y < config_.level_height(); ++y) {
+    for (int x = 0; x < config_.level_width(); ++x) {
+      Blit(background_,
+           kOffsetX + 64 * Game::IsStaticBrick(config_, x, y), kOffsetY,
+           kGridSize, kGridSize, x * kGridSize, y * kGridSize, kGridSize,
+           kGridSize, false, board_.data());
+    }
+  }
+  return true;
+}
+
+int PixelRenderer::Scale(int x) const {
+  // Rounding down, for sprites hanging over the top or left.
+  const int scaled = x * options_.cell_size;
+  return scaled >= 0 ? scaled / kGridSize
+                     : -((-scaled + kGridSize - 1) / kGridSize);
+}
+
+void PixelRenderer::Blit(const Image& sheet, int src_x, int src_y,
+                         int src_width, int src_height, int dest_x,
+                         int dest_y, int dest_width, int dest_height,
+                         bool color_key, uint8_t* rgb) const {
+  const int left = Scale(dest_x), right = Scale(dest_x + dest_width);
+  const int top = Scale(dest_y), bottom = Scale(dest_y + dest_height);
+  if (right <= left || bottom <= top) {
+    return;
+  }
+  const int w = width();
+  for (int y = std::max(0, top); y < std::min(bottom, height()); ++y) {
+    const int sy = src_y + (y - top) * src_height / (bottom - top);
+    if (sy < 0 || sy >= sheet.height)
+      continue;
+    const uint8_t* src_row = &sheet.rgb[sy * sheet.width * 3];
+    uint8_t* dest_row = rgb + y * w * 3;
+    for (int x = std::max(0, left); x < std::min(right, w); ++x) {
+      const int sx = src_x + (x - left) * src_width / (right - left);
+      if (sx < 0 || sx >= sheet.width)
+        continue;
+      const uint8_t* pixel = src_row + sx * 3;
+      if (color_key && !pixel[0] && !pixel[1] && !pixel[2])
+        continue;
+      std::memcpy(dest_row + x * 3, pixel, 3);
+    }
+  }
+}
+
+void PixelRenderer::Draw(const bman::GameState& game_state,
+                         uint8_t* rgb) const {
+  std::copy(board_.begin(), board_.end(), rgb);
+  const auto& level = game_state.level();
+  for (const auto& brick : level.bricks()) {
+    DrawBrick(brick, rgb);
+  }
+  for (const auto& bomb : level.bombs()) {
+    DrawBomb(bomb, rgb);
+  }
+  for (const auto& explosion : level.explosions()) {
+    DrawExplosion(explosion, rgb);
+  }
+  for (const auto& player : game_state.players()) {
+    DrawPlayer(player, rgb);
+  }
+}
+
+void PixelRenderer::DrawBrick(const bman::LevelState::Brick& brick,
+                              uint8_t* rgb) const {
+  const int x = brick.x() * kGridSize, y = brick.y() * kGridSize;
+  if (brick.solid()) {
+    Blit(background_, kOffsetX + 96, kGridSize, kGridSize, kGridSize, x, y,
+         kGridSize, kGridSize, false, rgb);
+  } else if (brick.powerup() != bman::PUP_NONE) {
+    const int y_index = 2 * static_cast<int>(brick.powerup() - 1);
+    Blit(powerup_, 0, y_index * kGridSize, kGridSize, kGridSize, x, y,
+         kGridSize, kGridSize, false, rgb);
+  }
+}
+
+void PixelRenderer::DrawBomb(const bman::LevelState::Bomb& bomb,
+                             uint8_t* rgb) const {
+  const int x = bomb.has_moving_x()
+                    ? bomb.moving_x() * kGridSize / kSubpixelSize -
+                          kGridSize / 2
+                    : bomb.x() * kGridSize;
+  const int y = bomb.has_moving_y()
+                    ? bomb.moving_y() * kGridSize / kSubpixelSize -
+                          kGridSize / 2
+                    : bomb.y() * kGridSize;
+  Blit(bomb_, kGridSize * ((bomb.timer() / 16) % 4), 0, kGridSize, kGridSize,
+       x, y, kGridSize, kGridSize, true, rgb);
+}
+
+void PixelRenderer::DrawExplosion(
+    const bman::LevelState::Explosion& explosion, uint8_t* rgb) const {
+  auto has_point = [&](int x, int y) -> int {
+    for (const auto& p : explosion.points()) {
+      if (p.x() == x && p.y() == y)
+        return 1;
+    }
+    return 0;
+  };
+  // Animate the explosion width using the timer
+  int y_offset = (8 * (kExplosionTimer - explosion.timer())) / kExplosionTimer;
+  if (y_offset >= 4) {
+    y_offset = 7 - y_offset;
+  }
+  // The sprite for the directions the flame carries on in.
+  static const int mapping[16] = {
+      2, 3, 0, 1, // none, left, right, left+right
+      4, 2, 2, 2, // up, up+left, up+right, up+left+right
+      5, 2, 2, 2, // down, down+left, down+right, down+left+right
+      6, 2, 2, 2, // up+down, up+down+left, ...
+  };
+  for (const auto& p : explosion.points()) {
+    const int index = has_point(p.x() - 1, p.y()) |
+                      (has_point(p.x() + 1, p.y()) << 1) |
+                      (has_point(p.x(), p.y() - 1) << 2) |
+                      (has_point(p.x(), p.y() + 1) << 3);
+    const int x_offset = p.bomb_center() ? 2 : mapping[index];
+    Blit(explosion_, x_offset * kGridSize, y_offset * kGridSize, kGridSize,
+         kGridSize, p.x() * kGridSize, p.y() * kGridSize, kGridSize,
+         kGridSize, true, rgb);
+  }
+}
+
+void PixelRenderer::DrawPlayer(const bman::PlayerState& player,
+                               uint8_t* rgb) const {
+  // As PlayerTexture::Draw.
+  int x_offset = (player.anim_counter() / 8) % 4;
+  int y_offset = 0;
+  int size_increase_x = 0;
+  int size_increase_y = 0;
+  if (player.state() == bman::PlayerState::STATE_DYING) {
+    x_offset = (player.anim_counter() / 8) % 3;
+    y_offset = (player.anim_counter() / 8) / 3 + 4;
+    size_increase_x = player.anim_counter() / 4;
+    size_increase_y = player.anim_counter() / 4;
+  } else if (player.state() == bman::PlayerState::STATE_SPAWNING) {
+    size_increase_x = -(16 - 16 * player.anim_counter() / kDyingTimer);
+    size_increase_y = (128 - 128 * player.anim_counter() / kDyingTimer);
+  } else {
+    y_offset = static_cast<int>(player.dir());
+    if (x_offset == 2 || x_offset == 0)
+      x_offset = 0;
+    else if (x_offset == 3)
+      x_offset--;
+  }
+  Blit(player_, kGridSize * x_offset, 2 * kGridSize * y_offset, kGridSize,
+       2 * kGridSize,
+       player.x() * kGridSize / kSubpixelSize - kGridSize / 2 -
+           size_increase_x,
+       player.y() * kGridSize / kSubpixelSize - kGridSize / 2 - kGridSize -
+           size_increase_y * 2,
+       kGridSize + size_increase_x * 2, kGridSize * 2 + size_increase_y * 4,
+       true, rgb);
+}
+
+} // namespace bman
@@ -0,0 +1,79 @@
+#ifndef BMAN_PIXEL_RENDERER_H
+#define BMAN_PIXEL_RENDERER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "level.grpc.pb.h"
+
+namespace bman {
+
+// An RGB image, 3 bytes a pixel, rows from the top.
+struct Image {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> rgb;
+};
+
+// Reads an uncompressed 24-bit BMP (as are the ones in data/).
+bool LoadBmp(const std::string& path, Image* image);
+
+// Draws game states from GameRenderer's sprites, without SDL: straight into
+// an RGB buffer, with no window or event loop, so that pixel observations
+// can be made on headless machines. Only the board is drawn (not the
+// scores), cell_size pixels to a cell, sprites scaled by nearest neighbour
+// and clipped to the board.
+class PixelRenderer {
+public:
+  struct Options {
+    int cell_size = 8;
+    // Where the sprites are.
+    std::string data_dir = "data";
+  };
+
+  explicit PixelRenderer(const bman::GameConfig& config)
+      : PixelRenderer(config, Options()) {}
+  PixelRenderer(const bman::GameConfig& config, const Options& options);
+
+  // Loads the sprites, returns false if one is missing.
+  bool Load();
+
+  int width() const { return config_.level_width() * options_.cell_size; }
+  int height() const { return config_.level_height() * options_.cell_size; }
+  // Of an image, in bytes.
+  int size() const { return width() * height() * 3; }
+
+  // Fills size() bytes of rgb, height() rows of width() pixels.
+  void Draw(const bman::GameState& game_state, uint8_t* rgb) const;
+
+private:
+  // Draws the sheet's src_* rectangle (in sprite pixels) over the dest_*
+  // one (in board pixels at kGridSize to a cell), skipping black pixels if
+  // color_key.
+  void Blit(const Image& sheet, int src_x, int src_y, int src_width,
+            int src_height, int dest_x, int dest_y, int dest_width,
+            int dest_height, bool color_key, uint8_t* rgb) const;
+  // From board pixels at kGridSize to a cell to ours.
+  int Scale(int x) const;
+
+  void DrawBrick(const bman::LevelState::Brick& brick, uint8_t* rgb) const;
+  void DrawBomb(const bman::LevelState::Bomb& bomb, uint8_t* rgb) const;
+  void DrawExplosion(const bman::LevelState::Explosion& explosion,
+                     uint8_t* rgb) const;
+  void DrawPlayer(const bman::PlayerState& player, uint8_t* rgb) const;
+
+  bman::GameConfig config_;
+  Options options_;
+  Image background_;
+  Image bomb_;
+  Image explosion_;
+  Image player_;
+  Image powerup_;
+  // The floor and walls, which never change.
+  std::vector<uint8_t> board_;
+};
+
+} // namespace bman
+
+#endif
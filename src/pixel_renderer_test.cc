@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <vector>
+
+#include "constants.h"
+#include "game.h"
+#include "pixel_renderer.h"
+
+namespace {
+
+// The RGB of pixel (x, y) of an image width pixels wide.
+std::vector<int> Pixel(const uint8_t* rgb, int width, int x, int y) {
+  const uint8_t* pixel = rgb + (y * width + x) * 3;
+  return {pixel[0], pixel[1], pixel[2]};
+}
+
+} // namespace
+
+TEST(LoadBmpTest, TestReadsRowsBottomUp) {
+  // 2 x 2, BGR with rows padded to 8 bytes, the bottom row first.
+  const uint8_t header[54] = {
+      'B', 'M', 70, 0, 0, 0, 0, 0, 0, 0, 54, 0, 0, 0, 40, 0, 0, 0, 2, 0,
+      0,   0,   2,  0, 0, 0, 1, 0, 24, 0, 0, 0, 0, 0, 16, 0, 0, 0};
+  const uint8_t pixels[16] = {1, 2, 3, 4, 5, 6, 0, 0,
+                              7, 8, 9, 10, 11, 12, 0, 0};
+  const std::string path = testing::TempDir() + "/test.bmp";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(pixels), sizeof(pixels));
+  }
+  bman::Image image;
+  ASSERT_TRUE(bman::LoadBmp(path, &image));
+  EXPECT_EQ(2, image.width);
+  EXPECT_EQ(2, image.height);
+  EXPECT_EQ(std::vector<uint8_t>({9, 8, 7, 12, 11, 10, 3, 2, 1, 6, 5, 4}),
+            image.rgb);
+  EXPECT_FALSE(bman::LoadBmp(path + ".missing", &image));
+}
+
+class PixelRendererTest : public testing::Test {
+public:
+  void SetUp() override {
+    game_.BuildSimpleLevel(2);
+    game_.AddPlayer();
+    // The board without bricks or players.
+    empty_state_ = game_.game_state();
+    empty_state_.mutable_level()->clear_bricks();
+    empty_state_.clear_players();
+  }
+
+  Game game_;
+  bman::GameState empty_state_;
+};
+
+TEST_F(PixelRendererTest, TestDrawsBackgroundTiles) {
+  bman::PixelRenderer::Options options;
+  options.cell_size = kGridSize;
+  bman::PixelRenderer renderer(game_.config(), options);
+  ASSERT_TRUE(renderer.Load());
+  EXPECT_EQ(kDefaultWidth * kGridSize, renderer.width());
+  EXPECT_EQ(kDefaultHeight * kGridSize, renderer.height());
+  std::vector<uint8_t> rgb(renderer.size());
+  renderer.Draw(empty_state_, rgb.data());
+
+  // At full size, the cells are GameRenderer's tiles pixel for pixel.
+  bman::Image background;
+  ASSERT_TRUE(bman::LoadBmp("data/background.bmp", &background));
+  for (int y = 0; y < kGridSize; ++y) {
+    for (int x = 0; x < kGridSize; ++x) {
+      // The floor at (0, 0), a wall at (1, 1).
+      EXPECT_EQ(Pixel(background.rgb.data(), background.width, kOffsetX + x,
+                      kOffsetY + y),
+                Pixel(rgb.data(), renderer.width(), x, y));
+      EXPECT_EQ(Pixel(background.rgb.data(), background.width,
+                      kOffsetX + 64 + x, kOffsetY + y),
+                Pixel(rgb.data(), renderer.width(), kGridSize + x,
+                      kGridSize + y));
+    }
+  }
+}
+
+TEST_F(PixelRendererTest, TestDrawsInCells) {
+  bman::PixelRenderer renderer(game_.config());
+  ASSERT_TRUE(renderer.Load());
+  const int cell = 8;
+  ASSERT_EQ(kDefaultWidth * cell, renderer.width());
+  std::vector<uint8_t> empty(renderer.size()), rgb(renderer.size());
+  renderer.Draw(empty_state_, empty.data());
+
+  // A bomb only changes its own cell.
+  bman::GameState state = empty_state_;
+  auto* bomb = state.mutable_level()->add_bombs();
+  bomb->set_x(4);
+  bomb->set_y(2);
+  bomb->set_timer(kDefaultBombTimer);
+  renderer.Draw(state, rgb.data());
+  int num_changed = 0;
+  for (int y = 0; y < renderer.height(); ++y) {
+    for (int x = 0; x < renderer.width(); ++x) {
+      if (Pixel(rgb.data(), renderer.width(), x, y) !=
+          Pixel(empty.data(), renderer.width(), x, y)) {
+        num_changed++;
+        EXPECT_EQ(4, x / cell);
+        EXPECT_EQ(2, y / cell);
+      }
+    }
+  }
+  EXPECT_GT(num_changed, 0);
+
+  // The player in the corner is drawn (and clipped above the board).
+  renderer.Draw(game_.game_state(), rgb.data());
+  std::vector<uint8_t> with_bricks(renderer.size());
+  bman::GameState no_players = game_.game_state();
+  no_players.clear_players();
+  renderer.Draw(no_players, with_bricks.data());
+  EXPECT_NE(Pixel(rgb.data(), renderer.width(), cell / 2, cell / 2),
+            Pixel(with_bricks.data(), renderer.width(), cell / 2, cell / 2));
+}
+
+int main() { return RUN_ALL_TESTS(); }
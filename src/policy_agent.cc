@@ -0,0 +1,166 @@
+#include "policy_agent.h"
+
+#include <unordered_map>
+
+#include "glog/logging.h"
+
+PolicyAgent::PolicyAgent(const bman::GameConfig& config, int player_index,
+                         std::shared_ptr<const bman::PolicyModel> model)
+    : player_index_(player_index), model_(model),
+      observation_(config, model->expand) {
+  CHECK_EQ(observation_.size() * model_->frame_stack, model_->num_inputs())
+      << "Policy was trained on a different level size";
+}
+
+bman::MovePlayerRequest
+PolicyAgent::GetPlayerAction(const bman::GameState& game_state) {
+  bman::MovePlayerRequest move;
+  if (!NeedsAction(game_state, &move)) {
+    return move;
+  }
+  std::vector<float> input(model_->num_inputs());
+  BuildInput(game_state, nullptr, input.data());
+  std::vector<int> actions;
+  model_->Predict(input.data(), 1, &actions);
+  return StartAction(actions[0]);
+}
+
+std::vector<bman::MovePlayerRequest>
+PolicyAgent::GetPlayerActions(const std::vector<PolicyAgent*>& agents,
+                              const bman::GameState& game_state) {
+  return GetPlayerActions(
+      agents, std::vector<const bman::GameState*>(agents.size(), &game_state));
+}
+
+std::vector<bman::MovePlayerRequest> PolicyAgent::GetPlayerActions(
+    const std::vector<PolicyAgent*>& agents,
+    const std::vector<const bman::GameState*>& game_states) {
+  CHECK_EQ(agents.size(), game_states.size());
+  std::vector<bman::MovePlayerRequest> moves(agents.size());
+  std::vector<int> deciding;
+  for (size_t i = 0; i < agents.size(); ++i) {
+    if (agents[i]->NeedsAction(*game_states[i], &moves[i])) {
+      deciding.push_back(i);
+    }
+  }
+  if (deciding.empty()) {
+    return moves;
+  }
+  const bman::PolicyModel& model = *agents[deciding[0]]->model_;
+  const int num_inputs = model.num_inputs();
+  std::vector<float> inputs(deciding.size() * num_inputs);
+  std::unordered_map<const bman::GameState*, std::vector<float>> grids;
+  for (size_t j = 0; j < deciding.size(); ++j) {
+    PolicyAgent* agent = agents[deciding[j]];
+    CHECK(agent->model_.get() == &model) << "Batched agents share a model";
+    const bman::GameState* game_state = game_states[deciding[j]];
+    std::vector<float>& grid = grids[game_state];
+    if (grid.empty()) {
+      grid.resize(agent->observation_.size());
+      agent->observation_.BuildGrid(*game_state, grid.data());
+    }
+    agent->BuildInput(*game_state, grid.data(), &inputs[j * num_inputs]);
+  }
+  std::vector<int> actions;
+  model.Predict(inputs.data(), deciding.size(), &actions);
+  for (size_t j = 0; j < deciding.size(); ++j) {
+    moves[deciding[j]] = agents[deciding[j]]->StartAction(actions[j]);
+  }
+  return moves;
+}
+
+bool PolicyAgent::NeedsAction(const bman::GameState& game_state,
+                              bman::MovePlayerRequest* move) {
+  move->Clear();
+  move->add_actions();
+  if (player_index_ >= game_state.players_size()) {
+    return false;
+  }
+  const auto& player = game_state.players(player_index_);
+  if (player.state() == bman::PlayerState::STATE_DYING ||
+      player.state() == bman::PlayerState::STATE_SPAWNING) {
+    // Dying ends a training episode, start again with empty frames.
+    frames_.clear();
+    ticks_left_ = 0;
+    return false;
+  }
+  if (ticks_left_ <= 0) {
+    return true;
+  }
+  *move = HeldMove(/*first_tick=*/false);
+  return false;
+}
+
+bman::MovePlayerRequest PolicyAgent::HeldMove(bool first_tick) {
+  ticks_left_--;
+  bman::MovePlayerRequest move;
+  auto* action = move.add_actions();
+  if (action_ < 4) {
+    int dx = 0, dy = 0;
+    Agent::GetDeltaFromDir(action_, &dx, &dy);
+    action->set_dir(static_cast<bman::Direction>(action_));
+    action->set_dx(dx);
+    action->set_dy(dy);
+  } else if (action_ == 4) {
+    action->set_place_bomb(first_tick);
+  } else {
+    action->set_use_powerup(true);
+  }
+  return move;
+}
+
+void PolicyAgent::BuildInput(const bman::GameState& game_state,
+                             const float* grid, float* input) {
+  const int stack = model_->frame_stack;
+  while ((int)frames_.size() < stack) {
+    frames_.emplace_front(observation_.size(), 0.0f);
+  }
+  std::vector<float> frame = std::move(frames_.front());
+  frames_.pop_front();
+  if (grid) {
+    std::copy(grid, grid + observation_.size(), frame.data());
+    observation_.MarkPlayer(game_state, player_index_, frame.data());
+  } else {
+    observation_.Build(game_state, player_index_, frame.data());
+  }
+  frames_.push_back(std::move(frame));
+
+  // VecFrameStack concatenates the frames along the last axis, so each row
+  // holds that row of every frame.
+  const int width = observation_.width();
+  for (int y = 0; y < observation_.height(); ++y) {
+    for (int s = 0; s < stack; ++s) {
+      std::copy(&frames_[s][y * width], &frames_[s][y * width] + width,
+                input + (y * stack + s) * width);
+    }
+  }
+}
+
+bman::MovePlayerRequest PolicyAgent::StartAction(int action) {
+  action_ = action;
+  ticks_left_ = model_->frame_skip;
+  return HeldMove(/*first_tick=*/true);
+}
+
+std::vector<bman::MovePlayerRequest> PolicyAgentBatch::GetPlayerActions(
+    const std::vector<const bman::GameState*>& game_states,
+    const std::vector<Player>& players) {
+  std::vector<PolicyAgent*> agents;
+  std::vector<const bman::GameState*> states;
+  for (const Player& player : players) {
+    CHECK_LT(player.game, (int)game_states.size());
+    std::unique_ptr<PolicyAgent>& agent =
+        agents_[{player.game, player.player_index}];
+    if (!agent) {
+      agent.reset(new PolicyAgent(config_, player.player_index, model_));
+    }
+    agents.push_back(agent.get());
+    states.push_back(game_states[player.game]);
+  }
+  return PolicyAgent::GetPlayerActions(agents, states);
+}
+
+void PolicyAgentBatch::ResetGame(int game) {
+  agents_.erase(agents_.lower_bound({game, 0}),
+                agents_.lower_bound({game + 1, 0}));
+}
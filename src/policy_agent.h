@@ -0,0 +1,84 @@
+#ifndef BMAN_POLICY_AGENT_H
+#define BMAN_POLICY_AGENT_H
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "agent.h"
+#include "agent_batch.h"
+#include "level.grpc.pb.h"
+#include "observation.h"
+#include "policy_model.h"
+
+// Plays a policy trained by python/train_grid.py, without Python. Mirrors
+// bman_env.py: every frame_skip ticks it builds the grid observation, stacks
+// it with the previous ones (as VecFrameStack does) and takes the action
+// with the highest output, which is then held for frame_skip ticks (placing
+// a bomb only on the first). Actions are the directions, then place bomb,
+// then use power-up.
+class PolicyAgent : public Agent {
+public:
+  PolicyAgent(const bman::GameConfig& config, int player_index,
+              std::shared_ptr<const bman::PolicyModel> model);
+
+  bman::MovePlayerRequest
+  GetPlayerAction(const bman::GameState& game_state) override;
+
+  // Same as calling GetPlayerAction on each of the agents, but the agents
+  // that need a decision share one batched pass through the model (so they
+  // must share the model).
+  static std::vector<bman::MovePlayerRequest>
+  GetPlayerActions(const std::vector<PolicyAgent*>& agents,
+                   const bman::GameState& game_state);
+  // The same for agents in different games, agents[i] deciding on
+  // *game_states[i]. The observation grid of each state is built once.
+  static std::vector<bman::MovePlayerRequest>
+  GetPlayerActions(const std::vector<PolicyAgent*>& agents,
+                   const std::vector<const bman::GameState*>& game_states);
+
+private:
+  // Returns true if there's no action being held and a new one is needed,
+  // fills move otherwise.
+  bool NeedsAction(const bman::GameState& game_state,
+                   bman::MovePlayerRequest* move);
+  // Pushes the current observation and copies the stacked frames into input
+  // (model_->num_inputs() values). The observation is built from grid (from
+  // GridObservation::BuildGrid) if it's given.
+  void BuildInput(const bman::GameState& game_state, const float* grid,
+                  float* input);
+  // Starts holding the action and returns its first tick.
+  bman::MovePlayerRequest StartAction(int action);
+  // Next tick of the action being held.
+  bman::MovePlayerRequest HeldMove(bool first_tick);
+
+  const int player_index_;
+  std::shared_ptr<const bman::PolicyModel> model_;
+  bman::GridObservation observation_;
+  // Oldest first.
+  std::deque<std::vector<float>> frames_;
+  int action_ = 0;
+  int ticks_left_ = 0;
+};
+
+// PolicyAgents sharing a model, all the players that need a decision going
+// through it in one batch.
+class PolicyAgentBatch : public AgentBatch {
+public:
+  PolicyAgentBatch(const bman::GameConfig& config,
+                   std::shared_ptr<const bman::PolicyModel> model)
+      : config_(config), model_(model) {}
+
+  std::vector<bman::MovePlayerRequest>
+  GetPlayerActions(const std::vector<const bman::GameState*>& game_states,
+                   const std::vector<Player>& players) override;
+  void ResetGame(int game) override;
+
+private:
+  const bman::GameConfig config_;
+  std::shared_ptr<const bman::PolicyModel> model_;
+  std::map<std::pair<int, int>, std::unique_ptr<PolicyAgent>> agents_;
+};
+
+#endif
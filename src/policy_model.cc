@@ -0,0 +1,259 @@
+#include "policy_model.h"
+
+#if defined(__AVX__) || defined(__SSE__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "glog/logging.h"
+
+namespace bman {
+
+namespace {
+
+const char kMagic[4] = {'B', 'M', 'N', 'N'};
+const int32_t kVersion = 1;
+const int kMaxLayers = 64;
+
+class Reader {
+public:
+  explicit Reader(const std::string& data) : data_(data) {}
+
+  template <typename T> bool Read(T* values, size_t count = 1) {
+    const size_t size = sizeof(T) * count;
+    if (pos_ + size > data_.size())
+      return false;
+    memcpy(values, data_.data() + pos_, size);
+    pos_ += size;
+    return true;
+  }
+  bool done() const { return pos_ == data_.size(); }
+  // Bytes left to read.
+  size_t remaining() const { return data_.size() - pos_; }
+
+private:
+  const std::string& data_;
+  size_t pos_ = 0;
+};
+
+template <typename T>
+void Write(std::string* data, const T* values, size_t count = 1) {
+  data->append(reinterpret_cast<const char*>(values), sizeof(T) * count);
+}
+
+} // namespace
+
+bool PolicyModel::Load(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    LOG(ERROR) << "Unable to open " << path;
+    return false;
+  }
+  std::stringstream data;
+  data << file.rdbuf();
+  return Parse(data.str());
+}
+
+bool PolicyModel::Parse(const std::string& data) {
+  Reader reader(data);
+  char magic[4];
+  int32_t header[5];
+  if (!reader.Read(magic, 4) || memcmp(magic, kMagic, 4) != 0 ||
+      !reader.Read(header, 5) || header[0] != kVersion) {
+    LOG(ERROR) << "Not a version " << kVersion << " policy";
+    return false;
+  }
+  if (header[1] <= 0 || header[2] <= 0 || header[3] <= 0 || header[4] <= 0 ||
+      header[4] > kMaxLayers) {
+    LOG(ERROR) << "Bad policy header";
+    return false;
+  }
+  expand = header[1];
+  frame_stack = header[2];
+  frame_skip = header[3];
+  layers.assign(header[4], Layer());
+  for (size_t i = 0; i < layers.size(); ++i) {
+    Layer& layer = layers[i];
+    int32_t shape[3];
+    if (!reader.Read(shape, 3) || shape[0] <= 0 || shape[1] <= 0 ||
+        shape[2] < ACTIVATION_NONE || shape[2] > ACTIVATION_TANH ||
+        (i > 0 && shape[0] != layers[i - 1].outputs)) {
+      LOG(ERROR) << "Bad shape for layer " << i;
+      return false;
+    }
+    layer.inputs = shape[0];
+    layer.outputs = shape[1];
+    layer.activation = static_cast<Activation>(shape[2]);
+    // Checked before allocating, as the shape may claim any size.
+    const uint64_t num_weights = uint64_t(layer.inputs) * layer.outputs;
+    if ((num_weights + layer.outputs) * sizeof(float) > reader.remaining()) {
+      LOG(ERROR) << "Truncated weights for layer " << i;
+      return false;
+    }
+    layer.weights.resize(num_weights);
+    layer.bias.resize(layer.outputs);
+    if (!reader.Read(layer.weights.data(), layer.weights.size()) ||
+        !reader.Read(layer.bias.data(), layer.bias.size())) {
+      LOG(ERROR) << "Truncated weights for layer " << i;
+      return false;
+    }
+  }
+  if (!reader.done()) {
+    LOG(ERROR) << "Trailing data after the last layer";
+    return false;
+  }
+  return true;
+}
+
+std::string PolicyModel::Serialize() const {
+  std::string data;
+  Write(&data, kMagic, 4);
+  const int32_t header[5] = {kVersion, expand, frame_stack, frame_skip,
+                             static_cast<int32_t>(layers.size())};
+  Write(&data, header, 5);
+  for (const auto& layer : layers) {
+    const int32_t shape[3] = {layer.inputs, layer.outputs, layer.activation};
+    Write(&data, shape, 3);
+    Write(&data, layer.weights.data(), layer.weights.size());
+    Write(&data, layer.bias.data(), layer.bias.size());
+  }
+  return data;
+}
+
+namespace {
+
+#if defined(__AVX__)
+typedef __m256 Lanes;
+const int kLanes = 8;
+inline Lanes ZeroLanes() { return _mm256_setzero_ps(); }
+inline Lanes LoadLanes(const float* values) { return _mm256_loadu_ps(values); }
+inline Lanes MulAdd(Lanes a, Lanes b, Lanes sum) {
+#if defined(__FMA__)
+  return _mm256_fmadd_ps(a, b, sum);
+#else
+  return _mm256_add_ps(sum, _mm256_mul_ps(a, b));
+#endif
+}
+inline float SumLanes(Lanes lanes) {
+  __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(lanes),
+                           _mm256_extractf128_ps(lanes, 1));
+  float sums[4];
+  _mm_storeu_ps(sums, sum4);
+  return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+#elif defined(__SSE__)
+typedef __m128 Lanes;
+const int kLanes = 4;
+inline Lanes ZeroLanes() { return _mm_setzero_ps(); }
+inline Lanes LoadLanes(const float* values) { return _mm_loadu_ps(values); }
+inline Lanes MulAdd(Lanes a, Lanes b, Lanes sum) {
+  return _mm_add_ps(sum, _mm_mul_ps(a, b));
+}
+inline float SumLanes(Lanes lanes) {
+  float sums[4];
+  _mm_storeu_ps(sums, lanes);
+  return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+#else
+typedef float Lanes;
+const int kLanes = 1;
+inline Lanes ZeroLanes() { return 0; }
+inline Lanes LoadLanes(const float* values) { return *values; }
+inline Lanes MulAdd(Lanes a, Lanes b, Lanes sum) { return sum + a * b; }
+inline float SumLanes(Lanes lanes) { return lanes; }
+#endif
+
+// Dot products of four rows with the same vector, which loads the vector
+// once for all of them (the layers are bound by loads, not arithmetic).
+void Dot4(const float* rows, int n, const float* b, float* sums) {
+  const float* a[4] = {rows, rows + n, rows + 2 * n, rows + 3 * n};
+  Lanes lanes[4] = {ZeroLanes(), ZeroLanes(), ZeroLanes(), ZeroLanes()};
+  int i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    const Lanes x = LoadLanes(b + i);
+    for (int r = 0; r < 4; ++r) {
+      lanes[r] = MulAdd(LoadLanes(a[r] + i), x, lanes[r]);
+    }
+  }
+  for (int r = 0; r < 4; ++r) {
+    sums[r] = SumLanes(lanes[r]);
+    for (int j = i; j < n; ++j) {
+      sums[r] += a[r][j] * b[j];
+    }
+  }
+}
+
+} // namespace
+
+float PolicyModel::Dot(const float* a, const float* b, int n) {
+  Lanes lanes = ZeroLanes();
+  int i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    lanes = MulAdd(LoadLanes(a + i), LoadLanes(b + i), lanes);
+  }
+  float sum = SumLanes(lanes);
+  for (; i < n; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+void PolicyModel::Forward(const float* inputs, int batch_size,
+                          std::vector<float>* outputs) const {
+  std::vector<float> buffers[2];
+  const float* in = inputs;
+  for (size_t l = 0; l < layers.size(); ++l) {
+    const Layer& layer = layers[l];
+    std::vector<float>& out =
+        l + 1 == layers.size() ? *outputs : buffers[l % 2];
+    out.resize(batch_size * layer.outputs);
+    // Weights outer, so that each block of rows is read once for the whole
+    // batch.
+    int o = 0;
+    for (; o + 4 <= layer.outputs; o += 4) {
+      const float* weights = &layer.weights[o * layer.inputs];
+      for (int b = 0; b < batch_size; ++b) {
+        Dot4(weights, layer.inputs, in + b * layer.inputs,
+             &out[b * layer.outputs + o]);
+      }
+    }
+    for (; o < layer.outputs; ++o) {
+      const float* weights = &layer.weights[o * layer.inputs];
+      for (int b = 0; b < batch_size; ++b) {
+        out[b * layer.outputs + o] =
+            Dot(weights, in + b * layer.inputs, layer.inputs);
+      }
+    }
+    for (int b = 0; b < batch_size; ++b) {
+      float* values = &out[b * layer.outputs];
+      for (int o = 0; o < layer.outputs; ++o) {
+        values[o] += layer.bias[o];
+        if (layer.activation == ACTIVATION_RELU) {
+          values[o] = std::max(0.0f, values[o]);
+        } else if (layer.activation == ACTIVATION_TANH) {
+          values[o] = std::tanh(values[o]);
+        }
+      }
+    }
+    in = out.data();
+  }
+}
+
+void PolicyModel::Predict(const float* inputs, int batch_size,
+                          std::vector<int>* actions) const {
+  std::vector<float> outputs;
+  Forward(inputs, batch_size, &outputs);
+  const int num_outputs = num_actions();
+  actions->resize(batch_size);
+  for (int b = 0; b < batch_size; ++b) {
+    const float* values = &outputs[b * num_outputs];
+    (*actions)[b] = std::max_element(values, values + num_outputs) - values;
+  }
+}
+
+} // namespace bman
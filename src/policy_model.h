@@ -0,0 +1,65 @@
+#ifndef BMAN_POLICY_MODEL_H
+#define BMAN_POLICY_MODEL_H
+
+#include <string>
+#include <vector>
+
+namespace bman {
+
+// A trained MLP policy, exported from stable-baselines by
+// python/export_policy.py. The file is little-endian:
+//
+//   char[4] "BMNN", int32 version (1)
+//   int32 expand, int32 frame_stack, int32 frame_skip, int32 num_layers
+//   per layer: int32 inputs, int32 outputs, int32 activation,
+//              float32 weights[outputs][inputs], float32 bias[outputs]
+//
+// The last layer has one output per action (the exporter folds the
+// quantile mean of QR-DQN into it) and the policy picks the largest.
+// Evaluation is const, so a model can be shared between threads.
+class PolicyModel {
+public:
+  enum Activation {
+    ACTIVATION_NONE = 0,
+    ACTIVATION_RELU = 1,
+    ACTIVATION_TANH = 2,
+  };
+
+  struct Layer {
+    int inputs = 0;
+    int outputs = 0;
+    Activation activation = ACTIVATION_NONE;
+    std::vector<float> weights;
+    std::vector<float> bias;
+  };
+
+  // Observation settings the policy was trained with.
+  int expand = 3;
+  int frame_stack = 1;
+  int frame_skip = 1;
+  std::vector<Layer> layers;
+
+  bool Load(const std::string& path);
+  bool Parse(const std::string& data);
+  std::string Serialize() const;
+
+  int num_inputs() const { return layers.empty() ? 0 : layers[0].inputs; }
+  int num_actions() const {
+    return layers.empty() ? 0 : layers.back().outputs;
+  }
+
+  // Runs batch_size inputs (each num_inputs() values, one after another)
+  // through the network, filling num_actions() outputs for each.
+  void Forward(const float* inputs, int batch_size,
+               std::vector<float>* outputs) const;
+  // Index of the best action for each of the inputs.
+  void Predict(const float* inputs, int batch_size,
+               std::vector<int>* actions) const;
+
+  // Dot product of n floats, vectorized where the target supports it.
+  static float Dot(const float* a, const float* b, int n);
+};
+
+} // namespace bman
+
+#endif
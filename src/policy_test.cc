@@ -0,0 +1,252 @@
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "game.h"
+#include "policy_agent.h"
+#include "policy_model.h"
+
+namespace {
+
+bman::PolicyModel::Layer MakeLayer(int inputs, int outputs,
+                                   bman::PolicyModel::Activation activation,
+                                   std::mt19937* rng) {
+  std::uniform_real_distribution<float> random_weight(-1, 1);
+  bman::PolicyModel::Layer layer;
+  layer.inputs = inputs;
+  layer.outputs = outputs;
+  layer.activation = activation;
+  for (int i = 0; i < inputs * outputs; ++i) {
+    layer.weights.push_back(random_weight(*rng));
+  }
+  for (int i = 0; i < outputs; ++i) {
+    layer.bias.push_back(random_weight(*rng));
+  }
+  return layer;
+}
+
+// Straightforward version of PolicyModel::Forward for a single input.
+std::vector<float> NaiveForward(const bman::PolicyModel& model,
+                                std::vector<float> values) {
+  for (const auto& layer : model.layers) {
+    std::vector<float> out(layer.outputs);
+    for (int o = 0; o < layer.outputs; ++o) {
+      double sum = layer.bias[o];
+      for (int i = 0; i < layer.inputs; ++i) {
+        sum += layer.weights[o * layer.inputs + i] * values[i];
+      }
+      if (layer.activation == bman::PolicyModel::ACTIVATION_RELU) {
+        sum = std::max(0.0, sum);
+      } else if (layer.activation == bman::PolicyModel::ACTIVATION_TANH) {
+        sum = std::tanh(sum);
+      }
+      out[o] = sum;
+    }
+    values = out;
+  }
+  return values;
+}
+
+} // namespace
+
+TEST(PolicyModelTest, TestDot) {
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> random_value(-1, 1);
+  for (int n = 0; n < 40; ++n) {
+    std::vector<float> a(n), b(n);
+    double expected = 0;
+    for (int i = 0; i < n; ++i) {
+      a[i] = random_value(rng);
+      b[i] = random_value(rng);
+      expected += a[i] * b[i];
+    }
+    EXPECT_NEAR(expected, bman::PolicyModel::Dot(a.data(), b.data(), n), 1e-5)
+        << n;
+  }
+}
+
+TEST(PolicyModelTest, TestForwardBatch) {
+  std::mt19937 rng(2);
+  bman::PolicyModel model;
+  model.layers.push_back(
+      MakeLayer(37, 16, bman::PolicyModel::ACTIVATION_TANH, &rng));
+  model.layers.push_back(
+      MakeLayer(16, 9, bman::PolicyModel::ACTIVATION_RELU, &rng));
+  model.layers.push_back(
+      MakeLayer(9, 5, bman::PolicyModel::ACTIVATION_NONE, &rng));
+
+  const int batch_size = 3;
+  std::uniform_real_distribution<float> random_value(-1, 1);
+  std::vector<float> inputs(batch_size * model.num_inputs());
+  for (float& input : inputs) {
+    input = random_value(rng);
+  }
+  std::vector<float> outputs;
+  model.Forward(inputs.data(), batch_size, &outputs);
+  ASSERT_EQ(batch_size * model.num_actions(), outputs.size());
+  std::vector<int> actions;
+  model.Predict(inputs.data(), batch_size, &actions);
+  for (int b = 0; b < batch_size; ++b) {
+    const std::vector<float> expected = NaiveForward(
+        model, std::vector<float>(&inputs[b * model.num_inputs()],
+                                  &inputs[(b + 1) * model.num_inputs()]));
+    for (int a = 0; a < model.num_actions(); ++a) {
+      EXPECT_NEAR(expected[a], outputs[b * model.num_actions() + a], 1e-4);
+    }
+    EXPECT_EQ(std::max_element(expected.begin(), expected.end()) -
+                  expected.begin(),
+              actions[b]);
+  }
+}
+
+TEST(PolicyModelTest, TestSerialize) {
+  std::mt19937 rng(3);
+  bman::PolicyModel model;
+  model.frame_stack = 4;
+  model.frame_skip = 8;
+  model.layers.push_back(
+      MakeLayer(10, 4, bman::PolicyModel::ACTIVATION_RELU, &rng));
+  model.layers.push_back(
+      MakeLayer(4, 5, bman::PolicyModel::ACTIVATION_NONE, &rng));
+  const std::string data = model.Serialize();
+
+  bman::PolicyModel parsed;
+  ASSERT_TRUE(parsed.Parse(data));
+  EXPECT_EQ(4, parsed.frame_stack);
+  EXPECT_EQ(8, parsed.frame_skip);
+  ASSERT_EQ(2, parsed.layers.size());
+  EXPECT_EQ(model.layers[0].weights, parsed.layers[0].weights);
+  EXPECT_EQ(model.layers[1].bias, parsed.layers[1].bias);
+  EXPECT_EQ(bman::PolicyModel::ACTIVATION_RELU, parsed.layers[0].activation);
+
+  EXPECT_FALSE(parsed.Parse(data.substr(0, data.size() - 1)));
+  EXPECT_FALSE(parsed.Parse(data + "x"));
+  EXPECT_FALSE(parsed.Parse("BMNX" + data.substr(4)));
+  // A shape far bigger than the data (and than an int32 count of weights).
+  std::string huge = data;
+  const int32_t huge_shape[2] = {1 << 20, 1 << 20};
+  huge.replace(24, sizeof(huge_shape),
+               reinterpret_cast<const char*>(huge_shape), sizeof(huge_shape));
+  EXPECT_FALSE(parsed.Parse(huge));
+}
+
+class PolicyAgentTest : public testing::Test {
+public:
+  void SetUp() override {
+    game_.BuildSimpleLevel(2);
+    game_.AddPlayer();
+    game_.AddPlayer();
+  }
+
+  // A linear policy with zero weights (so the bias picks the action).
+  std::shared_ptr<bman::PolicyModel> MakeModel(int frame_stack,
+                                               int frame_skip) {
+    auto model = std::make_shared<bman::PolicyModel>();
+    model->frame_stack = frame_stack;
+    model->frame_skip = frame_skip;
+    bman::GridObservation observation(game_.config());
+    bman::PolicyModel::Layer layer;
+    layer.inputs = observation.size() * frame_stack;
+    layer.outputs = 5;
+    layer.weights.assign(layer.inputs * layer.outputs, 0);
+    layer.bias.assign(layer.outputs, 0);
+    model->layers.push_back(layer);
+    return model;
+  }
+
+  Game game_;
+};
+
+TEST_F(PolicyAgentTest, TestHoldsActionForFrameSkip) {
+  auto model = MakeModel(1, 8);
+  model->layers[0].bias[4] = 1; // Place bomb.
+  PolicyAgent agent(game_.config(), 0, model);
+  for (int tick = 0; tick < 16; ++tick) {
+    const auto move = agent.GetPlayerAction(game_.game_state());
+    ASSERT_EQ(1, move.actions_size());
+    EXPECT_EQ(tick % 8 == 0, move.actions(0).place_bomb()) << tick;
+    EXPECT_EQ(0, move.actions(0).dx());
+  }
+}
+
+TEST_F(PolicyAgentTest, TestStackedInputLayout) {
+  // Only looks at where the player is marked in the newest frame, which
+  // VecFrameStack puts last in each row.
+  const int stack = 3;
+  auto model = MakeModel(stack, 8);
+  bman::GridObservation observation(game_.config());
+  const auto& player = game_.game_state().players(0);
+  const int x = GridRound(player.x() * bman::GridObservation::kDefaultExpand);
+  const int y = GridRound(player.y() * bman::GridObservation::kDefaultExpand);
+  auto& layer = model->layers[0];
+  layer.weights[1 * layer.inputs +
+                (y * stack + stack - 1) * observation.width() + x] = 1;
+
+  PolicyAgent agent(game_.config(), 0, model);
+  const auto move = agent.GetPlayerAction(game_.game_state());
+  EXPECT_EQ(bman::Direction(1), move.actions(0).dir());
+  EXPECT_GT(move.actions(0).dx(), 0);
+}
+
+TEST_F(PolicyAgentTest, TestBatchedMatchesSingle) {
+  std::mt19937 rng(4);
+  auto model = MakeModel(2, 4);
+  for (float& weight : model->layers[0].weights) {
+    weight = std::uniform_real_distribution<float>(-1, 1)(rng);
+  }
+  PolicyAgent single0(game_.config(), 0, model);
+  PolicyAgent single1(game_.config(), 1, model);
+  PolicyAgent batched0(game_.config(), 0, model);
+  PolicyAgent batched1(game_.config(), 1, model);
+  for (int tick = 0; tick < 100; ++tick) {
+    std::vector<bman::MovePlayerRequest> moves = {
+        single0.GetPlayerAction(game_.game_state()),
+        single1.GetPlayerAction(game_.game_state())};
+    const auto batched = PolicyAgent::GetPlayerActions(
+        {&batched0, &batched1}, game_.game_state());
+    ASSERT_EQ(2, batched.size());
+    for (int i = 0; i < 2; ++i) {
+      EXPECT_EQ(moves[i].SerializeAsString(), batched[i].SerializeAsString());
+    }
+    game_.Step(moves);
+  }
+}
+
+TEST_F(PolicyAgentTest, TestAgentBatchAcrossGames) {
+  std::mt19937 rng(5);
+  auto model = MakeModel(2, 4);
+  for (float& weight : model->layers[0].weights) {
+    weight = std::uniform_real_distribution<float>(-1, 1)(rng);
+  }
+  Game other;
+  other.BuildSimpleLevel(3);
+  other.AddPlayer();
+  other.AddPlayer();
+  std::vector<Game*> games = {&game_, &other};
+  std::vector<std::unique_ptr<PolicyAgent>> singles;
+  for (int g = 0; g < 2; ++g) {
+    for (int i = 0; i < 2; ++i) {
+      singles.emplace_back(new PolicyAgent(game_.config(), i, model));
+    }
+  }
+  PolicyAgentBatch batch(game_.config(), model);
+  const std::vector<AgentBatch::Player> players = {
+      {0, 0}, {0, 1}, {1, 0}, {1, 1}};
+  for (int tick = 0; tick < 100; ++tick) {
+    const auto batched = batch.GetPlayerActions(
+        {&game_.game_state(), &other.game_state()}, players);
+    ASSERT_EQ(4, batched.size());
+    for (int g = 0; g < 2; ++g) {
+      std::vector<bman::MovePlayerRequest> moves;
+      for (int i = 0; i < 2; ++i) {
+        moves.push_back(
+            singles[g * 2 + i]->GetPlayerAction(games[g]->game_state()));
+        EXPECT_EQ(moves[i].SerializeAsString(),
+                  batched[g * 2 + i].SerializeAsString());
+      }
+      games[g]->Step(moves);
+    }
+  }
+}
+
+int main() { return RUN_ALL_TESTS(); }
@@ -3,14 +3,16 @@ import numpy as np
 import gym
 import math
 from gym import spaces
+from stable_baselines3.common.vec_env import VecEnv
 
 class BManGridEnv(gym.Env):
-  metadata = {'render.modes': ['human']}
+  metadata = {'render.modes': ['human', 'rgb_array']}
 
-  def __init__(self):
+  def __init__(self, frame_skip=8):
     super(BManGridEnv, self).__init__()
 
-    self.game = bman.GameWrapper()
+    # Each step holds the action for frame_skip ticks.
+    self.game = bman.GameWrapper(frame_skip)
     self.game.build_simple_level(2)
     access_map = self.game.get_map()
 
@@ -19,15 +21,14 @@ class BManGridEnv(gym.Env):
     self.action_space = spaces.Discrete(n_actions)
     self.observation_space = spaces.Box(low=-1.,
                                         high=1.,
-                                        shape=(access_map.h(),access_map.w()), dtype=np.float)
+                                        shape=(access_map.h(),access_map.w()), dtype=np.float32)
     self.window = None
     self.current_step = 0
     
   def reset(self):
     self.game.reset()
     self.current_step = 0
-    access_map = self.game.get_map()
-    return np.array(access_map.data()).reshape(access_map.h(), access_map.w())
+    return self._observe()
 
   def step(self, action):
     score_before = self.game.get_score(0)
@@ -44,18 +45,214 @@ class BManGridEnv(gym.Env):
 
     # Optionally we can pass additional info, we are not using that for now
     info = {'moved': action, 'score': score_after}
-    access_map = self.game.get_map()
     done = self.game.player_is_dead()
     # if done: reward -= 5
-    return np.array(access_map.data()).reshape(access_map.h(), access_map.w()), reward , done, info
+    return self._observe(), reward , done, info
+
+  def _observe(self):
+    # Written in place by the game, without going through a list.
+    return self.game.observe(
+        np.empty(self.observation_space.shape, dtype=np.float32))
 
-  def render(self, mode='console'):
+  def render(self, mode='console', cell_size=8):
+    if mode == 'rgb_array':
+      # Drawn in C++ without a window, cell_size pixels to a cell.
+      return self.game.render_pixels(cell_size)
     if mode != 'human':
       raise NotImplementedError()
+    # Drawn on the viewer's thread from copies the game hands it after each
+    # step, without slowing the steps down.
     if not self.window:
-      self.window = bman.GameWindow()
-    self.window.draw_game(self.game)
+      self.window = bman.GameViewer()
+      self.game.watch(self.window)
   
   def close(self):
-    pass
-    
+    if self.window:
+      self.game.watch(None)
+      self.window = None
+
+
+class BManVecEnv(VecEnv):
+  """num_envs BManGridEnvs stepped together in C++ (game_wrapper's
+  VecGameWrapper), with the GIL released and finished episodes reset.
+
+  With tensor_observation, the observations are channels x h x w one-hot
+  planes (observation.h's TensorObservation, with a danger channel if
+  danger is set) of the last frame_stack frames, stacked in C++ so that
+  VecFrameStack isn't needed.
+
+  With num_threads > 1, step_async starts the step on C++ worker threads
+  (each pinned to its own CPU if pin_threads is set) and returns straight
+  away, and step_wait waits for it.
+
+  With record set, env i's steps are recorded to <record>-<i>.traj, with
+  the observations, for TrajectoryDataset.
+
+  With level_pool set (a file of game_wrapper.generate_level_pool), each
+  reset starts a random level of the pool rather than the simple level,
+  env i picking them with seed + i.
+
+  The games write the observations, rewards and dones into arrays that
+  every step reuses, so reset and step_wait return copies of them:
+  stable-baselines keeps the last step's (e.g., PPO's episode starts) while
+  it takes the next. get_images' array is reused by every call, though,
+  copy it to keep it past the next one. It's drawn in C++ without a window
+  (see pixel_renderer.h).
+  """
+
+  def __init__(self, num_envs, num_threads=1, tensor_observation=False,
+               frame_stack=1, danger=False, frame_skip=8, pin_threads=False,
+               record=None, level_pool=None, seed=0):
+    self._init_games(
+        bman.VecGameWrapper(num_envs, num_threads,
+                            tensor_observation=tensor_observation,
+                            frame_stack=frame_stack, danger=danger,
+                            frame_skip=frame_skip, pin_threads=pin_threads,
+                            level_pool=level_pool or '', seed=seed))
+    if record:
+      self.games.start_recording(record)
+
+  def _init_games(self, games):
+    self.games = games
+    observation_space = spaces.Box(low=-1.,
+                                   high=1.,
+                                   shape=tuple(self.games.shape()),
+                                   dtype=np.float32)
+    super(BManVecEnv, self).__init__(self.games.num_envs(), observation_space,
+                                     spaces.Discrete(5))
+    self.actions = None
+    self.window = None
+    self.window_index = None
+
+  def reset(self):
+    return self.games.reset().copy()
+
+  def step_async(self, actions):
+    self.actions = actions
+    self.games.step_async(actions)
+
+  def step_wait(self):
+    obs, rewards, dones, terminal_obs = self.games.step_wait()
+    scores = self.games.scores()
+    infos = [{'moved': self.actions[i], 'score': scores[i]}
+             for i in range(self.num_envs)]
+    for i in np.flatnonzero(dones):
+      infos[i]['terminal_observation'] = terminal_obs[i].copy()
+    return obs.copy(), rewards.copy(), dones.copy(), infos
+
+  def render(self, mode='human', index=0):
+    if mode == 'rgb_array':
+      return self.get_images()[index]
+    if mode != 'human':
+      raise NotImplementedError()
+    # Env index is shown in a window drawn on its own thread (see
+    # BManGridEnv.render), from then on.
+    if not self.window:
+      self.window = bman.GameViewer()
+    if self.window_index != index:
+      self.games.watch(self.window, index)
+      self.window_index = index
+
+  def get_images(self, cell_size=8):
+    return self.games.render_pixels(cell_size)
+
+  def close(self):
+    if self.window:
+      self.games.watch(None)
+      self.window = None
+    if isinstance(self.games, bman.VecGameWrapper):
+      # Writes the index of any trajectories being recorded.
+      self.games.stop_recording()
+
+  def seed(self, seed=None):
+    # The games don't use randomness.
+    return [None] * self.num_envs
+
+  def get_attr(self, attr_name, indices=None):
+    return [getattr(self, attr_name)] * len(self._get_indices(indices))
+
+  def set_attr(self, attr_name, value, indices=None):
+    setattr(self, attr_name, value)
+
+  def env_method(self, method_name, *method_args, indices=None,
+                 **method_kwargs):
+    raise NotImplementedError()
+
+  def env_is_wrapped(self, wrapper_class, indices=None):
+    return [False] * len(self._get_indices(indices))
+
+  def _get_indices(self, indices):
+    if indices is None:
+      return range(self.num_envs)
+    if isinstance(indices, int):
+      return [indices]
+    return indices
+
+
+class BManSelfPlayVecEnv(BManVecEnv):
+  """Self-play: num_games games of num_players, stepped in C++ (game_wrapper's
+  SelfPlayGameWrapper), in which each of the first num_agents players is an
+  env of the VecEnv and the others are C++ SimpleAgents. Rows are
+  num_agents per game, so one policy plays all the agents.
+
+  Players respawn: a row is done when its agent dies, and its next episode
+  starts as the agent respawns in the same game. Every game restarts after
+  max_steps steps. Observations are as for BManVecEnv, as seen by the row's
+  player.
+  """
+
+  def __init__(self, num_games, num_agents=4, num_players=4, max_steps=1000,
+               num_threads=1, tensor_observation=False, frame_stack=1,
+               danger=False, frame_skip=8, pin_threads=False,
+               level_pool=None, seed=0):
+    self._init_games(
+        bman.SelfPlayGameWrapper(num_games, num_agents=num_agents,
+                                 num_players=num_players,
+                                 max_steps=max_steps,
+                                 num_threads=num_threads,
+                                 tensor_observation=tensor_observation,
+                                 frame_stack=frame_stack, danger=danger,
+                                 frame_skip=frame_skip,
+                                 pin_threads=pin_threads,
+                                 level_pool=level_pool or '', seed=seed))
+
+
+class TrajectoryDataset(object):
+  """Steps recorded to trajectory files (by BManVecEnv's record, or
+  bman_server's --record_dir), for offline RL. The files are memory mapped
+  in C++ (game_wrapper's TrajectoryReader), so only the steps sampled are
+  read, and the game state before any step can be regenerated with
+  TrajectoryReader.state.
+  """
+
+  def __init__(self, paths):
+    self.readers = [bman.TrajectoryReader(path) for path in paths]
+    sizes = [reader.num_steps() for reader in self.readers]
+    self.ends = np.cumsum(sizes)
+    self.starts = self.ends - sizes
+
+  def num_steps(self):
+    return int(self.ends[-1]) if len(self.ends) else 0
+
+  def read(self, steps):
+    """Returns the observations, actions, rewards, dones and next
+    observations of the steps, numbered across the files in order. The
+    observations are None if they weren't recorded."""
+    steps = np.asarray(steps, dtype=np.int64)
+    files = np.searchsorted(self.ends, steps, side='right')
+    batch = None
+    # A read_batch per file, scattered into the batch's rows.
+    for f in np.unique(files):
+      rows = np.flatnonzero(files == f)
+      columns = self.readers[f].read_batch(steps[rows] - self.starts[f])
+      if batch is None:
+        batch = [None if column is None else
+                 np.empty((len(steps),) + column.shape[1:], column.dtype)
+                 for column in columns]
+      for out, column in zip(batch, columns):
+        if out is not None:
+          out[rows] = column
+    return tuple(batch)
+
+  def sample(self, batch_size, rng=np.random):
+    return self.read(rng.randint(0, self.num_steps(), size=batch_size))
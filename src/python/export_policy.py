@@ -0,0 +1,78 @@
+"""Exports a policy trained by train_grid.py for PolicyAgent (policy_model.h).
+
+  python3 export_policy.py --model DQN --save_dir /tmp/gym --out /tmp/gym/policy.bmnn
+"""
+import argparse
+import struct
+import sys
+
+import numpy as np
+import torch
+from stable_baselines3 import PPO
+from sb3_contrib import QRDQN
+
+ACTIVATIONS = {torch.nn.Identity: 0, torch.nn.ReLU: 1, torch.nn.Tanh: 2}
+
+parser = argparse.ArgumentParser(description='Export a trained policy.')
+parser.add_argument('--model', type=str, help='DQN or PPO', default='DQN')
+parser.add_argument('--save_dir', type=str, help='Directory of the model',
+                    default='/tmp/gym')
+parser.add_argument('--out', type=str, help='File to write',
+                    default='/tmp/gym/policy.bmnn')
+parser.add_argument('--frame_stack', type=int,
+                    help='n_stack of the VecFrameStack used in training '
+                    '(4 for DQN, 10 for PPO in train_grid.py)', default=0)
+parser.add_argument('--frame_skip', type=int,
+                    help='Game ticks per action (GameWrapper.move_agent)',
+                    default=8)
+parser.add_argument('--expand', type=int, help='Map expand factor',
+                    default=3)
+args = parser.parse_args(sys.argv[1:])
+
+
+def dense_layers(modules):
+  """(weight, bias, activation) for the Linear layers in order."""
+  layers = []
+  for module in modules:
+    if isinstance(module, torch.nn.Linear):
+      layers.append([module.weight.detach().numpy(),
+                     module.bias.detach().numpy(), 0])
+    elif type(module) in ACTIVATIONS:
+      layers[-1][2] = ACTIVATIONS[type(module)]
+    elif not isinstance(module, torch.nn.Flatten):
+      raise ValueError('Unsupported module %s' % module)
+  return layers
+
+
+if args.model == 'DQN':
+  model = QRDQN.load(args.save_dir + '/10k')
+  frame_stack = args.frame_stack or 4
+  net = model.policy.quantile_net
+  layers = dense_layers(net.quantile_net)
+  # The outputs are (n_quantiles, n_actions) and the policy takes the
+  # action with the best mean, which is linear so fold it into the last
+  # layer.
+  n_quantiles, n_actions = net.n_quantiles, net.action_space.n
+  weight, bias, activation = layers[-1]
+  weight = weight.reshape(n_quantiles, n_actions, -1).mean(axis=0)
+  bias = bias.reshape(n_quantiles, n_actions).mean(axis=0)
+  layers[-1] = [weight, bias, activation]
+else:
+  model = PPO.load(args.save_dir + '/10k')
+  frame_stack = args.frame_stack or 10
+  policy = model.policy
+  layers = (dense_layers(policy.mlp_extractor.shared_net) +
+            dense_layers(policy.mlp_extractor.policy_net) +
+            dense_layers([policy.action_net]))
+
+with open(args.out, 'wb') as f:
+  f.write(b'BMNN')
+  f.write(struct.pack('<5i', 1, args.expand, frame_stack, args.frame_skip,
+                      len(layers)))
+  for weight, bias, activation in layers:
+    outputs, inputs = weight.shape
+    f.write(struct.pack('<3i', inputs, outputs, activation))
+    f.write(np.ascontiguousarray(weight, dtype='<f4').tobytes())
+    f.write(np.ascontiguousarray(bias, dtype='<f4').tobytes())
+print('Wrote %d layers (%d inputs, %d actions) to %s' %
+      (len(layers), layers[0][0].shape[1], layers[-1][0].shape[0], args.out))
@@ -1,9 +1,19 @@
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <pthread.h>
+
+#include <atomic>
 #include "agent.h"
 #include "game.h"
 #include "game_renderer.h"
+#include "grid_env.h"
+#include "level_generator.h"
+#include "mailbox.h"
+#include "observation.h"
+#include "pixel_renderer.h"
 #include "timer.h"
+#include "trajectory.h"
 
 namespace py = pybind11;
 
@@ -12,39 +22,14 @@ public:
   Map(const Map& m): w_(m.w_), h_(m.h_), expand_(m.expand_), data_(m.data_) {}
 
   Map(const bman::GameConfig& config, const bman::GameState& game_state) {
-    int expand = 3;
+    // Shared with PolicyAgent, so trained policies see the same thing when
+    // they're run natively.
+    bman::GridObservation observation(config);
     w_ = config.level_width();
     h_ = config.level_height();
-    data_.resize(w_ * h_ * expand * expand);
-    GridMap gm(config, game_state);
-    for (int y = 0; y < h_; ++y) {
-      for (int x = 0; x < w_; ++x) {
-        Point2i pt(x, y);
-        float value = 0;
-        if (gm.HasSolidBrick(pt)) {
-          value = 0.75;
-        } else if (gm.HasBomb(pt)) {
-          value = -0.5;
-        } else if (gm.IsExplosion(pt)) {
-          value = -1.0;
-        } else if (gm.HasPowerup(pt)) {
-          value = 1.0;
-        } else if (!gm.CanMove(pt)) {
-          value = 0.5;
-        }
-        for (int i = 0; i < expand; ++i) {
-          for (int j = 0; j < expand; ++j) {
-            data_[(y * expand + i) * w_ * expand + (x * expand + j)] = value;
-          }
-        }
-      }
-    }
-    if (game_state.players_size() > 0) {
-      const auto& player = game_state.players(0);
-      Point2i pt(GridRound(player.x() * expand), GridRound(player.y() * expand));
-      data_[pt.y * w_ * expand + pt.x] = 0.25;
-    }
-    expand_ = expand;
+    expand_ = bman::GridObservation::kDefaultExpand;
+    data_.resize(observation.size());
+    observation.Build(game_state, 0, data_.data());
   }
   const int w() const { return w_ * expand_; }
   const int h() const { return h_ * expand_; }
@@ -55,9 +40,58 @@ private:
   std::vector<float> data_;
 };
 
+// Shows a game in a window drawn on its own thread, fps times a second, so
+// that watching training doesn't slow it down. The stepping thread offers
+// the game after each step, and copies it to a Mailbox only when the viewer
+// has taken the last copy (so at most fps times a second): it never waits
+// for the window.
+class GameViewer {
+public:
+  explicit GameViewer(int fps) : fps_(fps) {
+    pthread_create(&thread_, nullptr, &GameViewer::StaticLoop, this);
+  }
+  ~GameViewer() {
+    stop_ = true;
+    pthread_join(thread_, nullptr);
+  }
+
+  void Offer(const Game& game) {
+    if (!mailbox_.empty() || closed_) {
+      return;
+    }
+    Snapshot* snapshot = mailbox_.back();
+    snapshot->config = game.config();
+    snapshot->state = game.game_state();
+    mailbox_.Publish();
+  }
+
+  // Whether the window has been closed.
+  bool closed() const { return closed_; }
+
+private:
+  struct Snapshot {
+    bman::GameConfig config;
+    bman::GameState state;
+  };
+
+  static void* StaticLoop(void* viewer) {
+    static_cast<GameViewer*>(viewer)->Loop();
+    return nullptr;
+  }
+  // Defined after GameWindow.
+  void Loop();
+
+  const int fps_;
+  pthread_t thread_;
+  bman::Mailbox<Snapshot> mailbox_;
+  std::atomic<bool> stop_{false};
+  std::atomic<bool> closed_{false};
+};
+
 class GameWrapper {
 public:
-  GameWrapper() {}
+  explicit GameWrapper(int frame_skip = bman::GridEnv::kFrameSkip)
+      : frame_skip_(frame_skip) {}
 
   void BuildSimpleLevel(int n) {
     game_.BuildSimpleLevel(n);
@@ -67,6 +101,17 @@ public:
 
   void Reset() {
     game_.set_game_state(initial_state_);
+    if (viewer_) {
+      viewer_->Offer(game_);
+    }
+  }
+
+  // Shows the game in the viewer after every step, until it's unset.
+  void Watch(std::shared_ptr<GameViewer> viewer) {
+    viewer_ = std::move(viewer);
+    if (viewer_) {
+      viewer_->Offer(game_);
+    }
   }
 
   bool PlayerIsDead() const {
@@ -94,6 +139,19 @@ public:
     return m;
   }
 
+  // Writes the map's observation straight into out (a C-contiguous float32
+  // array of h x w) and returns it.
+  py::array_t<float>
+  Observe(py::array_t<float, py::array::c_style> out) const {
+    bman::GridObservation observation(game_.config());
+    if (out.ndim() != 2 || out.shape(0) != observation.height() ||
+        out.shape(1) != observation.width()) {
+      throw std::invalid_argument("Observation must be h x w");
+    }
+    observation.Build(game_.game_state(), 0, out.mutable_data());
+    return out;
+  }
+
   bool MoveAgent(int dir, bool place_bomb, bool use_powerup) {
     std::vector<bman::MovePlayerRequest> move_requests(1);
 
@@ -113,12 +171,13 @@ public:
       action->set_use_powerup(true);
     }
     move_requests[0] = move;
-    bool ret = true;
-    for (int i = 0; i < 8; ++i) {
-      ret &= game_.Step(move_requests);
-      move_requests[0].mutable_actions(0)->set_place_bomb(false);
+    // Stops early if the player dies.
+    const bool stepped =
+        game_.StepFrames(std::move(move_requests), frame_skip_, 0) > 0;
+    if (viewer_) {
+      viewer_->Offer(game_);
     }
-    return ret;
+    return stepped;
   }
 
   const bman::GameState& game_state() const {
@@ -129,12 +188,285 @@ public:
     return game_.config();
   }
 
+  // The game as an h x w x 3 uint8 RGB image, cell_size pixels to a cell.
+  py::array_t<uint8_t> RenderPixels(int cell_size) {
+    if (!renderer_ || renderer_options_.cell_size != cell_size) {
+      renderer_options_.cell_size = cell_size;
+      renderer_ = std::make_unique<bman::PixelRenderer>(game_.config(),
+                                                        renderer_options_);
+      if (!renderer_->Load()) {
+        throw std::runtime_error("Failed to load the sprites");
+      }
+    }
+    py::array_t<uint8_t> pixels({renderer_->height(), renderer_->width(), 3});
+    renderer_->Draw(game_.game_state(), pixels.mutable_data());
+    return pixels;
+  }
+
 public:
   Game game_;
   bman::GameState initial_state_;
+  const int frame_skip_;
+  bman::PixelRenderer::Options renderer_options_;
+  std::unique_ptr<bman::PixelRenderer> renderer_;
+  std::shared_ptr<GameViewer> viewer_;
+};
+
+// Steps many games in one call, without holding the GIL: a VecGridEnv, or a
+// VecMultiGridEnv with a row per agent. The arrays are allocated once and
+// returned by every call, so each step overwrites the last one's (bman_env
+// copies them for stable-baselines, which keeps them across steps).
+template <typename VecEnv> class VecGameWrapper {
+public:
+  template <typename Options>
+  VecGameWrapper(int num_games, int num_threads, const Options& options,
+                 bool pin_threads)
+      : env_(num_games, num_threads, options, pin_threads),
+        observations_(ObservationShape()),
+        terminal_observations_(ObservationShape()),
+        actions_(env_.num_envs()), rewards_(env_.num_envs()),
+        dones_(env_.num_envs()) {}
+
+  py::array_t<float> Reset() {
+    if (stepping_) {
+      throw std::logic_error("reset called before step_wait");
+    }
+    {
+      py::gil_scoped_release release;
+      env_.Reset(observations_.mutable_data());
+    }
+    OfferToViewer();
+    return observations_;
+  }
+
+  // Returns the observations, rewards, dones and terminal observations (in
+  // the rows that are done, whose episode has been restarted).
+  py::tuple Step(py::array_t<int32_t, py::array::c_style |
+                                          py::array::forcecast> actions) {
+    StepAsync(actions);
+    return StepWait();
+  }
+
+  // Starts stepping with the actions on the env's threads and returns
+  // straight away; the arrays are written until StepWait.
+  void StepAsync(py::array_t<int32_t, py::array::c_style |
+                                          py::array::forcecast> actions) {
+    if (actions.size() != env_.num_envs()) {
+      throw std::invalid_argument("Expected an action for each env");
+    }
+    if (stepping_) {
+      throw std::logic_error("step_async called before step_wait");
+    }
+    std::copy(actions.data(), actions.data() + actions.size(),
+              actions_.mutable_data());
+    stepping_ = true;
+    py::gil_scoped_release release;
+    env_.StepAsync(actions_.data(), observations_.mutable_data(),
+                   rewards_.mutable_data(),
+                   reinterpret_cast<uint8_t*>(dones_.mutable_data()),
+                   terminal_observations_.mutable_data());
+  }
+
+  // Waits for StepAsync's step, returns as Step.
+  py::tuple StepWait() {
+    if (!stepping_) {
+      throw std::logic_error("step_wait called without step_async");
+    }
+    {
+      py::gil_scoped_release release;
+      env_.StepWait();
+    }
+    stepping_ = false;
+    OfferToViewer();
+    return py::make_tuple(observations_, rewards_, dones_,
+                          terminal_observations_);
+  }
+
+  py::array_t<int32_t> scores() const {
+    py::array_t<int32_t> scores(env_.num_envs());
+    for (int i = 0; i < env_.num_envs(); ++i) {
+      scores.mutable_data()[i] = env_.score(i);
+    }
+    return scores;
+  }
+
+  int num_envs() const { return env_.num_envs(); }
+  // Of a single env's observation.
+  std::vector<py::ssize_t> shape() const {
+    const std::vector<int> shape = env_.observation_shape();
+    return std::vector<py::ssize_t>(shape.begin(), shape.end());
+  }
+  const Game& game(int index) const { return env_.game(index); }
+
+  // Shows the game of the row (or env) in the viewer after every step, until
+  // it's unset.
+  void Watch(std::shared_ptr<GameViewer> viewer, int index) {
+    if (index < 0 || index >= env_.num_envs()) {
+      throw std::out_of_range("No env " + std::to_string(index));
+    }
+    if (stepping_) {
+      throw std::logic_error("watch called before step_wait");
+    }
+    viewer_ = std::move(viewer);
+    viewer_index_ = index;
+    OfferToViewer();
+  }
+
+  // Records env i to <prefix>-<i>.traj (VecGridEnv only).
+  void StartRecording(const std::string& prefix, bool record_observations) {
+    if (stepping_) {
+      throw std::logic_error("start_recording called before step_wait");
+    }
+    if (!env_.StartRecording(prefix, record_observations)) {
+      throw std::runtime_error("Failed to create " + prefix + "-*.traj");
+    }
+  }
+  void StopRecording() {
+    if (stepping_) {
+      throw std::logic_error("stop_recording called before step_wait");
+    }
+    env_.StopRecording();
+  }
+
+  // Every env's game as a num_envs x h x w x 3 uint8 RGB array, cell_size
+  // pixels to a cell, drawn without the GIL. The array is reused by every
+  // call with the same cell_size.
+  py::array_t<uint8_t> RenderPixels(int cell_size) {
+    if (stepping_) {
+      throw std::logic_error("render_pixels called before step_wait");
+    }
+    if (!renderer_ || renderer_options_.cell_size != cell_size) {
+      // One renderer draws every env: the board depends only on the level's
+      // size, which is the same for all of them (even with level pools).
+      renderer_options_.cell_size = cell_size;
+      renderer_ = std::make_unique<bman::PixelRenderer>(env_.game(0).config(),
+                                                        renderer_options_);
+      if (!renderer_->Load()) {
+        throw std::runtime_error("Failed to load the sprites");
+      }
+      pixels_ = py::array_t<uint8_t>(
+          {static_cast<py::ssize_t>(env_.num_envs()),
+           static_cast<py::ssize_t>(renderer_->height()),
+           static_cast<py::ssize_t>(renderer_->width()), py::ssize_t(3)});
+    }
+    uint8_t* pixels = pixels_.mutable_data();
+    {
+      py::gil_scoped_release release;
+      for (int i = 0; i < env_.num_envs(); ++i) {
+        renderer_->Draw(env_.game(i).game_state(),
+                        pixels + static_cast<size_t>(i) * renderer_->size());
+      }
+    }
+    return pixels_;
+  }
+
+private:
+  void OfferToViewer() {
+    if (viewer_) {
+      viewer_->Offer(env_.game(viewer_index_));
+    }
+  }
+
+  std::vector<py::ssize_t> ObservationShape() const {
+    std::vector<py::ssize_t> shape = {env_.num_envs()};
+    for (int size : env_.observation_shape()) {
+      shape.push_back(size);
+    }
+    return shape;
+  }
+
+  VecEnv env_;
+  py::array_t<float> observations_;
+  py::array_t<float> terminal_observations_;
+  // A copy of the actions being stepped, for StepAsync.
+  py::array_t<int32_t> actions_;
+  py::array_t<float> rewards_;
+  py::array_t<bool> dones_;
+  bool stepping_ = false;
+  bman::PixelRenderer::Options renderer_options_;
+  std::unique_ptr<bman::PixelRenderer> renderer_;
+  py::array_t<uint8_t> pixels_;
+  std::shared_ptr<GameViewer> viewer_;
+  int viewer_index_ = 0;
+};
+
+// The level pool at path, or none if path is empty.
+std::shared_ptr<const bman::LevelPool> OpenLevelPool(const std::string& path) {
+  if (path.empty()) {
+    return nullptr;
+  }
+  auto levels = std::make_shared<bman::LevelPool>();
+  if (!levels->Open(path)) {
+    throw std::runtime_error("Failed to open " + path);
+  }
+  return levels;
+}
+
+// Reads minibatches from a trajectory file without holding the GIL.
+class TrajectoryReaderWrapper {
+public:
+  explicit TrajectoryReaderWrapper(const std::string& path) {
+    if (!reader_.Open(path)) {
+      throw std::runtime_error("Failed to open " + path);
+    }
+  }
+
+  // Returns the observations, actions, rewards, dones and next observations
+  // (zeros after the last step of an episode) of the steps, as
+  // TrajectoryReader::ReadBatch. The observations are None if they weren't
+  // recorded.
+  py::tuple ReadBatch(py::array_t<int64_t, py::array::c_style |
+                                               py::array::forcecast> steps) {
+    const int n = steps.size();
+    for (int i = 0; i < n; ++i) {
+      if (steps.data()[i] < 0 || steps.data()[i] >= reader_.num_steps()) {
+        throw std::out_of_range("No step " +
+                                std::to_string(steps.data()[i]));
+      }
+    }
+    std::vector<py::ssize_t> shape = {n};
+    for (int size : reader_.observation_shape()) {
+      shape.push_back(size);
+    }
+    py::array_t<float> observations(shape), next_observations(shape);
+    py::array_t<int32_t> actions(n);
+    py::array_t<float> rewards(n);
+    py::array_t<bool> dones(n);
+    const bool has_observations = reader_.observation_size() > 0;
+    {
+      py::gil_scoped_release release;
+      reader_.ReadBatch(
+          steps.data(), n,
+          has_observations ? observations.mutable_data() : nullptr,
+          actions.mutable_data(), rewards.mutable_data(),
+          reinterpret_cast<uint8_t*>(dones.mutable_data()),
+          has_observations ? next_observations.mutable_data() : nullptr);
+    }
+    if (!has_observations) {
+      return py::make_tuple(py::none(), actions, rewards, dones, py::none());
+    }
+    return py::make_tuple(observations, actions, rewards, dones,
+                          next_observations);
+  }
+
+  // The serialized GameState before the step, replayed from its chunk.
+  py::bytes State(int64_t step) const {
+    if (step < 0 || step >= reader_.num_steps()) {
+      throw std::out_of_range("No step " + std::to_string(step));
+    }
+    return py::bytes(reader_.State(step).SerializeAsString());
+  }
+
+  int64_t num_steps() const { return reader_.num_steps(); }
+  int num_episodes() const { return reader_.num_episodes(); }
+  std::vector<int> observation_shape() const {
+    return reader_.observation_shape();
+  }
+
+private:
+  bman::TrajectoryReader reader_;
 };
 
-  
 class GameWindow {
 public:
   GameWindow() {
@@ -168,29 +500,56 @@ public:
   }
 
   void DrawGame(const GameWrapper& game) {
+    Draw(game.config(), game.game_state());
+  }
+  template <typename VecEnv>
+  void DrawVecGame(const VecGameWrapper<VecEnv>& games, int index) {
+    Draw(games.game(index).config(), games.game(index).game_state());
+  }
+
+  void Draw(const bman::GameConfig& config,
+            const bman::GameState& game_state) {
     bman::Timer timer;
 
-    game_renderer_.set_config(game.config());
-    HandleInput();
-    game_renderer_.Draw(game.game_state(), SDL_GetWindowSurface(window_));
-    SDL_UpdateWindowSurface(window_);
+    if (!Show(config, game_state)) {
+      exit(0);
+    }
 
     timer.Wait(4 * 1000 / 60);
   }
 
-  // Read and process any pending SDL events
-  int HandleInput() {
+  // Draws the game straight away. Returns false if the window has been
+  // closed.
+  bool Show(const bman::GameConfig& config,
+            const bman::GameState& game_state) {
+    game_renderer_.set_config(config);
+    const bool open = HandleInput();
+    game_renderer_.Draw(game_state, SDL_GetWindowSurface(window_));
+    SDL_UpdateWindowSurface(window_);
+    return open;
+  }
+
+  // Read and process any pending SDL events. Returns false if the window
+  // has been closed.
+  bool HandleInput() {
+    bool open = true;
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
       switch (event.type) {
       case SDL_QUIT:
-        exit(0);
+        open = false;
         break;
       default:
         break;
       }
     }
-    return 0;
+    return open;
+  }
+
+  // Closes the window, which can't be drawn to after.
+  void Close() {
+    SDL_DestroyRenderer(sdl_renderer_);
+    SDL_DestroyWindow(window_);
   }
 
 private:
@@ -199,24 +558,177 @@ private:
   GameRenderer game_renderer_;
 };
 
+void GameViewer::Loop() {
+  // SDL's window and events belong to the thread that opened them.
+  GameWindow window;
+  const Snapshot* snapshot = nullptr;
+  while (!stop_) {
+    bman::Timer timer;
+    // The last snapshot is kept (and redrawn) until there's a newer one.
+    if (const Snapshot* newest = mailbox_.Take()) {
+      snapshot = newest;
+    }
+    const bool open = snapshot
+                          ? window.Show(snapshot->config, snapshot->state)
+                          : window.HandleInput();
+    if (!open) {
+      closed_ = true;
+      break;
+    }
+    timer.Wait(1000 / fps_);
+  }
+  window.Close();
+}
+
 PYBIND11_MODULE(game_wrapper, m) {
   py::class_<GameWrapper>(m, "GameWrapper")
-    .def(py::init<>())
+    .def(py::init<int>(), py::arg("frame_skip") = bman::GridEnv::kFrameSkip)
     .def("build_simple_level", &GameWrapper::BuildSimpleLevel)
     .def("get_score", &GameWrapper::GetScore)
     .def("get_map", &GameWrapper::GetMap)
+    .def("observe", &GameWrapper::Observe, py::arg("out").noconvert())
     .def("reset", &GameWrapper::Reset)
     .def("player_is_dead", &GameWrapper::PlayerIsDead)
     .def("move_agent", &GameWrapper::MoveAgent)
     .def("pos", &GameWrapper::pos)
-    .def("num_bombs", &GameWrapper::num_bombs);
-
-  py::class_<Map>(m, "Map")
+    .def("num_bombs", &GameWrapper::num_bombs)
+    .def("render_pixels", &GameWrapper::RenderPixels,
+         py::arg("cell_size") = bman::PixelRenderer::Options().cell_size)
+    .def("watch", &GameWrapper::Watch, py::arg("viewer").none(true));
+
+  using VecGridWrapper = VecGameWrapper<bman::VecGridEnv>;
+  py::class_<VecGridWrapper>(m, "VecGameWrapper")
+    .def(py::init([](int num_envs, int num_threads, bool tensor_observation,
+                     int frame_stack, bool danger, int frame_skip,
+                     bool pin_threads, const std::string& level_pool,
+                     uint32_t seed) {
+           bman::GridEnv::Options options;
+           options.tensor_observation = tensor_observation;
+           options.frame_stack = frame_stack;
+           options.tensor.danger = danger;
+           options.frame_skip = frame_skip;
+           options.levels = OpenLevelPool(level_pool);
+           options.seed = seed;
+           return new VecGridWrapper(num_envs, num_threads, options,
+                                     pin_threads);
+         }),
+         py::arg("num_envs"), py::arg("num_threads") = 1,
+         py::arg("tensor_observation") = false, py::arg("frame_stack") = 1,
+         py::arg("danger") = false,
+         py::arg("frame_skip") = bman::GridEnv::kFrameSkip,
+         py::arg("pin_threads") = false, py::arg("level_pool") = "",
+         py::arg("seed") = 0)
+    .def("reset", &VecGridWrapper::Reset)
+    .def("step", &VecGridWrapper::Step)
+    .def("step_async", &VecGridWrapper::StepAsync)
+    .def("step_wait", &VecGridWrapper::StepWait)
+    .def("scores", &VecGridWrapper::scores)
+    .def("num_envs", &VecGridWrapper::num_envs)
+    .def("shape", &VecGridWrapper::shape)
+    .def("render_pixels", &VecGridWrapper::RenderPixels,
+         py::arg("cell_size") = bman::PixelRenderer::Options().cell_size)
+    .def("watch", &VecGridWrapper::Watch, py::arg("viewer").none(true),
+         py::arg("index") = 0)
+    .def("start_recording", &VecGridWrapper::StartRecording,
+         py::arg("prefix"), py::arg("record_observations") = true)
+    .def("stop_recording", &VecGridWrapper::StopRecording);
+
+  // num_envs() is num_games * num_agents, a row per agent.
+  using SelfPlayWrapper = VecGameWrapper<bman::VecMultiGridEnv>;
+  py::class_<SelfPlayWrapper>(m, "SelfPlayGameWrapper")
+    .def(py::init([](int num_games, int num_agents, int num_players,
+                     int max_steps, int num_threads, bool tensor_observation,
+                     int frame_stack, bool danger, int frame_skip,
+                     bool pin_threads, const std::string& level_pool,
+                     uint32_t seed) {
+           bman::MultiGridEnv::Options options;
+           options.num_agents = num_agents;
+           options.num_players = num_players;
+           options.max_steps = max_steps;
+           options.observation.tensor_observation = tensor_observation;
+           options.observation.frame_stack = frame_stack;
+           options.observation.tensor.danger = danger;
+           options.observation.frame_skip = frame_skip;
+           options.observation.levels = OpenLevelPool(level_pool);
+           options.observation.seed = seed;
+           return new SelfPlayWrapper(num_games, num_threads, options,
+                                      pin_threads);
+         }),
+         py::arg("num_games"), py::arg("num_agents") = 4,
+         py::arg("num_players") = 4, py::arg("max_steps") = 1000,
+         py::arg("num_threads") = 1, py::arg("tensor_observation") = false,
+         py::arg("frame_stack") = 1, py::arg("danger") = false,
+         py::arg("frame_skip") = bman::GridEnv::kFrameSkip,
+         py::arg("pin_threads") = false, py::arg("level_pool") = "",
+         py::arg("seed") = 0)
+    .def("reset", &SelfPlayWrapper::Reset)
+    .def("step", &SelfPlayWrapper::Step)
+    .def("step_async", &SelfPlayWrapper::StepAsync)
+    .def("step_wait", &SelfPlayWrapper::StepWait)
+    .def("scores", &SelfPlayWrapper::scores)
+    .def("num_envs", &SelfPlayWrapper::num_envs)
+    .def("shape", &SelfPlayWrapper::shape)
+    .def("render_pixels", &SelfPlayWrapper::RenderPixels,
+         py::arg("cell_size") = bman::PixelRenderer::Options().cell_size)
+    .def("watch", &SelfPlayWrapper::Watch, py::arg("viewer").none(true),
+         py::arg("index") = 0);
+
+  // Writes a pool of num_levels random levels (see level_generator.h) for
+  // the level_pool of VecGameWrapper and SelfPlayGameWrapper.
+  m.def("generate_level_pool",
+        [](const std::string& path, int64_t num_levels, uint64_t seed,
+           int width, int height, int num_players, bool random_spawns) {
+          bman::LevelGenerator::Options options;
+          options.width = width;
+          options.height = height;
+          options.num_players = num_players;
+          options.random_spawns = random_spawns;
+          bool ok;
+          {
+            py::gil_scoped_release release;
+            ok = bman::LevelPool::Write(path, bman::LevelGenerator(options),
+                                        num_levels, seed);
+          }
+          if (!ok) {
+            throw std::runtime_error("Failed to write " + path);
+          }
+        },
+        py::arg("path"), py::arg("num_levels"), py::arg("seed") = 1,
+        py::arg("width") = kDefaultWidth, py::arg("height") = kDefaultHeight,
+        py::arg("num_players") = 4, py::arg("random_spawns") = false);
+
+  py::class_<TrajectoryReaderWrapper>(m, "TrajectoryReader")
+    .def(py::init<const std::string&>(), py::arg("path"))
+    .def("read_batch", &TrajectoryReaderWrapper::ReadBatch)
+    .def("state", &TrajectoryReaderWrapper::State)
+    .def("num_steps", &TrajectoryReaderWrapper::num_steps)
+    .def("num_episodes", &TrajectoryReaderWrapper::num_episodes)
+    .def("observation_shape", &TrajectoryReaderWrapper::observation_shape);
+
+  // Numpy sees a Map as an h x w array (np.asarray(map) doesn't copy), and
+  // data() is a view of it.
+  py::class_<Map>(m, "Map", py::buffer_protocol())
+    .def_buffer([](Map& map) {
+      return py::buffer_info(
+          const_cast<float*>(map.data().data()), sizeof(float),
+          py::format_descriptor<float>::format(), 2, {map.h(), map.w()},
+          {sizeof(float) * map.w(), sizeof(float)});
+    })
     .def("w", &Map::w)
     .def("h", &Map::h)
-    .def("data", &Map::data);
+    .def("data", [](py::object self) {
+      const Map& map = self.cast<const Map&>();
+      return py::array_t<float>({map.h(), map.w()}, map.data().data(), self);
+    });
+
+  // A window drawn on its own thread, for the games' watch.
+  py::class_<GameViewer, std::shared_ptr<GameViewer>>(m, "GameViewer")
+    .def(py::init<int>(), py::arg("fps") = 15)
+    .def("closed", &GameViewer::closed);
 
   py::class_<GameWindow>(m, "GameWindow")
     .def(py::init<>())
-    .def("draw_game", &GameWindow::DrawGame);
+    .def("draw_game", &GameWindow::DrawGame)
+    .def("draw_vec_game", &GameWindow::DrawVecGame<bman::VecGridEnv>)
+    .def("draw_vec_game", &GameWindow::DrawVecGame<bman::VecMultiGridEnv>);
 }
@@ -9,8 +9,6 @@ from stable_baselines3.common.vec_env import VecFrameStack
 from stable_baselines3 import PPO, A2C
 from sb3_contrib import QRDQN
 
-from stable_baselines3.common.cmd_util import make_vec_env
-
 parser = argparse.ArgumentParser(description='Train single agent.')
 parser.add_argument('--num_train_its', type=int,
                     help='Number of training iterations', default=10000)
@@ -21,6 +19,25 @@ parser.add_argument('--save_dir', type=str, help='Director to save state',
                     default='/tmp/gym')
 parser.add_argument('--train', type=int, help='Whether to train or not',
                     default=0)
+parser.add_argument('--num_envs', type=int,
+                    help='Games stepped together when training PPO',
+                    default=4)
+parser.add_argument('--num_threads', type=int,
+                    help='Threads stepping the games', default=1)
+parser.add_argument('--pin_threads', type=int,
+                    help='Whether to pin each stepping thread to a CPU',
+                    default=0)
+parser.add_argument('--self_play_agents', type=int,
+                    help='If set, PPO trains this many agents per game '
+                    'against each other (and SimpleAgents in the other '
+                    'seats)', default=0)
+parser.add_argument('--record', type=str,
+                    help='Prefix of trajectory files to record the games '
+                    'to, one per env (not with --self_play_agents)',
+                    default=None)
+parser.add_argument('--level_pool', type=str,
+                    help='Level pool (see game_wrapper.generate_level_pool) '
+                    'to reset to random levels of', default=None)
 args = parser.parse_args(sys.argv[1:])
 
 def callback(a1, a2):
@@ -32,8 +49,8 @@ def callback(a1, a2):
     return True
 
 if args.model == 'DQN':
-    env_raw = bman_env.BManGridEnv()
-    env = make_vec_env(lambda: env_raw, n_envs=1)
+    env = bman_env.BManVecEnv(1, record=args.record,
+                              level_pool=args.level_pool)
     env = VecFrameStack(env, n_stack=4)
     policy_kwargs = dict(n_quantiles=50)
     model = QRDQN('MlpPolicy', env, verbose=2,
@@ -44,8 +61,18 @@ if args.model == 'DQN':
                   exploration_fraction=0.95,
                   exploration_final_eps=0.01)
 else:
-    env_raw = bman_env.BManGridEnv()
-    env = make_vec_env(lambda: env_raw, n_envs=4 if args.train else 1)
+    if args.train and args.self_play_agents:
+        env = bman_env.BManSelfPlayVecEnv(args.num_envs,
+                                          num_agents=args.self_play_agents,
+                                          num_threads=args.num_threads,
+                                          pin_threads=bool(args.pin_threads),
+                                          level_pool=args.level_pool)
+    else:
+        env = bman_env.BManVecEnv(args.num_envs if args.train else 1,
+                                  args.num_threads,
+                                  pin_threads=bool(args.pin_threads),
+                                  record=args.record,
+                                  level_pool=args.level_pool)
 
     if args.train:
         env = VecFrameStack(env, n_stack=10)
@@ -66,7 +93,6 @@ else:
 
 
 obs = env.reset()
-env_raw.render_all = True
 n_steps = args.num_steps
 for step in range(n_steps):
   action, _ = model.predict(obs, deterministic=False)
@@ -76,3 +102,5 @@ for step in range(n_steps):
   #print('obs=', obs, 'reward=', reward, 'done=', done)
   env.render(mode='human')
   #if env_raw.window.is_closed(): break
+
+env.close()
@@ -1,5 +1,8 @@
 #include "simple_agent.h"
 #include "glog/logging.h"
+#include "timer.h"
+
+#include <limits>
 
 struct Option {
   Point2i pos;
@@ -12,6 +15,13 @@ struct Option {
 
 bman::MovePlayerRequest
 SimpleAgent::GetPlayerAction(const bman::GameState& game_state) {
+  return GetPlayerActionBy(game_state,
+                           std::numeric_limits<double>::infinity());
+}
+
+bman::MovePlayerRequest
+SimpleAgent::GetPlayerActionBy(const bman::GameState& game_state,
+                               double deadline_millis) {
   // If no plan, or reached new milestone (reconsider)
   LOG(INFO) << game_state.players_size() << " " << game_state.players_size()
             << " " << player_index_;
@@ -32,9 +42,15 @@ SimpleAgent::GetPlayerAction(const bman::GameState& game_state) {
   }
 
   Point2i pos(GridRound(player.x()), GridRound(player.y()));
+  for (const auto& event : game_state.events()) {
+    if (!plan_dirty_ && TouchesPlan(game_state, event, pos)) {
+      plan_dirty_ = true;
+    }
+  }
   bool reached_waypoint = false;
   bool place_bomb = false;
-  GridMap grid_map(game_config_, game_state);
+  std::shared_ptr<const WorldAnalysis> analysis =
+      analysis_cache_->Get(game_config_, game_state);
 
   int cx = player.x() - pos.x * kSubpixelSize;
   int cy = player.y() - pos.y * kSubpixelSize;
@@ -46,13 +62,26 @@ SimpleAgent::GetPlayerAction(const bman::GameState& game_state) {
     if (place_bomb) {
       // Place a bomb (in our local copy) to avoid killing ourself on upcoming
       // plan
+      GridMap grid_map = analysis->grid_map();
       grid_map.PlaceBomb(pos, player_index_);
+      DangerMap danger_map = analysis->danger_map();
+      bman::LevelState::Bomb bomb;
+      bomb.set_x(pos.x);
+      bomb.set_y(pos.y);
+      bomb.set_strength(player.strength());
+      bomb.set_timer(kDefaultBombTimer + 1);
+      bomb.set_player_id(player_index_);
+      danger_map.AddBomb(bomb);
+      analysis.reset(new WorldAnalysis(game_config_, game_state, grid_map,
+                                       std::move(danger_map)));
     }
   }
+  const GridMap& grid_map = analysis->grid_map();
 
   // If next point is obstructed, replan
-  MaybeCreateNewPlan(reached_waypoint, grid_map, pos,
-                     game_state.players(player_index_).strength());
+  MaybeCreateNewPlan(reached_waypoint, *analysis, pos,
+                     game_state.players(player_index_).strength(),
+                     deadline_millis);
 
   if (!plan_.size()) {
     LOG(WARNING) << "No valid plan!";
@@ -65,7 +94,12 @@ SimpleAgent::GetPlayerAction(const bman::GameState& game_state) {
   int dir = Agent::GetDirFromDelta(delta.x, delta.y);
   GetDeltaFromDir(dir, &delta.x, &delta.y);
 
-  if (grid_map.IsExplosion(plan_.front().pos)) {
+  // Wait for flames to clear (unless it's about to get worse here).
+  const DangerMap& danger_map = analysis->danger_map();
+  const int ticks_per_cell = kSubPixelSize / kAgentSpeed;
+  if (grid_map.IsExplosion(plan_.front().pos) ||
+      (danger_map.InFlame(plan_.front().pos, ticks_per_cell) &&
+       !danger_map.InFlame(pos, ticks_per_cell))) {
     dir = -1;
   }
 
@@ -83,61 +117,49 @@ SimpleAgent::GetPlayerAction(const bman::GameState& game_state) {
   return move;
 }
 
-std::unordered_set<Point2i, PointHash>
-SimpleAgent::FindNoGoZones(const GridMap& grid_map) {
-
-  std::unordered_map<Point2i, int, PointHash> component;
-  std::vector<std::vector<Point2i>> component_points;
-  auto& config = game_config_;
-
-  for (int y = 0; y < config.level_height(); ++y) {
-    for (int x = 0; x < config.level_width(); ++x) {
-      Point2i pos(x, y);
-      if (component.count(pos))
-        continue;
-      if (!grid_map.CanMove(pos))
-        continue;
-
-      std::deque<Point2i> queue;
-      queue.push_back(pos);
-      component[queue.front()] = component_points.size();
-
-      std::vector<Point2i> points;
-
-      while (!queue.empty()) {
-        const static Point2i neigh[4] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
-        const auto cur = queue.front();
-        queue.pop_front();
-        points.push_back(cur);
-
-        for (const auto& n : neigh) {
-          const Point2i other = cur + n;
-          if (grid_map.CanMove(other) && !component.count(other)) {
-            queue.push_back(other);
-            component[other] = component_points.size();
-          }
-        }
+bool SimpleAgent::TouchesPlan(const bman::GameState& game_state,
+                              const bman::GameEvent& event,
+                              const Point2i& pos) const {
+  // A new powerup anywhere may be a better goal.
+  if (event.type() == bman::GameEvent::EVENT_POWERUP_REVEALED)
+    return true;
+  // Otherwise anything within a couple of cells, and the blast of new bombs.
+  const int kRadius = 2;
+  int blast = kRadius;
+  if (event.type() == bman::GameEvent::EVENT_BOMB_PLACED ||
+      event.type() == bman::GameEvent::EVENT_BOMB_KICKED) {
+    for (const auto& bomb : game_state.level().bombs()) {
+      if (bomb.x() == event.x() && bomb.y() == event.y()) {
+        blast = std::max(blast, bomb.strength());
       }
-      component_points.push_back(points);
     }
   }
-
-  std::unordered_set<Point2i, PointHash> result;
-
-  // TOOD: This is only very approximate. Should consider blast radius, etc.
-  for (const auto& cp : component_points) {
-    if (cp.size() > 4)
-      continue;
-    for (const auto& pos : cp) {
-      result.insert(pos);
-    }
+  auto touches = [&](const Point2i& pt) {
+    const int dx = abs(pt.x - event.x());
+    const int dy = abs(pt.y - event.y());
+    return dx + dy <= kRadius || (std::min(dx, dy) == 0 && dx + dy <= blast);
+  };
+  if (touches(pos))
+    return true;
+  for (const auto& plan_point : plan_) {
+    if (touches(plan_point.pos))
+      return true;
   }
-  return result;
+  return false;
+}
+
+bool SimpleAgent::IsNoGoZone(const WorldAnalysis& analysis,
+                             const Point2i& pos) const {
+  // TOOD: This is only very approximate. Small pockets are traps once a bomb
+  // has been placed, the danger map takes care of blast radius.
+  const int component = analysis.component(pos);
+  return component >= 0 && analysis.component_size(component) <= 4;
 }
 
 void SimpleAgent::MaybeCreateNewPlan(bool reached_waypoint,
-                                     const GridMap& grid_map,
-                                     const Point2i& pos, int player_strength) {
+                                     const WorldAnalysis& analysis,
+                                     const Point2i& pos, int player_strength,
+                                     double deadline_millis) {
   // Do a BFS
   // Score each grid point
   //   Score is number of points you would get
@@ -148,29 +170,36 @@ void SimpleAgent::MaybeCreateNewPlan(bool reached_waypoint,
 
   // Neighbors.
   const Point2i neigh[4] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+  const GridMap& grid_map = analysis.grid_map();
 
-  if (plan_.size() && grid_map.HasBomb(plan_.front().pos)) {
+  if (plan_.size() && grid_map.HasBomb(plan_.front().pos) &&
+      !RepairPlan(analysis, pos)) {
     plan_.clear();
   }
-  if (!(plan_.empty() ||
-        (reached_waypoint && random_double() < replan_prob_))) {
-    // TODO replan occasionally
+  // Otherwise keep to the plan until something has happened near it (and
+  // there's time to reconsider, else plan_dirty_ carries over to the next
+  // waypoint).
+  if (!(plan_.empty() || (reached_waypoint && plan_dirty_ &&
+                          bman::Timer::NowMillis() < deadline_millis))) {
     return;
   }
-  auto no_go = FindNoGoZones(grid_map);
-
-  std::unordered_map<Point2i, Point2i, PointHash> prev_map;
-  std::unordered_map<Point2i, int, PointHash> depth_map;
+  plan_dirty_ = false;
+  // The BFS from our position is part of the shared analysis, visit the
+  // reachable points in the same order. Parents are visited before their
+  // children so a path is safe if the path to the parent is and we won't be
+  // walking through flame when crossing the point.
+  const DangerMap& danger_map = analysis.danger_map();
+  const int ticks_per_cell = kSubPixelSize / kAgentSpeed;
+  std::vector<bool> safe_path(analysis.width() * analysis.height(), false);
   std::vector<Option> options;
-  std::deque<Point2i> queue;
-
-  queue.push_back(pos);
-  depth_map[pos] = 0;
-  prev_map[pos] = Point2i(0, 0);
-
-  while (!queue.empty()) {
-    Point2i cur = queue.front();
-    queue.pop_front();
+  for (int index : analysis.bfs_order(player_index_)) {
+    const Point2i cur = analysis.FromIndex(index);
+    const int arrival = analysis.Distance(player_index_, cur) * ticks_per_cell;
+    safe_path[index] =
+        (cur == pos ||
+         safe_path[analysis.Index(analysis.Previous(player_index_, cur))]) &&
+        !danger_map.InFlame(cur, std::max(0, arrival - ticks_per_cell / 2)) &&
+        !danger_map.InFlame(cur, arrival + ticks_per_cell / 2);
 
     Option option;
     option.pos = cur;
@@ -178,10 +207,14 @@ void SimpleAgent::MaybeCreateNewPlan(bool reached_waypoint,
       option.score += kPointsPowerUp;
       option.has_powerup = true;
     }
-    if (no_go.count(cur)) {
+    if (IsNoGoZone(analysis, cur)) {
       LOG(INFO) << "no go!";
       option.score = -100;
     }
+    // Don't walk through flames, or wait where they're going to be.
+    if (!safe_path[index] || danger_map.TicksUntilSafe(cur) > arrival) {
+      option.score = -100;
+    }
 
     for (int n = 0; n < 4; ++n) {
       Point2i new_point = cur + neigh[n];
@@ -201,16 +234,14 @@ void SimpleAgent::MaybeCreateNewPlan(bool reached_waypoint,
         continue;
       }
 
-      if (!prev_map.count(new_point)) {
-        prev_map[new_point] = cur;
-        depth_map[new_point] = depth_map[cur] + 1;
-        queue.push_back(new_point);
-      }
-
       // Update score with any other bricks in this direction hat would get
       // hit.
       for (int k = 2; k <= player_strength; ++k) {
         new_point = new_point + neigh[n];
+        // Flames stop at walls (and the edge of the map).
+        if (Game::IsStaticBrick(game_config_, new_point.x, new_point.y)) {
+          break;
+        }
         if (grid_map.HasSolidBrick(new_point)) {
           option.score += kPointsBrick;
           option.num_bricks++;
@@ -223,7 +254,7 @@ void SimpleAgent::MaybeCreateNewPlan(bool reached_waypoint,
       // If you are going
       int num_cycles_per_grid = kSubPixelSize / kAgentSpeed;
       double norm = double(kDefaultBombTimer) / num_cycles_per_grid;
-      double dist = double(depth_map[cur]) / norm;
+      double dist = double(analysis.Distance(player_index_, cur)) / norm;
       option.score -= dist;
       options.push_back(option);
     }
@@ -246,8 +277,48 @@ void SimpleAgent::MaybeCreateNewPlan(bool reached_waypoint,
     plan_.push_back(plan_point);
     if (cur == pos)
       break;
-    cur = prev_map[cur];
+    cur = analysis.Previous(player_index_, cur);
   }
   std::reverse(plan_.begin(), plan_.end());
+  // The planner only searches if the plan needs repairing.
+  planner_.SetStart(pos);
+  planner_.SetGoal(chosen.pos);
   LOG(INFO) << "Done with plan";
 }
+
+bool SimpleAgent::RepairPlan(const WorldAnalysis& analysis,
+                             const Point2i& pos) {
+  if (!planner_.has_goal() || planner_.goal() != plan_.back().pos)
+    return false;
+  planner_.Update(analysis.grid_map());
+  planner_.SetStart(pos);
+  std::vector<Point2i> path;
+  if (!planner_.ComputePath(&path) || path.empty())
+    return false;
+
+  // Same checks as for a new plan.
+  const DangerMap& danger_map = analysis.danger_map();
+  const int ticks_per_cell = kSubPixelSize / kAgentSpeed;
+  for (size_t i = 0; i < path.size(); ++i) {
+    const int arrival = (i + 1) * ticks_per_cell;
+    if (danger_map.InFlame(path[i],
+                           std::max(0, arrival - ticks_per_cell / 2)) ||
+        danger_map.InFlame(path[i], arrival + ticks_per_cell / 2)) {
+      return false;
+    }
+  }
+  if (danger_map.TicksUntilSafe(path.back()) >
+      (int)path.size() * ticks_per_cell) {
+    return false;
+  }
+
+  const bool place_bomb = plan_.back().place_bomb;
+  plan_.clear();
+  for (const auto& pt : path) {
+    PlanPoint plan_point;
+    plan_point.pos = pt;
+    plan_.push_back(plan_point);
+  }
+  plan_.back().place_bomb = place_bomb;
+  return true;
+}
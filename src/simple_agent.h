@@ -6,7 +6,10 @@
 #include "grid_map.h"
 #include "level.grpc.pb.h"
 #include "math.h"
+#include "path_planner.h"
+#include "world_analysis.h"
 #include <deque>
+#include <memory>
 
 struct PlanPoint {
   Point2i pos;
@@ -16,26 +19,47 @@ struct PlanPoint {
 
 class SimpleAgent : public Agent {
 public:
-  SimpleAgent(const bman::GameConfig& config, int player_index)
-      : game_config_(config), player_index_(player_index) {
-    replan_prob_ = 0.5;
-  }
+  // Agents in the same game can share an analysis_cache so the per-tick
+  // world analysis is only computed once.
+  SimpleAgent(const bman::GameConfig& config, int player_index,
+              std::shared_ptr<WorldAnalysisCache> analysis_cache = nullptr)
+      : game_config_(config), player_index_(player_index),
+        analysis_cache_(analysis_cache ? analysis_cache
+                                       : std::make_shared<WorldAnalysisCache>()),
+        planner_(config) {}
 
   bman::MovePlayerRequest
-  GetPlayerAction(const bman::GameState& game_state_const);
+  GetPlayerAction(const bman::GameState& game_state) override;
+  // Follows the plan, but if there's no time left it puts off reconsidering
+  // it (unless it can't be followed) until a later waypoint.
+  bman::MovePlayerRequest
+  GetPlayerActionBy(const bman::GameState& game_state,
+                    double deadline_millis) override;
 
 private:
-  std::unordered_set<Point2i, PointHash> FindNoGoZones(const GridMap& grid_map);
+  bool IsNoGoZone(const WorldAnalysis& analysis, const Point2i& pos) const;
+  // Whether the event happened close enough to the plan (including where
+  // we are and the goal) that it's worth reconsidering.
+  bool TouchesPlan(const bman::GameState& game_state,
+                   const bman::GameEvent& event, const Point2i& pos) const;
 
-  void MaybeCreateNewPlan(bool reached_waypoint, const GridMap& grid_map,
-                          const Point2i& pos, int player_strength);
+  void MaybeCreateNewPlan(bool reached_waypoint, const WorldAnalysis& analysis,
+                          const Point2i& pos, int player_strength,
+                          double deadline_millis);
+  // Finds another safe way to the goal of the current plan (e.g., when a bomb
+  // has been placed in the way). Returns false if there is none.
+  bool RepairPlan(const WorldAnalysis& analysis, const Point2i& pos);
 
   bman::GameConfig game_config_;
   const int player_index_;
-
-  double replan_prob_;
+  std::shared_ptr<WorldAnalysisCache> analysis_cache_;
 
   std::deque<PlanPoint> plan_;
+  // Something happened near the plan since it was made, replan at the next
+  // waypoint.
+  bool plan_dirty_ = false;
+  // Paths to the goal of plan_, repaired incrementally as the map changes.
+  PathPlanner planner_;
 };
 
 #endif
@@ -0,0 +1,135 @@
+#include "snapshot_buffer.h"
+
+#include "constants.h"
+#include <algorithm>
+#include <cmath>
+
+namespace bman {
+namespace {
+
+int Lerp(int a, int b, double t) { return a + (int)std::lround((b - a) * t); }
+
+// Find the bomb in next that corresponds to the moving bomb in prev (bombs
+// carry no id, so match on owner and proximity).
+const LevelState::Bomb* FindMatchingBomb(const LevelState::Bomb& bomb,
+                                         const GameState& next) {
+  const LevelState::Bomb* best = nullptr;
+  int best_dist = 2 * kSubpixelSize;
+  for (const auto& other : next.level().bombs()) {
+    if (other.player_id() != bomb.player_id())
+      continue;
+    const int x = other.has_moving_x()
+                      ? other.moving_x()
+                      : other.x() * kSubpixelSize + kSubpixelSize / 2;
+    const int y = other.has_moving_y()
+                      ? other.moving_y()
+                      : other.y() * kSubpixelSize + kSubpixelSize / 2;
+    const int dist = abs(x - bomb.moving_x()) + abs(y - bomb.moving_y());
+    if (dist <= best_dist) {
+      best_dist = dist;
+      best = &other;
+    }
+  }
+  return best;
+}
+
+} // namespace
+
+void SnapshotBuffer::Push(const GameState& state, double arrival_ms) {
+  if (!state.has_clock())
+    return;
+  if (!snapshots_.empty() &&
+      state.clock() <= snapshots_.back().clock()) {
+    return;
+  }
+
+  // Track the offset between local time and the server clock, and how much
+  // individual arrivals deviate from it (as in RFC 3550's jitter estimate).
+  const double offset = arrival_ms - state.clock() * tick_ms_;
+  if (!has_offset_) {
+    offset_ms_ = offset;
+    has_offset_ = true;
+  } else {
+    const double deviation = offset - offset_ms_;
+    offset_ms_ += deviation / 16.0;
+    jitter_ms_ += (std::fabs(deviation) - jitter_ms_) / 16.0;
+  }
+
+  snapshots_.push_back(state);
+  while ((int)snapshots_.size() > kMaxSnapshots) {
+    snapshots_.pop_front();
+  }
+}
+
+double SnapshotBuffer::delay_ticks() const {
+  const double delay = kMinDelayTicks + kJitterMultiple * jitter_ms_ / tick_ms_;
+  return std::min(kMaxDelayTicks, delay);
+}
+
+bool SnapshotBuffer::Sample(double now_ms, GameState* state) {
+  if (snapshots_.empty())
+    return false;
+
+  const double render_clock = (now_ms - offset_ms_) / tick_ms_ - delay_ticks();
+
+  // Keep the newest snapshot at or before the render clock as the front.
+  while (snapshots_.size() >= 2 &&
+         snapshots_[1].clock() <= render_clock) {
+    snapshots_.pop_front();
+  }
+
+  const GameState& a = snapshots_.front();
+  if (snapshots_.size() == 1 || render_clock <= a.clock()) {
+    *state = a;
+  } else {
+    const GameState& b = snapshots_[1];
+    const double t = (render_clock - a.clock()) / (b.clock() - a.clock());
+    Interpolate(a, b, std::min(1.0, t), state);
+  }
+
+  // The local player is never delayed.
+  const GameState& newest = snapshots_.back();
+  if (local_player_index_ >= 0 &&
+      local_player_index_ < state->players_size() &&
+      local_player_index_ < newest.players_size()) {
+    *state->mutable_players(local_player_index_) =
+        newest.players(local_player_index_);
+  }
+  return true;
+}
+
+void SnapshotBuffer::Interpolate(const GameState& a, const GameState& b,
+                                 double t, GameState* out) const {
+  *out = a;
+  const int num_players = std::min(a.players_size(), b.players_size());
+  for (int i = 0; i < num_players; ++i) {
+    const auto& pa = a.players(i);
+    const auto& pb = b.players(i);
+    // Don't slide players across the map when they respawn.
+    if (pa.state() != pb.state() || abs(pa.x() - pb.x()) > kSubpixelSize ||
+        abs(pa.y() - pb.y()) > kSubpixelSize) {
+      continue;
+    }
+    auto* player = out->mutable_players(i);
+    player->set_x(Lerp(pa.x(), pb.x(), t));
+    player->set_y(Lerp(pa.y(), pb.y(), t));
+  }
+
+  for (auto& bomb : *out->mutable_level()->mutable_bombs()) {
+    if (!bomb.has_moving_x() || !bomb.has_moving_y())
+      continue;
+    const LevelState::Bomb* next = FindMatchingBomb(bomb, b);
+    if (!next)
+      continue;
+    const int x = next->has_moving_x()
+                      ? next->moving_x()
+                      : next->x() * kSubpixelSize + kSubpixelSize / 2;
+    const int y = next->has_moving_y()
+                      ? next->moving_y()
+                      : next->y() * kSubpixelSize + kSubpixelSize / 2;
+    bomb.set_moving_x(Lerp(bomb.moving_x(), x, t));
+    bomb.set_moving_y(Lerp(bomb.moving_y(), y, t));
+  }
+}
+
+} // namespace bman
@@ -0,0 +1,59 @@
+#ifndef BMAN_SNAPSHOT_BUFFER_H
+#define BMAN_SNAPSHOT_BUFFER_H
+
+#include <deque>
+
+#include "level.grpc.pb.h"
+
+namespace bman {
+
+// A client-side jitter buffer of GameState snapshots received from the
+// server. Rendering samples the buffer at a point in time that trails the
+// newest snapshot by an adaptive delay, interpolating remote players and
+// moving (kicked) bombs between the two snapshots that bracket it. The delay
+// grows with the measured arrival jitter so that there is usually a newer
+// snapshot to interpolate towards.
+class SnapshotBuffer {
+public:
+  explicit SnapshotBuffer(int local_player_index = -1,
+                          double tick_ms = 1000.0 / 60)
+      : local_player_index_(local_player_index), tick_ms_(tick_ms) {}
+
+  // Add a snapshot that arrived at local time arrival_ms. Snapshots that are
+  // not newer than the newest buffered one are ignored.
+  void Push(const GameState& state, double arrival_ms);
+
+  // Fill in the state to render at local time now_ms. Returns false if no
+  // snapshot has been received yet.
+  bool Sample(double now_ms, GameState* state);
+
+  void set_local_player_index(int index) { local_player_index_ = index; }
+
+  // Smoothed deviation of arrival times from the server clock (ms).
+  double jitter_ms() const { return jitter_ms_; }
+  // How far behind the newest snapshot rendering happens (in ticks).
+  double delay_ticks() const;
+  int size() const { return snapshots_.size(); }
+
+  static constexpr int kMaxSnapshots = 64;
+  static constexpr double kMinDelayTicks = 1.0;
+  static constexpr double kMaxDelayTicks = 12.0;
+  // Number of jitter deviations to buffer against.
+  static constexpr double kJitterMultiple = 2.0;
+
+private:
+  void Interpolate(const GameState& a, const GameState& b, double t,
+                   GameState* out) const;
+
+  std::deque<GameState> snapshots_;
+  int local_player_index_;
+  double tick_ms_;
+  // Local time at which server clock 0 would have arrived.
+  double offset_ms_ = 0;
+  bool has_offset_ = false;
+  double jitter_ms_ = 0;
+};
+
+} // namespace bman
+
+#endif
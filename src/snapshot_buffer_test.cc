@@ -0,0 +1,94 @@
+
+#include <gtest/gtest.h>
+
+#include "constants.h"
+#include "level.grpc.pb.h"
+#include "snapshot_buffer.h"
+
+class SnapshotBufferTest : public testing::Test {
+public:
+  static constexpr double kTickMs = 10;
+
+  bman::GameState MakeState(int clock, int x) {
+    bman::GameState state;
+    state.set_clock(clock);
+    for (int i = 0; i < 2; ++i) {
+      auto* player = state.add_players();
+      player->set_x(x);
+      player->set_y(kSubpixelSize / 2);
+    }
+    return state;
+  }
+
+  bman::SnapshotBuffer buffer_{/*local_player_index=*/0, kTickMs};
+};
+
+TEST_F(SnapshotBufferTest, TestEmpty) {
+  bman::GameState state;
+  EXPECT_FALSE(buffer_.Sample(0, &state));
+}
+
+TEST_F(SnapshotBufferTest, TestInterpolateRemotePlayer) {
+  buffer_.Push(MakeState(0, 32), 1000);
+  buffer_.Push(MakeState(1, 42), 1000 + kTickMs);
+
+  // No jitter, so rendering trails the newest snapshot by the minimum delay.
+  EXPECT_EQ(0, buffer_.jitter_ms());
+  EXPECT_EQ(bman::SnapshotBuffer::kMinDelayTicks, buffer_.delay_ticks());
+
+  bman::GameState state;
+  EXPECT_TRUE(buffer_.Sample(1000 + 1.5 * kTickMs, &state));
+  EXPECT_EQ(37, state.players(1).x());
+
+  // Local player is always taken from the newest snapshot.
+  EXPECT_EQ(42, state.players(0).x());
+}
+
+TEST_F(SnapshotBufferTest, TestIgnoresStaleSnapshots) {
+  buffer_.Push(MakeState(2, 32), 1000);
+  buffer_.Push(MakeState(1, 64), 1000);
+  buffer_.Push(MakeState(2, 64), 1000);
+  EXPECT_EQ(1, buffer_.size());
+}
+
+TEST_F(SnapshotBufferTest, TestNoInterpolationOnRespawn) {
+  buffer_.Push(MakeState(0, 32), 1000);
+  buffer_.Push(MakeState(1, 32 + 10 * kSubpixelSize), 1000 + kTickMs);
+
+  bman::GameState state;
+  EXPECT_TRUE(buffer_.Sample(1000 + 1.5 * kTickMs, &state));
+  EXPECT_EQ(32, state.players(1).x());
+}
+
+TEST_F(SnapshotBufferTest, TestDelayAdaptsToJitter) {
+  double arrival = 1000;
+  for (int clock = 0; clock < 100; ++clock) {
+    // Snapshots arrive in bursts of two.
+    arrival += (clock % 2) ? 0 : 2 * kTickMs;
+    buffer_.Push(MakeState(clock, 32), arrival);
+  }
+  EXPECT_GT(buffer_.jitter_ms(), kTickMs / 4);
+  EXPECT_GT(buffer_.delay_ticks(), bman::SnapshotBuffer::kMinDelayTicks);
+  EXPECT_LE(buffer_.delay_ticks(), bman::SnapshotBuffer::kMaxDelayTicks);
+}
+
+TEST_F(SnapshotBufferTest, TestInterpolateMovingBomb) {
+  bman::GameState a = MakeState(0, 32);
+  auto* bomb = a.mutable_level()->add_bombs();
+  bomb->set_player_id(1);
+  bomb->set_dir(bman::DIR_RIGHT);
+  bomb->set_moving_x(100);
+  bomb->set_moving_y(32);
+  bman::GameState b = a;
+  b.set_clock(1);
+  b.mutable_level()->mutable_bombs(0)->set_moving_x(100 + kBombSpeed * 2);
+
+  buffer_.Push(a, 1000);
+  buffer_.Push(b, 1000 + kTickMs);
+
+  bman::GameState state;
+  EXPECT_TRUE(buffer_.Sample(1000 + 1.5 * kTickMs, &state));
+  EXPECT_EQ(100 + kBombSpeed, state.level().bombs(0).moving_x());
+}
+
+int main() { return RUN_ALL_TESTS(); }
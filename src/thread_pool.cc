@@ -0,0 +1,155 @@
+#include "thread_pool.h"
+
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace bman {
+
+// The worker that the current thread is running (if any).
+static thread_local ThreadPool* current_pool = nullptr;
+static thread_local int current_worker = -1;
+
+ThreadPool::ThreadPool(int num_threads, bool pin_threads) : num_steals_(0) {
+  pthread_mutex_init(&mutex_, nullptr);
+  pthread_cond_init(&work_cond_, nullptr);
+  pthread_cond_init(&done_cond_, nullptr);
+  for (int i = 0; i < std::max(1, num_threads); ++i) {
+    workers_.emplace_back(new Worker);
+    workers_.back()->pool = this;
+    workers_.back()->index = i;
+    pthread_mutex_init(&workers_.back()->mutex, nullptr);
+  }
+  const int num_cpus = std::max<int>(1, sysconf(_SC_NPROCESSORS_ONLN));
+  for (auto& worker : workers_) {
+    pthread_create(&worker->thread, nullptr, &ThreadPool::StaticLoop,
+                   worker.get());
+    if (pin_threads) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(worker->index % num_cpus, &cpus);
+      pthread_setaffinity_np(worker->thread, sizeof(cpus), &cpus);
+    }
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  Wait();
+  pthread_mutex_lock(&mutex_);
+  stop_ = true;
+  pthread_cond_broadcast(&work_cond_);
+  pthread_mutex_unlock(&mutex_);
+  for (auto& worker : workers_) {
+    pthread_join(worker->thread, nullptr);
+    pthread_mutex_destroy(&worker->mutex);
+  }
+  pthread_cond_destroy(&done_cond_);
+  pthread_cond_destroy(&work_cond_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+void ThreadPool::Schedule(std::function<void()> task) {
+  pthread_mutex_lock(&mutex_);
+  const int index = current_pool == this
+                        ? current_worker
+                        : next_worker_++ % (int)workers_.size();
+  num_pending_++;
+  pthread_mutex_unlock(&mutex_);
+
+  Worker* worker = workers_[index].get();
+  pthread_mutex_lock(&worker->mutex);
+  worker->tasks.push_back(std::move(task));
+  pthread_mutex_unlock(&worker->mutex);
+
+  pthread_mutex_lock(&mutex_);
+  num_queued_++;
+  pthread_cond_signal(&work_cond_);
+  pthread_mutex_unlock(&mutex_);
+}
+
+void ThreadPool::ScheduleOn(int index, std::function<void()> task) {
+  pthread_mutex_lock(&mutex_);
+  num_pending_++;
+  workers_[index % workers_.size()]->own_tasks.push_back(std::move(task));
+  // Signalling might wake a worker that can't run it.
+  pthread_cond_broadcast(&work_cond_);
+  pthread_mutex_unlock(&mutex_);
+}
+
+void ThreadPool::Wait() {
+  pthread_mutex_lock(&mutex_);
+  while (num_pending_ > 0) {
+    pthread_cond_wait(&done_cond_, &mutex_);
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+void* ThreadPool::StaticLoop(void* data) {
+  Worker* worker = static_cast<Worker*>(data);
+  current_pool = worker->pool;
+  current_worker = worker->index;
+  worker->pool->Loop(worker->index);
+  return nullptr;
+}
+
+void ThreadPool::Loop(int index) {
+  while (true) {
+    // Claim a queued task before looking for it, so there is always one to
+    // find.
+    Worker* own = workers_[index].get();
+    pthread_mutex_lock(&mutex_);
+    while (!stop_ && num_queued_ == 0 && own->own_tasks.empty()) {
+      pthread_cond_wait(&work_cond_, &mutex_);
+    }
+    std::function<void()> task;
+    if (!own->own_tasks.empty()) {
+      task = std::move(own->own_tasks.front());
+      own->own_tasks.pop_front();
+      pthread_mutex_unlock(&mutex_);
+    } else if (num_queued_ == 0) {
+      pthread_mutex_unlock(&mutex_);
+      return;
+    } else {
+      num_queued_--;
+      pthread_mutex_unlock(&mutex_);
+      while (!TakeTask(index, &task)) {
+      }
+    }
+    task();
+
+    pthread_mutex_lock(&mutex_);
+    if (--num_pending_ == 0) {
+      pthread_cond_broadcast(&done_cond_);
+    }
+    pthread_mutex_unlock(&mutex_);
+  }
+}
+
+bool ThreadPool::TakeTask(int index, std::function<void()>* task) {
+  Worker* own = workers_[index].get();
+  pthread_mutex_lock(&own->mutex);
+  if (!own->tasks.empty()) {
+    *task = std::move(own->tasks.back());
+    own->tasks.pop_back();
+    pthread_mutex_unlock(&own->mutex);
+    return true;
+  }
+  pthread_mutex_unlock(&own->mutex);
+
+  for (size_t i = 1; i < workers_.size(); ++i) {
+    Worker* victim = workers_[(index + i) % workers_.size()].get();
+    pthread_mutex_lock(&victim->mutex);
+    if (!victim->tasks.empty()) {
+      *task = std::move(victim->tasks.front());
+      victim->tasks.pop_front();
+      pthread_mutex_unlock(&victim->mutex);
+      num_steals_++;
+      return true;
+    }
+    pthread_mutex_unlock(&victim->mutex);
+  }
+  return false;
+}
+
+} // namespace bman
@@ -0,0 +1,72 @@
+#ifndef BMAN_THREAD_POOL_H
+#define BMAN_THREAD_POOL_H
+
+#include <pthread.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace bman {
+
+// A fixed-size pool of worker threads with a task queue per worker. Tasks
+// scheduled from a worker go to the back of its own queue (and are run
+// LIFO, while they're hot), idle workers steal from the front of the other
+// queues. Tasks scheduled from outside the pool are dealt to the workers in
+// turn, so scheduling one task per worker at a time gives each worker the
+// same share every time (unless it's stolen).
+class ThreadPool {
+public:
+  // With pin_threads, worker i only runs on CPU i (modulo the number of
+  // CPUs), so that it keeps its caches warm for the tasks ScheduleOn gives
+  // it.
+  explicit ThreadPool(int num_threads, bool pin_threads = false);
+  ~ThreadPool();
+
+  void Schedule(std::function<void()> task);
+  // Runs the task on worker index (modulo the number of workers): it isn't
+  // stolen, so the same share of work scheduled on the same worker each
+  // time stays on its CPU.
+  void ScheduleOn(int index, std::function<void()> task);
+
+  // Blocks until every scheduled task, including those scheduled by other
+  // tasks, has finished. Must not be called from a task.
+  void Wait();
+
+  int num_threads() const { return workers_.size(); }
+  int64_t num_steals() const { return num_steals_; }
+
+private:
+  struct Worker {
+    ThreadPool* pool;
+    int index;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    std::deque<std::function<void()>> tasks;
+    // Of ScheduleOn (guarded by the pool's mutex_).
+    std::deque<std::function<void()>> own_tasks;
+  };
+
+  static void* StaticLoop(void* worker);
+  void Loop(int index);
+  // Takes a task from the worker's own queue or steals one.
+  bool TakeTask(int index, std::function<void()>* task);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t work_cond_;
+  pthread_cond_t done_cond_;
+  // Tasks in the queues, and tasks that haven't finished (guarded by
+  // mutex_).
+  int num_queued_ = 0;
+  int num_pending_ = 0;
+  int next_worker_ = 0;
+  bool stop_ = false;
+  std::atomic<int64_t> num_steals_;
+};
+
+} // namespace bman
+
+#endif
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <vector>
+
+#include "thread_pool.h"
+
+TEST(ThreadPoolTest, TestRunsAllTasks) {
+  bman::ThreadPool pool(4);
+  std::atomic<int> count(0);
+  for (int i = 0; i < 100; ++i) {
+    pool.Schedule([&count] { count++; });
+  }
+  pool.Wait();
+  EXPECT_EQ(100, count);
+}
+
+TEST(ThreadPoolTest, TestWaitsForNestedTasks) {
+  bman::ThreadPool pool(2);
+  std::atomic<int> count(0);
+  // Each task schedules the next one, Wait() has to see the whole chain.
+  std::function<void(int)> chain = [&](int remaining) {
+    count++;
+    if (remaining > 0) {
+      pool.Schedule([&chain, remaining] { chain(remaining - 1); });
+    }
+  };
+  pool.Schedule([&chain] { chain(50); });
+  pool.Wait();
+  EXPECT_EQ(51, count);
+}
+
+TEST(ThreadPoolTest, TestReusable) {
+  bman::ThreadPool pool(3);
+  std::atomic<int> count(0);
+  for (int round = 0; round < 10; ++round) {
+    for (int i = 0; i < 10; ++i) {
+      pool.Schedule([&count] { count++; });
+    }
+    pool.Wait();
+    EXPECT_EQ(10 * (round + 1), count);
+  }
+}
+
+TEST(ThreadPoolTest, TestDestructorFinishesTasks) {
+  std::atomic<int> count(0);
+  {
+    bman::ThreadPool pool(2);
+    for (int i = 0; i < 20; ++i) {
+      pool.Schedule([&count] { count++; });
+    }
+  }
+  EXPECT_EQ(20, count);
+}
+
+TEST(ThreadPoolTest, TestScheduleOnRunsOnTheWorker) {
+  bman::ThreadPool pool(3);
+  std::vector<pthread_t> threads(30);
+  for (int round = 0; round < 10; ++round) {
+    for (int i = 0; i < 3; ++i) {
+      pool.ScheduleOn(i, [&threads, round, i] {
+        threads[3 * round + i] = pthread_self();
+      });
+    }
+    // Work that can go anywhere, to tempt idle workers to steal.
+    for (int i = 0; i < 10; ++i) {
+      pool.Schedule([] {});
+    }
+    pool.Wait();
+  }
+  for (int round = 1; round < 10; ++round) {
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_TRUE(pthread_equal(threads[i], threads[3 * round + i]));
+    }
+  }
+  EXPECT_FALSE(pthread_equal(threads[0], threads[1]));
+}
+
+int main() { return RUN_ALL_TESTS(); }
@@ -2,7 +2,6 @@
 #define BMAN_TIMER_H
 
 #include <stdio.h>
-#include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -17,17 +16,22 @@ class Timer {
 public:
   Timer(void) { Start(); }
 
-  void Start() { gettimeofday(&start_time_, nullptr); }
+  void Start() { start_millis_ = NowMillis(); }
+  double ElapsedMillis() const { return NowMillis() - start_millis_; }
   void Wait(int64_t ms_to_wait) {
-    struct timeval tv, elapsed_time;
-    gettimeofday(&tv, nullptr);
-    timersub(&tv, &start_time_, &elapsed_time);
-    int64_t millis =
-        ms_to_wait - (elapsed_time.tv_sec * 1000 + elapsed_time.tv_usec / 1000);
+    int64_t millis = ms_to_wait - static_cast<int64_t>(ElapsedMillis());
     if (millis >= 2)
       Timer::SleepMillis(millis);
   }
 
+  // Monotonic time in (fractional) milliseconds, for deadlines and
+  // intervals; not the time of day, and unaffected by changes to it.
+  static double NowMillis() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+  }
+
   static void SleepMillis(int32_t ms) {
     useconds_t usec = ((useconds_t)ms) * 1000;
 #ifdef __EMSCRIPTEN__
@@ -38,7 +42,7 @@ public:
   }
 
 private:
-  struct timeval start_time_;
+  double start_millis_;
 };
 } // namespace bman
 
@@ -0,0 +1,241 @@
+#include "tournament.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+#include "game.h"
+#include "glog/logging.h"
+#include "level_generator.h"
+#include "thread_pool.h"
+
+namespace bman {
+
+namespace {
+
+// Prior used by FitElo: each agent gets a draw against an average opponent,
+// which keeps the ratings finite for agents that never (or always) win.
+const double kPriorGames = 1;
+const int kMaxEloIterations = 1000;
+
+double Percentile(std::vector<double> values, double p) {
+  std::sort(values.begin(), values.end());
+  const int index = std::min<int>(values.size() - 1, p * values.size());
+  return values[index];
+}
+
+} // namespace
+
+void Tournament::AddAgent(const std::string& name, AgentFactory factory) {
+  names_.push_back(name);
+  factories_.push_back(factory);
+}
+
+const std::vector<MatchResult>& Tournament::Run() {
+  CHECK(!factories_.empty());
+  results_.assign(options_.num_matches, MatchResult());
+  ThreadPool pool(options_.num_threads);
+  for (int m = 0; m < options_.num_matches; ++m) {
+    pool.Schedule([this, m] {
+      const uint32_t seed = MatchSeed(m);
+      results_[m] = PlayMatch(seed, ChooseSeats(seed));
+    });
+  }
+  pool.Wait();
+  return results_;
+}
+
+uint32_t Tournament::MatchSeed(int match) const {
+  std::seed_seq seq = {options_.seed, static_cast<uint32_t>(match)};
+  uint32_t seed;
+  seq.generate(&seed, &seed + 1);
+  return seed;
+}
+
+std::vector<int> Tournament::ChooseSeats(uint32_t seed) const {
+  std::vector<int> order(factories_.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::mt19937 rng(seed);
+  std::shuffle(order.begin(), order.end(), rng);
+  std::vector<int> seats(options_.num_players);
+  for (int i = 0; i < options_.num_players; ++i) {
+    seats[i] = order[i % order.size()];
+  }
+  return seats;
+}
+
+MatchResult Tournament::PlayMatch(uint32_t seed,
+                                  const std::vector<int>& seats) const {
+  Game game;
+  if (options_.random_levels) {
+    LevelGenerator::Options level_options;
+    level_options.num_players = options_.num_players;
+    game.BuildLevel(LevelGenerator(level_options).Generate(seed));
+  } else {
+    game.BuildSimpleLevel(2);
+  }
+  for (size_t i = 0; i < seats.size(); ++i) {
+    game.AddPlayer();
+  }
+  std::vector<std::unique_ptr<Agent>> agents;
+  for (size_t i = 0; i < seats.size(); ++i) {
+    agents.push_back(factories_[seats[i]](game.config(), i));
+    std::seed_seq seq = {seed, static_cast<uint32_t>(i)};
+    uint32_t agent_seed;
+    seq.generate(&agent_seed, &agent_seed + 1);
+    agents.back()->Seed(agent_seed);
+  }
+
+  MatchResult result;
+  result.seed = seed;
+  result.agents = seats;
+  result.deaths.assign(seats.size(), 0);
+  std::vector<bman::MovePlayerRequest> moves(seats.size());
+  for (int tick = 0; tick < options_.num_ticks; ++tick) {
+    for (size_t i = 0; i < agents.size(); ++i) {
+      moves[i] = agents[i]->GetPlayerAction(game.game_state());
+    }
+    game.Step(moves);
+    for (const auto& event : game.game_state().events()) {
+      if (event.type() == bman::GameEvent::EVENT_PLAYER_DIED) {
+        result.deaths[event.player_id()]++;
+      }
+    }
+  }
+  result.scores.assign(game.game_state().score().begin(),
+                       game.game_state().score().end());
+  return result;
+}
+
+std::vector<AgentStats> Tournament::Stats() const {
+  const int num_agents = names_.size();
+  std::vector<AgentStats> stats(num_agents);
+  std::vector<std::vector<double>> scores(num_agents);
+  for (int a = 0; a < num_agents; ++a) {
+    stats[a].name = names_[a];
+  }
+  for (const auto& result : results_) {
+    const int best = *std::max_element(result.scores.begin(),
+                                       result.scores.end());
+    const int num_best =
+        std::count(result.scores.begin(), result.scores.end(), best);
+    for (size_t i = 0; i < result.agents.size(); ++i) {
+      AgentStats& agent = stats[result.agents[i]];
+      agent.num_games++;
+      agent.mean_deaths += result.deaths[i];
+      if (result.scores[i] == best) {
+        agent.wins += 1.0 / num_best;
+      }
+      scores[result.agents[i]].push_back(result.scores[i]);
+    }
+  }
+
+  for (int a = 0; a < num_agents; ++a) {
+    AgentStats& agent = stats[a];
+    if (!agent.num_games)
+      continue;
+    const double n = agent.num_games;
+    agent.win_rate = agent.wins / n;
+    agent.win_rate_error =
+        1.96 * std::sqrt(agent.win_rate * (1 - agent.win_rate) / n);
+    agent.mean_deaths /= n;
+    agent.mean_score =
+        std::accumulate(scores[a].begin(), scores[a].end(), 0.0) / n;
+    double variance = 0;
+    for (double score : scores[a]) {
+      variance += (score - agent.mean_score) * (score - agent.mean_score);
+    }
+    agent.stddev_score = std::sqrt(variance / n);
+    agent.min_score = Percentile(scores[a], 0);
+    agent.p10_score = Percentile(scores[a], 0.1);
+    agent.median_score = Percentile(scores[a], 0.5);
+    agent.p90_score = Percentile(scores[a], 0.9);
+    agent.max_score = Percentile(scores[a], 1);
+  }
+
+  // Confidence intervals from refitting the ratings to the matches
+  // resampled with replacement.
+  const std::vector<double> elo = FitElo(num_agents, results_);
+  std::vector<std::vector<double>> samples(num_agents);
+  std::mt19937 rng(options_.seed);
+  std::uniform_int_distribution<int> random_match(0, results_.size() - 1);
+  std::vector<MatchResult> resampled(results_.size());
+  for (int b = 0; b < options_.num_bootstrap && !results_.empty(); ++b) {
+    for (auto& result : resampled) {
+      result = results_[random_match(rng)];
+    }
+    const std::vector<double> sample = FitElo(num_agents, resampled);
+    for (int a = 0; a < num_agents; ++a) {
+      samples[a].push_back(sample[a]);
+    }
+  }
+  for (int a = 0; a < num_agents; ++a) {
+    stats[a].elo = stats[a].elo_low = stats[a].elo_high = elo[a];
+    if (!samples[a].empty()) {
+      stats[a].elo_low = Percentile(samples[a], 0.025);
+      stats[a].elo_high = Percentile(samples[a], 0.975);
+    }
+  }
+  return stats;
+}
+
+std::vector<double>
+Tournament::FitElo(int num_agents, const std::vector<MatchResult>& results) {
+  // Wins and games between each pair of agents.
+  std::vector<double> wins(num_agents, 0.5 * kPriorGames);
+  std::vector<std::vector<double>> games(num_agents,
+                                         std::vector<double>(num_agents, 0));
+  for (const auto& result : results) {
+    for (size_t i = 0; i < result.agents.size(); ++i) {
+      for (size_t j = i + 1; j < result.agents.size(); ++j) {
+        const int a = result.agents[i], b = result.agents[j];
+        if (a == b)
+          continue;
+        games[a][b]++;
+        games[b][a]++;
+        if (result.scores[i] > result.scores[j]) {
+          wins[a]++;
+        } else if (result.scores[i] < result.scores[j]) {
+          wins[b]++;
+        } else {
+          wins[a] += 0.5;
+          wins[b] += 0.5;
+        }
+      }
+    }
+  }
+
+  // Minorization-maximization updates of the Bradley-Terry strengths (the
+  // prior opponent has strength 1).
+  std::vector<double> strength(num_agents, 1);
+  for (int iter = 0; iter < kMaxEloIterations; ++iter) {
+    double max_change = 0;
+    for (int a = 0; a < num_agents; ++a) {
+      double denominator = kPriorGames / (strength[a] + 1);
+      for (int b = 0; b < num_agents; ++b) {
+        if (games[a][b] > 0) {
+          denominator += games[a][b] / (strength[a] + strength[b]);
+        }
+      }
+      const double updated = wins[a] / denominator;
+      max_change = std::max(max_change, std::abs(std::log(updated / strength[a])));
+      strength[a] = updated;
+    }
+    if (max_change < 1e-9)
+      break;
+  }
+
+  std::vector<double> elo(num_agents);
+  double mean = 0;
+  for (int a = 0; a < num_agents; ++a) {
+    elo[a] = 400 * std::log10(strength[a]);
+    mean += elo[a] / num_agents;
+  }
+  for (double& rating : elo) {
+    rating += 1500 - mean;
+  }
+  return elo;
+}
+
+} // namespace bman
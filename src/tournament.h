@@ -0,0 +1,103 @@
+#ifndef BMAN_TOURNAMENT_H
+#define BMAN_TOURNAMENT_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "agent.h"
+#include "level.grpc.pb.h"
+
+namespace bman {
+
+// Creates the agent that plays as player_index.
+using AgentFactory = std::function<std::unique_ptr<Agent>(
+    const bman::GameConfig& config, int player_index)>;
+
+struct MatchResult {
+  uint32_t seed = 0;
+  // Agent (index into the tournament's agents) in each seat, and how the
+  // seat did.
+  std::vector<int> agents;
+  std::vector<int> scores;
+  std::vector<int> deaths;
+};
+
+// Per-agent summary over all of the seats that an agent played.
+struct AgentStats {
+  std::string name;
+  int num_games = 0;
+  // Ties for the top score share the win.
+  double wins = 0;
+  double win_rate = 0;
+  // Half width of the 95% confidence interval of the win rate.
+  double win_rate_error = 0;
+  double mean_score = 0;
+  double stddev_score = 0;
+  int min_score = 0;
+  int p10_score = 0;
+  int median_score = 0;
+  int p90_score = 0;
+  int max_score = 0;
+  double mean_deaths = 0;
+  // Elo rating and its (bootstrapped) 95% confidence interval.
+  double elo = 0;
+  double elo_low = 0;
+  double elo_high = 0;
+};
+
+// Plays headless matches (Game only, no rendering or networking) between
+// registered agents on a thread pool. Every match is derived from
+// options.seed and its index, and all agents are seeded from the match seed,
+// so results don't depend on the number of threads. Deterministic agents
+// (SimpleAgent, PolicyAgent) play the same game whenever the level and
+// seats repeat, so matches are only independent samples with random_levels.
+class Tournament {
+public:
+  struct Options {
+    int num_matches = 100;
+    int num_players = 4;
+    int num_ticks = 60 * 60;
+    int num_threads = 1;
+    uint32_t seed = 1;
+    // Play each match on a level generated from its seed (see
+    // LevelGenerator) rather than on the simple level.
+    bool random_levels = true;
+    // Resamples used for the rating confidence intervals.
+    int num_bootstrap = 100;
+  };
+
+  explicit Tournament(const Options& options) : options_(options) {}
+
+  void AddAgent(const std::string& name, AgentFactory factory);
+
+  // Plays all of the matches, results are in match order.
+  const std::vector<MatchResult>& Run();
+
+  uint32_t MatchSeed(int match) const;
+  // Seats are filled from a random permutation of the agents (repeated if
+  // there are fewer agents than players), so every agent plays when there
+  // are enough seats.
+  std::vector<int> ChooseSeats(uint32_t seed) const;
+  MatchResult PlayMatch(uint32_t seed, const std::vector<int>& seats) const;
+
+  std::vector<AgentStats> Stats() const;
+  const std::vector<MatchResult>& results() const { return results_; }
+
+  // Elo ratings (averaging 1500) from a Bradley-Terry fit to the results
+  // between every pair of seats with different agents (a higher score is a
+  // win, the same score a draw).
+  static std::vector<double> FitElo(int num_agents,
+                                    const std::vector<MatchResult>& results);
+
+private:
+  Options options_;
+  std::vector<std::string> names_;
+  std::vector<AgentFactory> factories_;
+  std::vector<MatchResult> results_;
+};
+
+} // namespace bman
+
+#endif
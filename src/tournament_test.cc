@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <set>
+
+#include "simple_agent.h"
+#include "tournament.h"
+
+namespace {
+
+bman::MatchResult MakeResult(const std::vector<int>& agents,
+                             const std::vector<int>& scores) {
+  bman::MatchResult result;
+  result.agents = agents;
+  result.scores = scores;
+  result.deaths.assign(agents.size(), 0);
+  return result;
+}
+
+bman::AgentFactory SimpleAgentFactory() {
+  return [](const bman::GameConfig& config, int player_index) {
+    return std::unique_ptr<Agent>(new SimpleAgent(config, player_index));
+  };
+}
+
+} // namespace
+
+TEST(TournamentTest, TestFitEloOrdersAgents) {
+  std::vector<bman::MatchResult> results;
+  for (int i = 0; i < 10; ++i) {
+    results.push_back(MakeResult({0, 1, 2}, {30, 20, 10}));
+  }
+  results.push_back(MakeResult({0, 1, 2}, {10, 20, 30}));
+  const std::vector<double> elo = bman::Tournament::FitElo(3, results);
+  EXPECT_GT(elo[0], elo[1]);
+  EXPECT_GT(elo[1], elo[2]);
+  EXPECT_NEAR(1500, (elo[0] + elo[1] + elo[2]) / 3, 1e-6);
+}
+
+TEST(TournamentTest, TestFitEloDraws) {
+  std::vector<bman::MatchResult> results;
+  for (int i = 0; i < 10; ++i) {
+    results.push_back(MakeResult({0, 1, 0, 1}, {10, 10, 10, 10}));
+  }
+  const std::vector<double> elo = bman::Tournament::FitElo(2, results);
+  EXPECT_NEAR(1500, elo[0], 1e-6);
+  EXPECT_NEAR(1500, elo[1], 1e-6);
+}
+
+TEST(TournamentTest, TestFitEloUnbeaten) {
+  // The prior keeps the ratings finite.
+  std::vector<bman::MatchResult> results = {MakeResult({0, 1}, {10, 0})};
+  const std::vector<double> elo = bman::Tournament::FitElo(2, results);
+  EXPECT_GT(elo[0], elo[1]);
+  EXPECT_LT(elo[0] - elo[1], 800);
+}
+
+TEST(TournamentTest, TestChooseSeats) {
+  bman::Tournament::Options options;
+  options.num_players = 4;
+  bman::Tournament tournament(options);
+  tournament.AddAgent("a", SimpleAgentFactory());
+  tournament.AddAgent("b", SimpleAgentFactory());
+  for (int m = 0; m < 10; ++m) {
+    const std::vector<int> seats =
+        tournament.ChooseSeats(tournament.MatchSeed(m));
+    ASSERT_EQ(4, seats.size());
+    EXPECT_EQ(2, std::count(seats.begin(), seats.end(), 0));
+    EXPECT_EQ(2, std::count(seats.begin(), seats.end(), 1));
+  }
+}
+
+TEST(TournamentTest, TestRunIsReproducible) {
+  bman::Tournament::Options options;
+  options.num_matches = 6;
+  options.num_ticks = 600;
+  options.num_bootstrap = 10;
+
+  std::vector<bman::MatchResult> results[2];
+  for (int run = 0; run < 2; ++run) {
+    options.num_threads = run == 0 ? 1 : 3;
+    bman::Tournament tournament(options);
+    tournament.AddAgent("a", SimpleAgentFactory());
+    tournament.AddAgent("b", SimpleAgentFactory());
+    results[run] = tournament.Run();
+
+    const std::vector<bman::AgentStats> stats = tournament.Stats();
+    ASSERT_EQ(2, stats.size());
+    EXPECT_EQ(12, stats[0].num_games);
+    EXPECT_NEAR(1, (stats[0].wins + stats[1].wins) / options.num_matches,
+                1e-6);
+    EXPECT_LE(stats[0].elo_low, stats[0].elo_high);
+  }
+  ASSERT_EQ(results[0].size(), results[1].size());
+  for (size_t m = 0; m < results[0].size(); ++m) {
+    EXPECT_EQ(results[0][m].seed, results[1][m].seed);
+    EXPECT_EQ(results[0][m].agents, results[1][m].agents);
+    EXPECT_EQ(results[0][m].scores, results[1][m].scores);
+  }
+}
+
+TEST(TournamentTest, TestRandomLevelsVaryDeterministicGames) {
+  bman::Tournament::Options options;
+  options.num_matches = 12;
+  options.num_ticks = 600;
+  std::set<std::pair<std::vector<int>, std::vector<int>>> games[2];
+  for (bool random_levels : {false, true}) {
+    options.random_levels = random_levels;
+    bman::Tournament tournament(options);
+    tournament.AddAgent("a", SimpleAgentFactory());
+    tournament.AddAgent("b", SimpleAgentFactory());
+    for (const auto& result : tournament.Run()) {
+      games[random_levels].insert({result.agents, result.scores});
+    }
+  }
+  // On the simple level, SimpleAgents only play a game per seating.
+  EXPECT_LE(games[0].size(), 6u);
+  EXPECT_GT(games[1].size(), 9u);
+}
+
+int main() { return RUN_ALL_TESTS(); }
@@ -0,0 +1,436 @@
+#include "trajectory.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "game.h"
+#include "glog/logging.h"
+
+namespace bman {
+
+namespace {
+
+using trajectory::Action;
+using trajectory::ChunkHeader;
+using trajectory::FileHeader;
+using trajectory::Footer;
+using trajectory::IndexEntry;
+using trajectory::Step;
+
+constexpr char kFileMagic[4] = {'B', 'M', 'T', 'J'};
+constexpr char kChunkMagic[4] = {'C', 'H', 'N', 'K'};
+constexpr char kIndexMagic[4] = {'B', 'M', 'T', 'I'};
+constexpr uint32_t kVersion = 1;
+
+static_assert(sizeof(FileHeader) == 16, "FileHeader is packed");
+static_assert(sizeof(ChunkHeader) == 32, "ChunkHeader is packed");
+static_assert(sizeof(Step) == 16, "Step is packed");
+static_assert(sizeof(Action) == 8, "Action is packed");
+static_assert(sizeof(IndexEntry) == 24, "IndexEntry is packed");
+static_assert(sizeof(Footer) == 16, "Footer is packed");
+
+size_t Padded(size_t size) { return (size + 3) & ~size_t(3); }
+
+int16_t ClampDelta(int32_t delta) {
+  return std::max<int32_t>(
+      std::numeric_limits<int16_t>::min(),
+      std::min<int32_t>(delta, std::numeric_limits<int16_t>::max()));
+}
+
+} // namespace
+
+TrajectoryWriter::TrajectoryWriter(const bman::GameConfig& config,
+                                   const Options& options)
+    : config_(config), options_(options) {
+  CHECK_GT(options_.chunk_size, 0);
+  if (!options_.observation_shape.empty()) {
+    observation_size_ = 1;
+    for (int size : options_.observation_shape) {
+      observation_size_ *= size;
+    }
+  }
+}
+
+TrajectoryWriter::~TrajectoryWriter() { Close(); }
+
+bool TrajectoryWriter::Open(const std::string& path) {
+  Close();
+  file_ = fopen(path.c_str(), "wb");
+  if (!file_) {
+    LOG(ERROR) << "Unable to create " << path;
+    return false;
+  }
+  failed_ = false;
+  offset_ = 0;
+  index_.clear();
+  num_steps_ = 0;
+  episode_ = -1;
+  steps_.clear();
+
+  const std::string config = config_.SerializeAsString();
+  FileHeader header = {};
+  std::memcpy(header.magic, kFileMagic, sizeof(kFileMagic));
+  header.version = kVersion;
+  header.config_size = config.size();
+  header.num_dims = options_.observation_shape.size();
+  Write(&header, sizeof(header));
+  for (int size : options_.observation_shape) {
+    const uint32_t dim = size;
+    Write(&dim, sizeof(dim));
+  }
+  Write(config.data(), config.size());
+  Write("\0\0\0", Padded(config.size()) - config.size());
+  return !failed_;
+}
+
+bool TrajectoryWriter::Close() {
+  if (!file_) {
+    return true;
+  }
+  if (!steps_.empty()) {
+    Flush(bman::GameState());
+  }
+  Footer footer = {};
+  footer.index_offset = offset_;
+  footer.num_chunks = index_.size();
+  std::memcpy(footer.magic, kIndexMagic, sizeof(kIndexMagic));
+  Write(index_.data(), index_.size() * sizeof(IndexEntry));
+  Write(&footer, sizeof(footer));
+  if (fclose(file_) != 0) {
+    failed_ = true;
+  }
+  file_ = nullptr;
+  if (failed_) {
+    LOG(ERROR) << "Failed to write the trajectory";
+  }
+  return !failed_;
+}
+
+void TrajectoryWriter::Write(const void* data, size_t size) {
+  if (size && fwrite(data, 1, size, file_) != size) {
+    failed_ = true;
+  }
+  offset_ += size;
+}
+
+void TrajectoryWriter::BeginEpisode(const bman::GameState& state) {
+  if (!steps_.empty()) {
+    Flush(state);
+  }
+  episode_++;
+  first_step_ = 0;
+  num_players_ = state.players_size();
+  state_ = state.SerializeAsString();
+}
+
+void TrajectoryWriter::SetState(const bman::GameState& state) {
+  CHECK_GE(episode_, 0) << "SetState called before BeginEpisode";
+  Flush(state);
+}
+
+void TrajectoryWriter::Record(
+    const std::vector<bman::MovePlayerRequest>& moves, int num_frames,
+    int action, float reward, const float* observation, bool done,
+    const bman::GameState& state) {
+  CHECK(file_) << "Record called before Open";
+  CHECK_GE(episode_, 0) << "Record called before BeginEpisode";
+  CHECK_EQ((int)moves.size(), num_players_);
+  Step step = {};
+  step.action_begin = actions_.size();
+  step.action = action;
+  step.reward = reward;
+  step.num_frames = num_frames;
+  step.done = done;
+  steps_.push_back(step);
+  for (int i = 0; i < (int)moves.size(); ++i) {
+    for (const auto& move_action : moves[i].actions()) {
+      Action a = {};
+      // Larger deltas aren't sent by any client, nor replayed the same.
+      a.dx = ClampDelta(move_action.dx());
+      a.dy = ClampDelta(move_action.dy());
+      a.player = i;
+      a.dir = move_action.has_dir() ? static_cast<uint8_t>(move_action.dir())
+                                    : Action::kNoDir;
+      a.flags = (move_action.place_bomb() ? Action::kPlaceBomb : 0) |
+                (move_action.use_powerup() ? Action::kUsePowerup : 0);
+      actions_.push_back(a);
+    }
+  }
+  if (observation_size_) {
+    CHECK(observation) << "Expected an observation";
+    observations_.insert(observations_.end(), observation,
+                         observation + observation_size_);
+  }
+  num_steps_++;
+  if ((int)steps_.size() == options_.chunk_size) {
+    Flush(state);
+  }
+}
+
+void TrajectoryWriter::Flush(const bman::GameState& state) {
+  if (!steps_.empty()) {
+    ChunkHeader header = {};
+    std::memcpy(header.magic, kChunkMagic, sizeof(kChunkMagic));
+    header.episode = episode_;
+    header.first_step = first_step_;
+    header.num_steps = steps_.size();
+    header.num_actions = actions_.size();
+    header.num_players = num_players_;
+    header.state_size = state_.size();
+
+    IndexEntry entry = {};
+    entry.offset = offset_;
+    entry.episode = episode_;
+    entry.first_step = first_step_;
+    entry.num_steps = steps_.size();
+    index_.push_back(entry);
+
+    Write(&header, sizeof(header));
+    Write(state_.data(), state_.size());
+    Write("\0\0\0", Padded(state_.size()) - state_.size());
+    Write(steps_.data(), steps_.size() * sizeof(Step));
+    Write(observations_.data(), observations_.size() * sizeof(float));
+    Write(actions_.data(), actions_.size() * sizeof(Action));
+    first_step_ += steps_.size();
+    steps_.clear();
+    observations_.clear();
+    actions_.clear();
+  }
+  num_players_ = state.players_size();
+  state_ = state.SerializeAsString();
+}
+
+TrajectoryReader::~TrajectoryReader() {
+  if (data_) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+}
+
+bool TrajectoryReader::Open(const std::string& path) {
+  CHECK(!data_) << "Already open";
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(ERROR) << "Unable to open " << path;
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(FileHeader)) {
+    close(fd);
+    LOG(ERROR) << path << " is not a trajectory file";
+    return false;
+  }
+  size_ = st.st_size;
+  void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    LOG(ERROR) << "Unable to map " << path;
+    return false;
+  }
+  data_ = static_cast<const uint8_t*>(data);
+
+  FileHeader header;
+  std::memcpy(&header, data_, sizeof(header));
+  uint64_t offset = sizeof(header) + header.num_dims * sizeof(uint32_t);
+  if (std::memcmp(header.magic, kFileMagic, sizeof(kFileMagic)) != 0 ||
+      header.version != kVersion ||
+      offset + Padded(header.config_size) > size_ ||
+      !config_.ParseFromArray(data_ + offset, header.config_size)) {
+    LOG(ERROR) << path << " is not a trajectory file";
+    return false;
+  }
+  observation_shape_.resize(header.num_dims);
+  std::memcpy(observation_shape_.data(), data_ + sizeof(header),
+              header.num_dims * sizeof(uint32_t));
+  observation_size_ = 0;
+  if (!observation_shape_.empty()) {
+    observation_size_ = 1;
+    for (int size : observation_shape_) {
+      observation_size_ *= size;
+    }
+  }
+  offset += Padded(header.config_size);
+
+  Footer footer;
+  if (size_ >= offset + sizeof(footer)) {
+    std::memcpy(&footer, data_ + size_ - sizeof(footer), sizeof(footer));
+  }
+  if (size_ >= offset + sizeof(footer) &&
+      std::memcmp(footer.magic, kIndexMagic, sizeof(kIndexMagic)) == 0 &&
+      footer.index_offset + footer.num_chunks * sizeof(IndexEntry) +
+              sizeof(footer) ==
+          size_) {
+    for (uint32_t i = 0; i < footer.num_chunks; ++i) {
+      IndexEntry entry;
+      std::memcpy(&entry,
+                  data_ + footer.index_offset + i * sizeof(IndexEntry),
+                  sizeof(entry));
+      uint64_t end;
+      if (!ReadChunk(entry.offset, &end)) {
+        LOG(ERROR) << path << " has a bad index or chunk";
+        return false;
+      }
+    }
+  } else {
+    // Not closed: read the chunks up to the first incomplete one.
+    while (ReadChunk(offset, &offset)) {
+    }
+    LOG(WARNING) << path << " wasn't closed, read " << chunks_.size()
+                 << " chunks";
+  }
+  return true;
+}
+
+bool TrajectoryReader::ReadChunk(uint64_t offset, uint64_t* end) {
+  Chunk chunk;
+  if (offset + sizeof(chunk.header) > size_) {
+    return false;
+  }
+  std::memcpy(&chunk.header, data_ + offset, sizeof(chunk.header));
+  const ChunkHeader& header = chunk.header;
+  if (std::memcmp(header.magic, kChunkMagic, sizeof(kChunkMagic)) != 0) {
+    return false;
+  }
+  const uint64_t state_offset = offset + sizeof(header);
+  const uint64_t steps_offset = state_offset + Padded(header.state_size);
+  const uint64_t observations_offset =
+      steps_offset + uint64_t(header.num_steps) * sizeof(Step);
+  const uint64_t actions_offset =
+      observations_offset +
+      uint64_t(header.num_steps) * observation_size_ * sizeof(float);
+  *end = actions_offset + uint64_t(header.num_actions) * sizeof(Action);
+  if (*end > size_) {
+    return false;
+  }
+  // Everything after the header is 4-byte aligned, as the map is.
+  chunk.begin = num_steps_;
+  chunk.state = data_ + state_offset;
+  chunk.steps = reinterpret_cast<const Step*>(data_ + steps_offset);
+  chunk.observations =
+      reinterpret_cast<const float*>(data_ + observations_offset);
+  chunk.actions = reinterpret_cast<const Action*>(data_ + actions_offset);
+  // Moves indexes with these, so they must be in range.
+  for (uint32_t i = 0; i < header.num_steps; ++i) {
+    if (chunk.steps[i].action_begin > header.num_actions) {
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i < header.num_actions; ++i) {
+    if (chunk.actions[i].player >= header.num_players) {
+      return false;
+    }
+  }
+  if (chunks_.empty() || chunks_.back().header.episode != header.episode) {
+    num_episodes_++;
+  }
+  chunks_.push_back(chunk);
+  num_steps_ += header.num_steps;
+  return true;
+}
+
+int TrajectoryReader::ChunkIndex(int64_t step) const {
+  CHECK(step >= 0 && step < num_steps_) << "No step " << step;
+  const auto it =
+      std::upper_bound(chunks_.begin(), chunks_.end(), step,
+                       [](int64_t s, const Chunk& c) { return s < c.begin; });
+  return it - chunks_.begin() - 1;
+}
+
+const Step& TrajectoryReader::StepOf(int64_t step) const {
+  const Chunk& chunk = chunks_[ChunkIndex(step)];
+  return chunk.steps[step - chunk.begin];
+}
+
+int TrajectoryReader::episode(int64_t step) const {
+  return chunks_[ChunkIndex(step)].header.episode;
+}
+
+const float* TrajectoryReader::observation(int64_t step) const {
+  const Chunk& chunk = chunks_[ChunkIndex(step)];
+  return chunk.observations + (step - chunk.begin) * observation_size_;
+}
+
+std::vector<bman::MovePlayerRequest>
+TrajectoryReader::Moves(int64_t step, int* num_frames) const {
+  const Chunk& chunk = chunks_[ChunkIndex(step)];
+  const int index = step - chunk.begin;
+  const uint32_t begin = chunk.steps[index].action_begin;
+  const uint32_t end = index + 1 < (int)chunk.header.num_steps
+                           ? chunk.steps[index + 1].action_begin
+                           : chunk.header.num_actions;
+  std::vector<bman::MovePlayerRequest> moves(chunk.header.num_players);
+  for (uint32_t i = begin; i < end; ++i) {
+    const Action& a = chunk.actions[i];
+    auto* action = moves[a.player].add_actions();
+    action->set_dx(a.dx);
+    action->set_dy(a.dy);
+    if (a.dir != Action::kNoDir) {
+      action->set_dir(static_cast<bman::Direction>(a.dir));
+    }
+    if (a.flags & Action::kPlaceBomb) {
+      action->set_place_bomb(true);
+    }
+    if (a.flags & Action::kUsePowerup) {
+      action->set_use_powerup(true);
+    }
+  }
+  *num_frames = chunk.steps[index].num_frames;
+  return moves;
+}
+
+bman::GameState TrajectoryReader::State(int64_t step) const {
+  const Chunk& chunk = chunks_[ChunkIndex(step)];
+  bman::GameState state;
+  CHECK(state.ParseFromArray(chunk.state, chunk.header.state_size));
+  Game game(config_, state);
+  for (int64_t s = chunk.begin; s < step; ++s) {
+    int num_frames = 0;
+    std::vector<bman::MovePlayerRequest> moves = Moves(s, &num_frames);
+    game.StepFrames(std::move(moves), num_frames);
+  }
+  return game.game_state();
+}
+
+void TrajectoryReader::ReadBatch(const int64_t* steps, int n,
+                                 float* observations, int32_t* actions,
+                                 float* rewards, uint8_t* dones,
+                                 float* next_observations) const {
+  const size_t size = observation_size_;
+  for (int i = 0; i < n; ++i) {
+    const int c = ChunkIndex(steps[i]);
+    const Chunk& chunk = chunks_[c];
+    const int64_t index = steps[i] - chunk.begin;
+    const Step& step = chunk.steps[index];
+    actions[i] = step.action;
+    rewards[i] = step.reward;
+    dones[i] = step.done;
+    if (!size) {
+      continue;
+    }
+    std::memcpy(observations + i * size,
+                chunk.observations + index * size, size * sizeof(float));
+    // The next step is in this chunk or the first of the next one.
+    const float* next = nullptr;
+    if (!step.done) {
+      if (index + 1 < chunk.header.num_steps) {
+        next = chunk.observations + (index + 1) * size;
+      } else if (c + 1 < (int)chunks_.size() &&
+                 chunks_[c + 1].header.episode == chunk.header.episode) {
+        next = chunks_[c + 1].observations;
+      }
+    }
+    if (next) {
+      std::memcpy(next_observations + i * size, next, size * sizeof(float));
+    } else {
+      std::fill(next_observations + i * size,
+                next_observations + (i + 1) * size, 0.0f);
+    }
+  }
+}
+
+} // namespace bman
@@ -0,0 +1,226 @@
+#ifndef BMAN_TRAJECTORY_H
+#define BMAN_TRAJECTORY_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "level.grpc.pb.h"
+
+namespace bman {
+
+// Trajectory files record games for offline RL: each step's moves (enough
+// to replay it with Game::StepFrames), the recorded agent's action and
+// reward, and optionally the observation it acted on.
+//
+// A file is a header (the GameConfig and observation shape) followed by
+// chunks, appended as they fill, and an index of the chunks written on
+// Close. A chunk holds up to chunk_size steps of one episode as flat
+// arrays, after the GameState at its first step, so the state before any
+// step can be regenerated by replaying at most a chunk. Protos are only
+// serialized once a chunk. Numbers are in native byte order.
+namespace trajectory {
+
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t config_size;
+  uint32_t num_dims;
+  // Followed by num_dims uint32 observation dims, then the config, padded
+  // to 4 bytes.
+};
+
+struct ChunkHeader {
+  char magic[4];
+  uint32_t episode;
+  // Within the episode.
+  uint32_t first_step;
+  uint32_t num_steps;
+  uint32_t num_actions;
+  uint32_t num_players;
+  uint32_t state_size;
+  uint32_t reserved;
+  // Followed by the state padded to 4 bytes, num_steps Steps, num_steps
+  // observations and num_actions Actions.
+};
+
+struct Step {
+  // The step's actions are [action_begin, the next step's action_begin) of
+  // the chunk's.
+  uint32_t action_begin;
+  int32_t action;
+  float reward;
+  uint16_t num_frames;
+  uint8_t done;
+  uint8_t reserved;
+};
+
+// A MovePlayerRequest::Action of a player, in the order of the requests.
+struct Action {
+  int16_t dx;
+  int16_t dy;
+  uint8_t player;
+  // kNoDir if unset.
+  uint8_t dir;
+  uint8_t flags;
+  uint8_t reserved;
+
+  static constexpr uint8_t kNoDir = 0xff;
+  static constexpr uint8_t kPlaceBomb = 1;
+  static constexpr uint8_t kUsePowerup = 2;
+};
+
+struct IndexEntry {
+  uint64_t offset;
+  uint32_t episode;
+  uint32_t first_step;
+  uint32_t num_steps;
+  uint32_t reserved;
+};
+
+// The last bytes of a closed file.
+struct Footer {
+  uint64_t index_offset;
+  uint32_t num_chunks;
+  char magic[4];
+};
+
+} // namespace trajectory
+
+// Writes a trajectory file. Not thread safe: use a writer per env.
+class TrajectoryWriter {
+public:
+  struct Options {
+    // Steps per chunk. Longer chunks save space, shorter ones replay less
+    // to regenerate a state.
+    int chunk_size = 256;
+    // Of each step's observation, empty to not record them.
+    std::vector<int> observation_shape;
+  };
+
+  explicit TrajectoryWriter(const bman::GameConfig& config)
+      : TrajectoryWriter(config, Options()) {}
+  TrajectoryWriter(const bman::GameConfig& config, const Options& options);
+  // Closes the file.
+  ~TrajectoryWriter();
+
+  // Creates the file and writes the header. Returns false on failure.
+  bool Open(const std::string& path);
+  // Writes the last chunk and the index. Returns false if any write failed.
+  bool Close();
+
+  // Starts the next episode from the state.
+  void BeginEpisode(const bman::GameState& state);
+  // Continues the episode from the state, which has been changed other
+  // than by stepping (e.g., a player has been added).
+  void SetState(const bman::GameState& state);
+  // Records a step: the game was stepped from the last recorded state with
+  // Game::StepFrames(moves, num_frames) to the state passed in. action and
+  // reward are the recorded agent's, observation (of observation_shape, or
+  // null if they're not recorded) what it saw before the step.
+  void Record(const std::vector<bman::MovePlayerRequest>& moves,
+              int num_frames, int action, float reward,
+              const float* observation, bool done,
+              const bman::GameState& state);
+
+  int observation_size() const { return observation_size_; }
+  int64_t num_steps() const { return num_steps_; }
+
+private:
+  // Writes the chunk and starts the next one from the state.
+  void Flush(const bman::GameState& state);
+  void Write(const void* data, size_t size);
+
+  const bman::GameConfig config_;
+  const Options options_;
+  int observation_size_ = 0;
+  FILE* file_ = nullptr;
+  bool failed_ = false;
+  uint64_t offset_ = 0;
+  std::vector<trajectory::IndexEntry> index_;
+  int64_t num_steps_ = 0;
+
+  // The chunk being recorded.
+  int episode_ = -1;
+  int first_step_ = 0;
+  int num_players_ = 0;
+  std::string state_;
+  std::vector<trajectory::Step> steps_;
+  std::vector<float> observations_;
+  std::vector<trajectory::Action> actions_;
+};
+
+// Reads a trajectory file through a memory map, so that only the pages of
+// the steps read are loaded. Files that weren't closed are read up to
+// their last complete chunk.
+class TrajectoryReader {
+public:
+  TrajectoryReader() = default;
+  ~TrajectoryReader();
+  TrajectoryReader(const TrajectoryReader&) = delete;
+  TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+  // Maps the file. Returns false if it's missing or not a trajectory file.
+  bool Open(const std::string& path);
+
+  const bman::GameConfig& config() const { return config_; }
+  const std::vector<int>& observation_shape() const {
+    return observation_shape_;
+  }
+  // 0 if observations weren't recorded.
+  int observation_size() const { return observation_size_; }
+  int64_t num_steps() const { return num_steps_; }
+  int num_episodes() const { return num_episodes_; }
+
+  // Of a step in [0, num_steps()), across the episodes.
+  int episode(int64_t step) const;
+  int action(int64_t step) const { return StepOf(step).action; }
+  float reward(int64_t step) const { return StepOf(step).reward; }
+  bool done(int64_t step) const { return StepOf(step).done; }
+  // The step's observation_size() floats, in the map.
+  const float* observation(int64_t step) const;
+  // What to replay the step with: Game::StepFrames(moves, num_frames).
+  std::vector<bman::MovePlayerRequest> Moves(int64_t step,
+                                             int* num_frames) const;
+  // The state before the step, replayed from the start of its chunk.
+  bman::GameState State(int64_t step) const;
+
+  // Fills row i of the arrays with steps[i]'s observation, action, reward,
+  // done and next observation: the following step's in the episode, or
+  // zeros if there isn't one. The observations may be null if they weren't
+  // recorded.
+  void ReadBatch(const int64_t* steps, int n, float* observations,
+                 int32_t* actions, float* rewards, uint8_t* dones,
+                 float* next_observations) const;
+
+private:
+  struct Chunk {
+    trajectory::ChunkHeader header;
+    // Of the chunk's first step in the file.
+    int64_t begin;
+    const uint8_t* state;
+    const trajectory::Step* steps;
+    const float* observations;
+    const trajectory::Action* actions;
+  };
+
+  // Reads the chunk at offset, returns false if it's incomplete.
+  bool ReadChunk(uint64_t offset, uint64_t* end);
+  // The chunk holding the step.
+  int ChunkIndex(int64_t step) const;
+  const trajectory::Step& StepOf(int64_t step) const;
+
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  bman::GameConfig config_;
+  std::vector<int> observation_shape_;
+  int observation_size_ = 0;
+  std::vector<Chunk> chunks_;
+  int64_t num_steps_ = 0;
+  int num_episodes_ = 0;
+};
+
+} // namespace bman
+
+#endif
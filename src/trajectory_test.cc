@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+#include "game.h"
+#include "grid_env.h"
+#include "trajectory.h"
+
+namespace {
+
+// A move of each player, with several actions a tick now and then.
+std::vector<bman::MovePlayerRequest> RandomMoves(int num_players,
+                                                 std::mt19937* rng) {
+  std::uniform_int_distribution<int> random_dir(-1, 3);
+  std::uniform_int_distribution<int> random_count(0, 2);
+  std::vector<bman::MovePlayerRequest> moves(num_players);
+  for (auto& move : moves) {
+    const int count = random_count(*rng);
+    for (int i = 0; i < count; ++i) {
+      auto* action = move.add_actions();
+      const int dir = random_dir(*rng);
+      if (dir >= 0) {
+        const int dx[] = {-4, 4, 0, 0}, dy[] = {0, 0, -4, 4};
+        action->set_dir(static_cast<bman::Direction>(dir));
+        action->set_dx(dx[dir]);
+        action->set_dy(dy[dir]);
+      }
+      action->set_place_bomb((*rng)() % 8 == 0);
+    }
+  }
+  return moves;
+}
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+class TrajectoryTest : public testing::Test {
+public:
+  void SetUp() override {
+    game_.BuildSimpleLevel(2);
+    for (int i = 0; i < 4; ++i) {
+      game_.AddPlayer();
+    }
+    path_ = testing::TempDir() + "/trajectory_test.traj";
+  }
+
+  // Records 2 episodes of num_steps random steps, observing the step number,
+  // and keeps the states before each step.
+  void Record(const bman::TrajectoryWriter::Options& options, int num_steps) {
+    bman::TrajectoryWriter writer(game_.config(), options);
+    ASSERT_TRUE(writer.Open(path_));
+    std::mt19937 rng(1);
+    const bman::GameState initial_state = game_.game_state();
+    for (int episode = 0; episode < 2; ++episode) {
+      game_.set_game_state(initial_state);
+      writer.BeginEpisode(game_.game_state());
+      for (int i = 0; i < num_steps; ++i) {
+        states_.push_back(game_.game_state());
+        const auto moves = RandomMoves(4, &rng);
+        const int num_frames = 1 + rng() % 4;
+        game_.StepFrames(moves, num_frames);
+        const float observation[2] = {float(states_.size()), -1};
+        writer.Record(moves, num_frames, i % 5, 0.5f * i, observation,
+                      i == num_steps - 1, game_.game_state());
+      }
+    }
+    EXPECT_EQ(2 * num_steps, writer.num_steps());
+    ASSERT_TRUE(writer.Close());
+  }
+
+  Game game_;
+  std::string path_;
+  std::vector<bman::GameState> states_;
+};
+
+TEST_F(TrajectoryTest, TestRegeneratesStates) {
+  bman::TrajectoryWriter::Options options;
+  options.chunk_size = 8;
+  options.observation_shape = {2};
+  Record(options, 30);
+
+  bman::TrajectoryReader reader;
+  ASSERT_TRUE(reader.Open(path_));
+  EXPECT_EQ(game_.config().SerializeAsString(),
+            reader.config().SerializeAsString());
+  EXPECT_EQ(std::vector<int>({2}), reader.observation_shape());
+  ASSERT_EQ(60, reader.num_steps());
+  EXPECT_EQ(2, reader.num_episodes());
+  for (int step = 0; step < 60; ++step) {
+    EXPECT_EQ(step / 30, reader.episode(step));
+    EXPECT_EQ(step % 30 % 5, reader.action(step));
+    EXPECT_FLOAT_EQ(0.5f * (step % 30), reader.reward(step));
+    EXPECT_EQ(step % 30 == 29, reader.done(step));
+    EXPECT_EQ(step + 1, reader.observation(step)[0]);
+    // Replayed from the start of the chunk.
+    EXPECT_EQ(states_[step].SerializeAsString(),
+              reader.State(step).SerializeAsString())
+        << "Step " << step;
+  }
+}
+
+TEST_F(TrajectoryTest, TestReadsBatches) {
+  bman::TrajectoryWriter::Options options;
+  options.chunk_size = 8;
+  options.observation_shape = {2};
+  Record(options, 30);
+
+  bman::TrajectoryReader reader;
+  ASSERT_TRUE(reader.Open(path_));
+  // The last of a chunk, the last of an episode and the first of the next.
+  const std::vector<int64_t> steps = {7, 29, 30};
+  std::vector<float> observations(6), next_observations(6);
+  std::vector<int32_t> actions(3);
+  std::vector<float> rewards(3);
+  std::vector<uint8_t> dones(3);
+  reader.ReadBatch(steps.data(), steps.size(), observations.data(),
+                   actions.data(), rewards.data(), dones.data(),
+                   next_observations.data());
+  EXPECT_EQ(std::vector<float>({8, -1, 30, -1, 31, -1}), observations);
+  EXPECT_EQ(std::vector<float>({9, -1, 0, 0, 32, -1}), next_observations);
+  EXPECT_EQ(std::vector<int32_t>({2, 4, 0}), actions);
+  EXPECT_EQ(std::vector<float>({3.5f, 14.5f, 0}), rewards);
+  EXPECT_EQ(std::vector<uint8_t>({0, 1, 0}), dones);
+}
+
+TEST_F(TrajectoryTest, TestReadsUnclosedFiles) {
+  bman::TrajectoryWriter::Options options;
+  options.chunk_size = 8;
+  Record(options, 30);
+
+  // Without the index of the 8 chunks, nor the end of the last one.
+  const std::string data = ReadFile(path_);
+  const std::string truncated_path = path_ + ".truncated";
+  {
+    std::ofstream file(truncated_path, std::ios::binary);
+    file << data.substr(0, data.size() -
+                               8 * sizeof(bman::trajectory::IndexEntry) -
+                               sizeof(bman::trajectory::Footer) - 4);
+  }
+  bman::TrajectoryReader reader;
+  ASSERT_TRUE(reader.Open(truncated_path));
+  EXPECT_EQ(0, reader.observation_size());
+  ASSERT_EQ(54, reader.num_steps());
+  EXPECT_EQ(states_[53].SerializeAsString(),
+            reader.State(53).SerializeAsString());
+
+  bman::TrajectoryReader missing_reader;
+  EXPECT_FALSE(missing_reader.Open(path_ + ".missing"));
+}
+
+TEST_F(TrajectoryTest, TestRejectsActionsOfMissingPlayers) {
+  bman::TrajectoryWriter::Options options;
+  options.chunk_size = 8;
+  Record(options, 30);
+
+  // The last action of the last chunk, just before the index, gets a fifth
+  // player.
+  std::string data = ReadFile(path_);
+  const size_t action_offset = data.size() -
+                               8 * sizeof(bman::trajectory::IndexEntry) -
+                               sizeof(bman::trajectory::Footer) -
+                               sizeof(bman::trajectory::Action);
+  data[action_offset + offsetof(bman::trajectory::Action, player)] = 4;
+  const std::string corrupt_path = path_ + ".corrupt";
+  {
+    std::ofstream file(corrupt_path, std::ios::binary);
+    file << data;
+  }
+  bman::TrajectoryReader reader;
+  EXPECT_FALSE(reader.Open(corrupt_path));
+}
+
+TEST(GridEnvRecordingTest, TestRecordsSteps) {
+  const std::string path = testing::TempDir() + "/grid_env_test.traj";
+  bman::GridEnv env;
+  env.Reset();
+  ASSERT_TRUE(env.StartRecording(path, true));
+  std::vector<bman::GameState> states;
+  std::vector<std::vector<float>> observations;
+  const int actions[] = {1, 3, 4, 0, 0, 2, 2, 1, 1, 1};
+  for (int action : actions) {
+    states.push_back(env.game().game_state());
+    observations.emplace_back(env.observation_size());
+    env.Observe(observations.back().data());
+    bool done = false;
+    env.Step(action, &done);
+    if (done) {
+      env.Reset();
+    }
+  }
+  env.StopRecording();
+
+  bman::TrajectoryReader reader;
+  ASSERT_TRUE(reader.Open(path));
+  ASSERT_EQ((int)states.size(), reader.num_steps());
+  for (int step = 0; step < reader.num_steps(); ++step) {
+    EXPECT_EQ(actions[step], reader.action(step));
+    EXPECT_EQ(states[step].SerializeAsString(),
+              reader.State(step).SerializeAsString());
+    EXPECT_TRUE(std::equal(observations[step].begin(),
+                           observations[step].end(),
+                           reader.observation(step)));
+  }
+}
+
+int main() { return RUN_ALL_TESTS(); }
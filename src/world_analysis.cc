@@ -0,0 +1,146 @@
+#include "world_analysis.h"
+
+#include "constants.h"
+#include "game.h"
+
+namespace {
+// Same neighbour order as the agents' searches.
+const Point2i kNeighbors[4] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+} // namespace
+
+WorldAnalysis::WorldAnalysis(const bman::GameConfig& config,
+                             const bman::GameState& game_state)
+    : WorldAnalysis(config, game_state, GridMap(config, game_state),
+                    DangerMap(config, game_state)) {}
+
+WorldAnalysis::WorldAnalysis(const bman::GameConfig& config,
+                             const bman::GameState& game_state,
+                             const GridMap& grid_map, DangerMap danger_map)
+    : grid_map_(grid_map), danger_map_(std::move(danger_map)),
+      width_(config.level_width()),
+      height_(config.level_height()), clock_(game_state.clock()) {
+  Analyze(game_state);
+}
+
+void WorldAnalysis::Analyze(const bman::GameState& game_state) {
+  FindComponents();
+  fields_.resize(game_state.players_size());
+  for (int i = 0; i < game_state.players_size(); ++i) {
+    const auto& player = game_state.players(i);
+    fields_[i].source = Point2i(GridRound(player.x()), GridRound(player.y()));
+  }
+}
+
+void WorldAnalysis::FindComponents() {
+  component_.assign(width_ * height_, -1);
+  component_sizes_.clear();
+  std::vector<int> queue;
+  queue.reserve(width_ * height_);
+
+  for (int start = 0; start < width_ * height_; ++start) {
+    if (component_[start] >= 0 || !grid_map_.CanMove(FromIndex(start)))
+      continue;
+    const int id = component_sizes_.size();
+    queue.clear();
+    queue.push_back(start);
+    component_[start] = id;
+    for (size_t head = 0; head < queue.size(); ++head) {
+      const Point2i cur = FromIndex(queue[head]);
+      for (const auto& n : kNeighbors) {
+        const Point2i other = cur + n;
+        if (!InBounds(other))
+          continue;
+        const int index = Index(other);
+        if (component_[index] < 0 && grid_map_.CanMove(other)) {
+          component_[index] = id;
+          queue.push_back(index);
+        }
+      }
+    }
+    component_sizes_.push_back(queue.size());
+  }
+}
+
+void WorldAnalysis::ComputeDistances(DistanceField* field) const {
+  const int size = width_ * height_;
+  const Point2i source = field->source;
+  field->computed = true;
+  field->distance.assign(size, -1);
+  field->previous.assign(size, -1);
+  field->reachable.assign((size + 63) / 64, 0);
+  field->order.clear();
+  if (!InBounds(source))
+    return;
+
+  // The source is always reachable (even if standing on a bomb), other
+  // cells are entered if they're free of walls, bricks and bombs.
+  const int start = Index(source);
+  field->distance[start] = 0;
+  field->previous[start] = start;
+  field->order.push_back(start);
+  for (size_t head = 0; head < field->order.size(); ++head) {
+    const int index = field->order[head];
+    const Point2i cur = FromIndex(index);
+    field->reachable[index / 64] |= uint64_t(1) << (index % 64);
+    for (const auto& n : kNeighbors) {
+      const Point2i other = cur + n;
+      if (!InBounds(other) || !grid_map_.CanMove(other))
+        continue;
+      const int other_index = Index(other);
+      if (field->distance[other_index] < 0) {
+        field->distance[other_index] = field->distance[index] + 1;
+        field->previous[other_index] = index;
+        field->order.push_back(other_index);
+      }
+    }
+  }
+}
+
+static uint64_t Fingerprint(const bman::GameState& game_state) {
+  uint64_t hash = 14695981039346656037ULL;
+  auto mix = [&hash](uint64_t value) {
+    hash = (hash ^ value) * 1099511628211ULL;
+  };
+  mix(game_state.clock());
+  for (const auto& player : game_state.players()) {
+    mix(player.x());
+    mix(player.y());
+    mix(player.state());
+  }
+  for (const auto& bomb : game_state.level().bombs()) {
+    mix(bomb.x());
+    mix(bomb.y());
+    mix(bomb.timer());
+  }
+  for (const auto& brick : game_state.level().bricks()) {
+    mix(brick.solid());
+    mix(brick.powerup());
+  }
+  for (const auto& explosion : game_state.level().explosions()) {
+    mix(explosion.timer());
+    mix(explosion.points_size());
+  }
+  return hash;
+}
+
+std::shared_ptr<const WorldAnalysis>
+WorldAnalysisCache::Get(const bman::GameConfig& config,
+                        const bman::GameState& game_state) {
+  const uint64_t fingerprint = Fingerprint(game_state);
+  if (analysis_ && fingerprint == fingerprint_) {
+    num_hits_++;
+    return analysis_;
+  }
+  num_misses_++;
+  if (analysis_) {
+    DangerMap danger_map = analysis_->danger_map();
+    danger_map.Update(game_state);
+    analysis_.reset(new WorldAnalysis(config, game_state,
+                                      GridMap(config, game_state),
+                                      std::move(danger_map)));
+  } else {
+    analysis_.reset(new WorldAnalysis(config, game_state));
+  }
+  fingerprint_ = fingerprint;
+  return analysis_;
+}
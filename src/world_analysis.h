@@ -0,0 +1,127 @@
+#ifndef BMAN_WORLD_ANALYSIS_H
+#define BMAN_WORLD_ANALYSIS_H
+
+#include <memory>
+#include <vector>
+
+#include "danger_map.h"
+#include "grid_map.h"
+#include "level.grpc.pb.h"
+#include "point.h"
+
+// Analysis of the world at a single tick that is shared by all agents in a
+// game: the grid map, connected components of walkable cells, and a BFS
+// distance field (with reachable-set bitmap and parents for recovering
+// paths) from each player, and the danger map. Everything is stored in dense
+// arrays indexed by y * width + x. Distance fields are computed the first
+// time they're used.
+class WorldAnalysis {
+public:
+  WorldAnalysis(const bman::GameConfig& config,
+                const bman::GameState& game_state);
+  // Analysis of a grid map and danger map that have been modified (e.g., by
+  // an agent placing a hypothetical bomb) or updated from an earlier tick.
+  WorldAnalysis(const bman::GameConfig& config,
+                const bman::GameState& game_state, const GridMap& grid_map,
+                DangerMap danger_map);
+
+  const GridMap& grid_map() const { return grid_map_; }
+  const DangerMap& danger_map() const { return danger_map_; }
+  int width() const { return width_; }
+  int height() const { return height_; }
+  int clock() const { return clock_; }
+
+  bool InBounds(const Point2i& pt) const {
+    return pt.x >= 0 && pt.y >= 0 && pt.x < width_ && pt.y < height_;
+  }
+  int Index(const Point2i& pt) const { return pt.y * width_ + pt.x; }
+  Point2i FromIndex(int index) const {
+    return Point2i(index % width_, index / width_);
+  }
+
+  // Connected component of a walkable cell (-1 if not walkable).
+  int component(const Point2i& pt) const {
+    return InBounds(pt) ? component_[Index(pt)] : -1;
+  }
+  int component_size(int component) const {
+    return component >= 0 ? component_sizes_[component] : 0;
+  }
+  int num_components() const { return component_sizes_.size(); }
+
+  // Grid cell of the player (as used as the source of the distance field).
+  Point2i player_pos(int player_index) const {
+    return field(player_index).source;
+  }
+  // Whether the player can walk to pt (avoiding walls, bricks and bombs).
+  bool IsReachable(int player_index, const Point2i& pt) const {
+    if (!InBounds(pt))
+      return false;
+    const int index = Index(pt);
+    return (field(player_index).reachable[index / 64] >> (index % 64)) & 1;
+  }
+  // Number of steps for the player to walk to pt (-1 if unreachable).
+  int Distance(int player_index, const Point2i& pt) const {
+    return InBounds(pt) ? field(player_index).distance[Index(pt)] : -1;
+  }
+  // The cell before pt on a shortest path from the player.
+  Point2i Previous(int player_index, const Point2i& pt) const {
+    return FromIndex(field(player_index).previous[Index(pt)]);
+  }
+  // Reachable cells, in the order they were visited by the BFS.
+  const std::vector<int>& bfs_order(int player_index) const {
+    return field(player_index).order;
+  }
+  int num_players() const { return fields_.size(); }
+
+private:
+  struct DistanceField {
+    bool computed = false;
+    Point2i source;
+    std::vector<int> distance;
+    std::vector<int> previous;
+    std::vector<uint64_t> reachable;
+    std::vector<int> order;
+  };
+
+  const DistanceField& field(int player_index) const {
+    DistanceField& field = fields_[player_index];
+    if (!field.computed) {
+      ComputeDistances(&field);
+    }
+    return field;
+  }
+
+  void Analyze(const bman::GameState& game_state);
+  void FindComponents();
+  void ComputeDistances(DistanceField* field) const;
+
+  GridMap grid_map_;
+  DangerMap danger_map_;
+  int width_;
+  int height_;
+  int clock_;
+  std::vector<int> component_;
+  std::vector<int> component_sizes_;
+  mutable std::vector<DistanceField> fields_;
+};
+
+// Caches the analysis of the most recent state so that agents of the same
+// game, which all see the same state on a tick, only compute it once. The
+// danger map is carried over from the previous analysis and updated
+// incrementally. Not thread-safe; use one cache per game.
+class WorldAnalysisCache {
+public:
+  std::shared_ptr<const WorldAnalysis> Get(const bman::GameConfig& config,
+                                           const bman::GameState& game_state);
+
+  int num_hits() const { return num_hits_; }
+  int num_misses() const { return num_misses_; }
+
+private:
+  std::shared_ptr<const WorldAnalysis> analysis_;
+  uint64_t fingerprint_ = 0;
+  int num_hits_ = 0;
+  int num_misses_ = 0;
+};
+
+#endif
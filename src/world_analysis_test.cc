@@ -0,0 +1,77 @@
+
+#include <gtest/gtest.h>
+
+#include "game.h"
+#include "world_analysis.h"
+
+class WorldAnalysisTest : public testing::Test {
+public:
+  void SetUp() override {
+    // A padding larger than the level gives a level without any bricks.
+    game_.BuildSimpleLevel(kDefaultWidth);
+    game_.AddPlayer();
+    game_.AddPlayer();
+  }
+
+protected:
+  Game game_;
+};
+
+TEST_F(WorldAnalysisTest, TestDistances) {
+  WorldAnalysis analysis(game_.config(), game_.game_state());
+  EXPECT_EQ(1, analysis.num_components());
+  EXPECT_EQ(2, analysis.num_players());
+  EXPECT_EQ(Point2i(0, 0), analysis.player_pos(0));
+  EXPECT_EQ(Point2i(kDefaultWidth - 1, kDefaultHeight - 1),
+            analysis.player_pos(1));
+
+  const Point2i corner(kDefaultWidth - 1, kDefaultHeight - 1);
+  EXPECT_EQ(0, analysis.Distance(0, Point2i(0, 0)));
+  EXPECT_EQ(kDefaultWidth + kDefaultHeight - 2, analysis.Distance(0, corner));
+  EXPECT_EQ(0, analysis.Distance(1, corner));
+  EXPECT_TRUE(analysis.IsReachable(0, corner));
+  EXPECT_FALSE(analysis.IsReachable(0, Point2i(1, 1)));
+  EXPECT_EQ(-1, analysis.Distance(0, Point2i(1, 1)));
+  EXPECT_FALSE(analysis.IsReachable(0, Point2i(-1, 0)));
+
+  // Following the parents walks back to the player.
+  Point2i cur = corner;
+  int steps = 0;
+  while (cur != analysis.player_pos(0)) {
+    cur = analysis.Previous(0, cur);
+    steps++;
+  }
+  EXPECT_EQ(analysis.Distance(0, corner), steps);
+}
+
+TEST_F(WorldAnalysisTest, TestBombsSplitComponents) {
+  GridMap grid_map(game_.config(), game_.game_state());
+  grid_map.PlaceBomb(Point2i(0, 2), 0);
+  grid_map.PlaceBomb(Point2i(2, 0), 0);
+  WorldAnalysis analysis(game_.config(), game_.game_state(), grid_map,
+                         DangerMap(game_.config(), game_.game_state()));
+
+  // The player is boxed into the corner {(0, 0), (1, 0), (0, 1)}.
+  const int component = analysis.component(Point2i(0, 0));
+  EXPECT_EQ(3, analysis.component_size(component));
+  EXPECT_EQ(2, analysis.num_components());
+  EXPECT_EQ(-1, analysis.component(Point2i(0, 2)));
+  EXPECT_EQ(3, (int)analysis.bfs_order(0).size());
+  EXPECT_FALSE(analysis.IsReachable(0, Point2i(3, 0)));
+}
+
+TEST_F(WorldAnalysisTest, TestCache) {
+  WorldAnalysisCache cache;
+  auto a = cache.Get(game_.config(), game_.game_state());
+  auto b = cache.Get(game_.config(), game_.game_state());
+  EXPECT_EQ(a.get(), b.get());
+  EXPECT_EQ(1, cache.num_hits());
+  EXPECT_EQ(1, cache.num_misses());
+
+  game_.Step(std::vector<bman::MovePlayerRequest>(2));
+  auto c = cache.Get(game_.config(), game_.game_state());
+  EXPECT_NE(a.get(), c.get());
+  EXPECT_EQ(2, cache.num_misses());
+}
+
+int main() { return RUN_ALL_TESTS(); }